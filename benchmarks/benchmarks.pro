@@ -0,0 +1,7 @@
+# Benchmarks for the parts of the player that have to scale.  They aren't
+# built with the program; run qmake on this file, then each benchmark on its
+# own, e.g. ./positionindex/bench-positionindex.
+
+TEMPLATE = subdirs
+
+SUBDIRS += positionindex
@@ -0,0 +1,125 @@
+// Times the OrderIndex that Playlist keeps its positions in, on a million
+// entries, against what Playlist did before it:
+//
+// - a linear scan of the list, as itemAfter and itemBefore first did;
+// - a position map behind a watermark, which was cheap to read but had to
+//   renumber everything after an insert or removal before the next lookup
+//   past it.
+//
+// The list itself is a vector of pointers here, standing in for Playlist's
+// QList, so that the cost of moving entries along is counted too.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+#include "orderindex.h"
+
+// How many entries the list holds.
+constexpr int itemCount = 1000000;
+// How many entries are looked up per round, spread evenly over the list.
+constexpr int sampleCount = 1000;
+// How many edits are timed.
+constexpr int editCount = 200;
+
+using Clock = std::chrono::steady_clock;
+
+static double nsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+static void report(const char *what, double ns, int ops)
+{
+    printf("%-44s %12.1f ns/op\n", what, ns / ops);
+}
+
+int main()
+{
+    // Entries are stood in for by their ids, which is all the index sees.
+    OrderIndex index;
+    std::vector<int> list(itemCount);
+    Clock::time_point start = Clock::now();
+    index.insert(0, itemCount, list.data());
+    printf("%-44s %12.1f ms\n", "building the index of 1M entries", nsSince(start) / 1e6);
+
+    std::vector<int> samples;
+    for (int i = 0; i < sampleCount; i++)
+        samples.push_back(list[size_t(itemCount - 1) * i / sampleCount]);
+    long long sink = 0;
+
+    start = Clock::now();
+    for (int id : samples)
+        sink += std::find(list.begin(), list.end(), id) - list.begin();
+    report("position by linear scan", nsSince(start), sampleCount);
+
+    std::unordered_map<int, int> map;
+    map.reserve(itemCount);
+    for (int i = 0; i < itemCount; i++)
+        map[list[i]] = i;
+    start = Clock::now();
+    for (int id : samples)
+        sink += map[id];
+    report("position by map, when up to date", nsSince(start), sampleCount);
+
+    start = Clock::now();
+    for (int id : samples)
+        sink += index.position(id);
+    report("position by OrderIndex", nsSince(start), sampleCount);
+
+    start = Clock::now();
+    for (int id : samples) {
+        int at = index.position(id);
+        if (at + 1 < int(list.size()))
+            sink += list[at + 1];
+    }
+    report("next entry by OrderIndex", nsSince(start), sampleCount);
+
+    // An insert near the front, then a lookup at the end, which is the
+    // worst case for the watermark: all of the map is renumbered.
+    int last = list.back();
+    start = Clock::now();
+    for (int i = 0; i < editCount; i++) {
+        int id = -1 - i;
+        list.insert(list.begin() + 1, id);
+        for (size_t j = 1; j < list.size(); j++)
+            map[list[j]] = int(j);
+        sink += map[last];
+    }
+    report("front insert + lookup, watermark map", nsSince(start), editCount);
+    for (int i = 0; i < editCount; i++)
+        list.erase(list.begin() + 1);
+
+    start = Clock::now();
+    for (int i = 0; i < editCount; i++) {
+        int id;
+        index.insert(1, 1, &id);
+        list.insert(list.begin() + 1, id);
+        sink += index.position(last);
+    }
+    report("front insert + lookup, OrderIndex and list", nsSince(start), editCount);
+
+    start = Clock::now();
+    for (int i = 0; i < editCount; i++) {
+        int id;
+        index.insert(1, 1, &id);
+        sink += index.position(last);
+    }
+    report("front insert + lookup, OrderIndex alone", nsSince(start), editCount);
+
+    start = Clock::now();
+    for (int i = 0; i < editCount; i++) {
+        index.remove(list[1]);
+        list.erase(list.begin() + 1);
+        sink += index.position(last);
+    }
+    report("front removal + lookup, OrderIndex and list", nsSince(start), editCount);
+
+    if (index.position(last) != int(list.size()) - 1 + editCount) {
+        printf("the index disagrees with the list\n");
+        return 1;
+    }
+    printf("(%lld)\n", sink);
+    return 0;
+}
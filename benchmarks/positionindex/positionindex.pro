@@ -0,0 +1,17 @@
+# Needs nothing but the standard library, so that it builds anywhere.
+CONFIG -= qt
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+QMAKE_CXXFLAGS += -Wall
+
+TARGET = bench-positionindex
+TEMPLATE = app
+
+SRC = $$PWD/../..
+INCLUDEPATH += $$SRC
+
+SOURCES += positionindex.cpp \
+    $$SRC/orderindex.cpp
+
+HEADERS += $$SRC/orderindex.h
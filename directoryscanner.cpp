@@ -0,0 +1,202 @@
+#include <QDir>
+#include <QFileInfo>
+#include <QStack>
+#include <QtConcurrent>
+#include <algorithm>
+#include "directoryscanner.h"
+#include "helpers.h"
+
+// Roughly how many directory entries to keep listings of.
+constexpr int maxCachedEntries = 1000000;
+// Found files are handed over in chunks of this many.
+constexpr int scanChunkSize = 1024;
+// Listing is mostly waiting on the disk, and more threads than this only
+// get in each other's way.
+constexpr int maxListingThreads = 4;
+
+QSharedPointer<DirectoryScanner> DirectoryScanner::scanner;
+
+DirectoryScanner::DirectoryScanner() : QObject()
+{
+    listings.setMaxCost(maxCachedEntries);
+    pool.setMaxThreadCount(maxListingThreads);
+}
+
+DirectoryScanner::~DirectoryScanner()
+{
+    pool.waitForDone();
+}
+
+QSharedPointer<DirectoryScanner> DirectoryScanner::getSingleton()
+{
+    if (scanner.isNull())
+        scanner.reset(new DirectoryScanner());
+    return scanner;
+}
+
+QString DirectoryScanner::fileAfter(const QString &path, int delta)
+{
+    QFileInfo info(path);
+    Listing l = listing(info.absolutePath());
+    QString name = info.fileName();
+    int index;
+    if (delta > 0) {
+        auto it = std::upper_bound(l.files.constBegin(), l.files.constEnd(), name);
+        index = int(it - l.files.constBegin()) + delta - 1;
+    } else {
+        auto it = std::lower_bound(l.files.constBegin(), l.files.constEnd(), name);
+        index = int(it - l.files.constBegin()) + delta;
+    }
+    if (delta == 0 || index < 0 || index >= l.files.count())
+        return QString();
+    return QDir(info.absolutePath()).filePath(l.files.at(index));
+}
+
+void DirectoryScanner::prefetch(const QString &dir)
+{
+    QString key = QDir::cleanPath(dir);
+    {
+        QMutexLocker locker(&lock);
+        if (prefetching.contains(key))
+            return;
+        prefetching.insert(key);
+    }
+    QtConcurrent::run(&pool, [this, key]() {
+        listing(key);
+        QMutexLocker locker(&lock);
+        prefetching.remove(key);
+    });
+}
+
+int DirectoryScanner::scan(const QList<QUrl> &urls)
+{
+    int job = nextJob();
+    QtConcurrent::run(&pool, this, &DirectoryScanner::walk, job, urls);
+    return job;
+}
+
+int DirectoryScanner::refresh(const QString &dir)
+{
+    int job = nextJob();
+    QString key = QDir::cleanPath(dir);
+    QtConcurrent::run(&pool, [this, job, key]() {
+        Listing l = listing(key, true);
+        emit directoryListed(job, key, l.files, l.dirs);
+        emit scanFinished(job);
+    });
+    return job;
+}
+
+void DirectoryScanner::cancel(int job)
+{
+    QMutexLocker locker(&lock);
+    cancelled.insert(job);
+}
+
+int DirectoryScanner::nextJob()
+{
+    QMutexLocker locker(&lock);
+    return ++lastJob;
+}
+
+DirectoryScanner::Listing DirectoryScanner::listing(const QString &dir, bool fresh)
+{
+    QString key = QDir::cleanPath(dir);
+    QDateTime modified = QFileInfo(key).lastModified();
+    // Modification times are only so fine grained, so a directory that was
+    // just changed twice can look like it wasn't changed the second time.
+    if (!fresh) {
+        QMutexLocker locker(&lock);
+        Listing *cached = listings.object(key);
+        if (cached && cached->modified == modified)
+            return *cached;
+    }
+    Listing read = readListing(key, modified);
+    QMutexLocker locker(&lock);
+    listings.insert(key, new Listing(read),
+                    read.files.count() + read.dirs.count() + 1);
+    return read;
+}
+
+DirectoryScanner::Listing DirectoryScanner::readListing(const QString &dir,
+                                                        const QDateTime &modified)
+{
+    Listing l;
+    l.modified = modified;
+    QFileInfoList entries = QDir(dir).entryInfoList(QDir::NoDotAndDotDot
+                                                    | QDir::Files | QDir::Dirs,
+                                                    QDir::NoSort);
+    for (const QFileInfo &info : entries) {
+        if (info.isDir())
+            l.dirs.append(info.fileName());
+        else if (Helpers::fileExtensions.contains(info.suffix().toLower()))
+            l.files.append(info.fileName());
+    }
+    std::sort(l.files.begin(), l.files.end());
+    std::sort(l.dirs.begin(), l.dirs.end());
+    return l;
+}
+
+void DirectoryScanner::walk(int job, const QList<QUrl> &urls)
+{
+    QList<QUrl> chunk;
+    auto flush = [&]() {
+        if (!chunk.isEmpty())
+            emit filesFound(job, chunk);
+        chunk.clear();
+    };
+    // Canonical paths already walked, so that symlink loops end.
+    QSet<QString> visited;
+
+    for (const QUrl &url : urls) {
+        if (!url.isLocalFile()) {
+            chunk.append(url);
+            continue;
+        }
+        QFileInfo info(url.toLocalFile());
+        if (!info.isDir()) {
+            if (Helpers::urlSurvivesFilter(url))
+                chunk.append(url);
+            continue;
+        }
+
+        // Depth first with files before subdirectories, both by name.
+        QStack<QString> pending;
+        pending.push(info.absoluteFilePath());
+        while (!pending.isEmpty() && !isCancelled(job)) {
+            QString dir = pending.pop();
+            QString canonical = QFileInfo(dir).canonicalFilePath();
+            if (canonical.isEmpty() || visited.contains(canonical))
+                continue;
+            visited.insert(canonical);
+
+            Listing l = listing(dir);
+            emit directoryListed(job, QDir::cleanPath(dir), l.files, l.dirs);
+            QDir d(dir);
+            // The subdirectories are wanted next, so have them listed while
+            // this one's files are handed over.
+            for (const QString &sub : l.dirs)
+                prefetch(d.filePath(sub));
+            for (const QString &file : l.files) {
+                chunk.append(QUrl::fromLocalFile(d.filePath(file)));
+                if (chunk.count() >= scanChunkSize)
+                    flush();
+            }
+            for (int i = l.dirs.count() - 1; i >= 0; i--)
+                pending.push(d.filePath(l.dirs.at(i)));
+        }
+    }
+    flush();
+
+    {
+        QMutexLocker locker(&lock);
+        cancelled.remove(job);
+    }
+    emit scanFinished(job);
+}
+
+bool DirectoryScanner::isCancelled(int job)
+{
+    QMutexLocker locker(&lock);
+    return cancelled.contains(job);
+}
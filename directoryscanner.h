@@ -0,0 +1,74 @@
+#ifndef DIRECTORYSCANNER_H
+#define DIRECTORYSCANNER_H
+// Lists directories away from the GUI thread.  The sorted media files and
+// subdirectories of every directory seen are cached, and reused for as long
+// as the directory's modification time stays the same.  Stepping through a
+// folder then costs a stat and a binary search, and whole trees are walked
+// with the next directories already being listed in parallel.
+
+#include <QCache>
+#include <QDateTime>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThreadPool>
+#include <QUrl>
+
+class DirectoryScanner : public QObject {
+    Q_OBJECT
+private:
+    DirectoryScanner();
+    static QSharedPointer<DirectoryScanner> scanner;
+
+public:
+    ~DirectoryScanner();
+    static QSharedPointer<DirectoryScanner> getSingleton();
+
+    // The media file delta places after path in its directory, or nothing
+    // if it runs off either end.  path itself need not be in the listing.
+    QString fileAfter(const QString &path, int delta = 1);
+    // Lists dir in the background, so that the next fileAfter is quick.
+    void prefetch(const QString &dir);
+
+    // Walks the trees under urls in the background.  Media files arrive in
+    // chunks through filesFound, in the order Helpers::filterUrls would give
+    // them, followed by scanFinished.  Returns the job's number.
+    int scan(const QList<QUrl> &urls);
+    // Lists dir afresh in the background, bypassing the cache.  The listing
+    // arrives through directoryListed, followed by scanFinished.
+    int refresh(const QString &dir);
+    void cancel(int job);
+
+signals:
+    void filesFound(int job, QList<QUrl> files);
+    // Every directory a job looks at, with its sorted media file and
+    // subdirectory names.
+    void directoryListed(int job, QString dir, QStringList files, QStringList dirs);
+    void scanFinished(int job);
+
+private:
+    struct Listing {
+        QDateTime modified;
+        QStringList files;
+        QStringList dirs;
+    };
+
+    int nextJob();
+    Listing listing(const QString &dir, bool fresh = false);
+    static Listing readListing(const QString &dir, const QDateTime &modified);
+    void walk(int job, const QList<QUrl> &urls);
+    bool isCancelled(int job);
+
+    QMutex lock;
+    // Costed by entry count.
+    QCache<QString, Listing> listings;
+    QSet<QString> prefetching;
+    QSet<int> cancelled;
+    int lastJob = 0;
+    // Declared last, so that it is torn down (and waited on) first.
+    QThreadPool pool;
+};
+
+#endif // DIRECTORYSCANNER_H
@@ -4,9 +4,45 @@
 #include <QFontMetrics>
 #include <QMenu>
 #include <QKeyEvent>
+#include <QDropEvent>
+#include <QScrollBar>
+#include <QTimer>
+#include <algorithm>
 #include "drawnplaylist.h"
+#include "mediaprober.h"
 #include "playlist.h"
 #include "helpers.h"
+#include "logger.h"
+
+static const char logModule[] = "playlist";
+
+// Past this many separate runs of changed rows, resetting the model is
+// cheaper than notifying the view of each one.
+constexpr int maxMergeRuns = 64;
+// Wait for scrolling to settle before probing what's on screen.
+constexpr int probeDelay = 150;
+
+// Every playlist tab shares one searcher thread; the searcher itself spreads
+// big searches over the global thread pool.
+static PlaylistSearcher *sharedSearcher()
+{
+    static QThread *worker = nullptr;
+    static PlaylistSearcher *searcher = nullptr;
+    if (searcher)
+        return searcher;
+
+    worker = new QThread(qApp);
+    searcher = new PlaylistSearcher();
+    searcher->moveToThread(worker);
+    QObject::connect(worker, &QThread::finished,
+                     searcher, &QObject::deleteLater);
+    QObject::connect(qApp, &QCoreApplication::aboutToQuit, worker, []() {
+        worker->quit();
+        worker->wait();
+    });
+    worker->start();
+    return searcher;
+}
 
 PlayPainter::PlayPainter(QObject *parent) : QAbstractItemDelegate(parent) {}
 
@@ -14,10 +50,10 @@ void PlayPainter::paint(QPainter *painter, const QStyleOptionViewItem &option,
                         const QModelIndex &index) const
 {
     auto playWidget = qobject_cast<DrawnPlaylist*>(parent());
-    auto p = playWidget->playlist();
-    if (p == nullptr)
+    auto model = qobject_cast<const PlaylistModel*>(index.model());
+    if (model == nullptr)
         return;
-    QSharedPointer<Item> i = p->itemOf(QUuid(index.data(Qt::DisplayRole).toString()));
+    QSharedPointer<Item> i = model->itemAt(index.row());
     if (i == nullptr)
         return;
 
@@ -71,64 +107,372 @@ QSize PlayPainter::sizeHint(const QStyleOptionViewItem &option,
                                                    option.rect.size());
 }
 
-PlayItem::PlayItem(const QUuid &uuid, const QUuid &playlistUuid,
-                   QListWidget *parent)
-    : QListWidgetItem(parent, QListWidgetItem::UserType)
+PlaylistModel::PlaylistModel(QObject *parent) : QAbstractListModel(parent)
 {
-    playlistUuid_ = playlistUuid;
-    uuid_ = uuid;
-    setData(Qt::DisplayRole, uuid.toString());
+
 }
 
-PlayItem::~PlayItem()
+int PlaylistModel::rowCount(const QModelIndex &parent) const
 {
+    if (parent.isValid())
+        return 0;
+    return filtered ? shown.count() : count_;
+}
 
+QVariant PlaylistModel::data(const QModelIndex &index, int role) const
+{
+    QSharedPointer<Item> item = itemAt(index.isValid() ? index.row() : -1);
+    if (!item)
+        return QVariant();
+    if (role == Qt::DisplayRole)
+        return item->toDisplayString();
+    if (role == Qt::UserRole)
+        return item->uuid();
+    return QVariant();
+}
+
+Qt::ItemFlags PlaylistModel::flags(const QModelIndex &index) const
+{
+    // Dropping is only allowed between rows, never onto one.
+    if (!index.isValid())
+        return Qt::ItemIsDropEnabled;
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsDragEnabled;
+}
+
+Qt::DropActions PlaylistModel::supportedDropActions() const
+{
+    return Qt::MoveAction;
+}
+
+bool PlaylistModel::moveRows(const QModelIndex &sourceParent, int sourceRow,
+                             int count, const QModelIndex &destinationParent,
+                             int destinationChild)
+{
+    // Moves the items in the playlist too.  With a filter on, they go before
+    // the shown item at destinationChild, wherever that is in the playlist.
+    int last = sourceRow + count - 1;
+    if (sourceParent.isValid() || destinationParent.isValid() || !playlist_
+            || count <= 0 || sourceRow < 0 || last >= rowCount())
+        return false;
+    QList<QSharedPointer<Item>> moving;
+    for (int row = sourceRow; row <= last; row++)
+        moving.append(itemAt(row));
+    QUuid where = uuidAt(destinationChild);
+    if (!beginMoveRows(QModelIndex(), sourceRow, last,
+                       QModelIndex(), destinationChild))
+        return false;
+    playlist_->moveItems(moving, where);
+    if (filtered) {
+        shown.remove(sourceRow, count);
+        int insertAt = destinationChild > last ? destinationChild - count
+                                               : destinationChild;
+        shown = shown.mid(0, insertAt) + moving.toVector() + shown.mid(insertAt);
+        invalidateRows(std::min(sourceRow, insertAt));
+    }
+    endMoveRows();
+    return true;
 }
 
-QUuid PlayItem::playlistUuid()
+QSharedPointer<Item> PlaylistModel::itemAt(int row) const
 {
-    return playlistUuid_;
+    if (row < 0 || row >= rowCount())
+        return QSharedPointer<Item>();
+    if (filtered)
+        return shown.at(row);
+    return playlist_ ? playlist_->itemAt(row) : QSharedPointer<Item>();
 }
 
-QUuid PlayItem::uuid()
+QUuid PlaylistModel::uuidAt(int row) const
 {
-    return uuid_;
+    QSharedPointer<Item> item = itemAt(row);
+    return item ? item->uuid() : QUuid();
 }
 
-DrawnPlaylist::DrawnPlaylist(QWidget *parent) : QListWidget(parent),
-    displayParser_(nullptr), worker(nullptr), searcher(nullptr)
+int PlaylistModel::rowOf(const QUuid &uuid) const
 {
-    worker = new QThread();
-    worker->start();
-    searcher = new PlaylistSearcher();
-    searcher->moveToThread(worker);
+    if (!filtered) {
+        int row = playlist_ ? playlist_->indexOf(uuid) : -1;
+        return row < count_ ? row : -1;
+    }
+    int row = rowByUuid.value(uuid, -1);
+    if (row >= 0 && row < rowsValidUntil)
+        return row;
+    int count = shown.count();
+    for (int i = rowsValidUntil; i < count; i++)
+        rowByUuid.insert(shown.at(i)->uuid(), i);
+    rowsValidUntil = count;
+    return rowByUuid.value(uuid, -1);
+}
+
+void PlaylistModel::setPlaylist(const QSharedPointer<Playlist> &playlist)
+{
+    beginResetModel();
+    playlist_ = playlist;
+    filtered = false;
+    count_ = playlist ? playlist->count() : 0;
+    shown.clear();
+    rowByUuid.clear();
+    rowsValidUntil = 0;
+    endResetModel();
+}
+
+void PlaylistModel::setItems(const QSharedPointer<Playlist> &playlist,
+                             const QList<QSharedPointer<Item>> &items)
+{
+    beginResetModel();
+    playlist_ = playlist;
+    filtered = true;
+    count_ = 0;
+    shown = items.toVector();
+    rowByUuid.clear();
+    rowsValidUntil = 0;
+    endResetModel();
+}
+
+void PlaylistModel::mergeItems(const QList<QSharedPointer<Item>> &items)
+{
+    // Bring the rows in line with items, touching only the rows that differ.
+    // The rows that survive have to appear in items in the same order, which
+    // holds as long as the playlist wasn't reordered in the meantime.
+    if (!filtered)
+        copyPlaylistRows();
+    QSet<Item*> wanted;
+    wanted.reserve(items.count());
+    for (const QSharedPointer<Item> &item : items)
+        wanted.insert(item.data());
+
+    QVector<QPair<int,int>> removals;
+    for (int row = shown.count() - 1; row >= 0; row--) {
+        if (wanted.contains(shown.at(row).data()))
+            continue;
+        int last = row;
+        while (row > 0 && !wanted.contains(shown.at(row - 1).data()))
+            row--;
+        removals.append({ row, last });
+    }
+    if (removals.count() > maxMergeRuns) {
+        setItems(playlist_, items);
+        return;
+    }
+
+    // Work out the insertions against what the rows will be once the
+    // removals are done.
+    QSet<Item*> removed;
+    for (const QPair<int,int> &run : removals)
+        for (int row = run.first; row <= run.second; row++)
+            removed.insert(shown.at(row).data());
+    QVector<QPair<int,int>> insertions;
+    int row = 0;
+    for (int i = 0; i < items.count(); i++) {
+        while (row < shown.count() && removed.contains(shown.at(row).data()))
+            row++;
+        if (row < shown.count() && shown.at(row) == items.at(i)) {
+            row++;
+            continue;
+        }
+        if (!insertions.isEmpty() &&
+                insertions.last().first + insertions.last().second == i)
+            insertions.last().second++;
+        else
+            insertions.append({ i, 1 });
+    }
+    while (row < shown.count() && removed.contains(shown.at(row).data()))
+        row++;
+    if (row != shown.count() || insertions.count() > maxMergeRuns) {
+        setItems(playlist_, items);
+        return;
+    }
+
+    for (const QPair<int,int> &run : removals) {
+        beginRemoveRows(QModelIndex(), run.first, run.second);
+        for (int i = run.first; i <= run.second; i++)
+            rowByUuid.remove(shown.at(i)->uuid());
+        shown.remove(run.first, run.second - run.first + 1);
+        invalidateRows(run.first);
+        endRemoveRows();
+    }
+    for (const QPair<int,int> &run : insertions) {
+        beginInsertRows(QModelIndex(), run.first, run.first + run.second - 1);
+        shown = shown.mid(0, run.first)
+                + items.mid(run.first, run.second).toVector()
+                + shown.mid(run.first);
+        invalidateRows(run.first);
+        endInsertRows();
+    }
+}
+
+void PlaylistModel::unfilter()
+{
+    if (!filtered)
+        return;
+    QVector<QSharedPointer<Item>> all = playlistItems();
+    mergeItems(QList<QSharedPointer<Item>>::fromVector(all));
+    // The rows now match the playlist, so it can take over from them.
+    filtered = false;
+    count_ = all.count();
+    shown.clear();
+    rowByUuid.clear();
+    rowsValidUntil = 0;
+}
+
+void PlaylistModel::insertItems(int row, const QList<QSharedPointer<Item>> &items)
+{
+    if (items.isEmpty())
+        return;
+    if (!filtered) {
+        int at = playlist_ ? playlist_->indexOf(items.first()->uuid()) : -1;
+        row = at >= 0 ? std::min(at, count_) : count_;
+        beginInsertRows(QModelIndex(), row, row + items.count() - 1);
+        count_ += items.count();
+        endInsertRows();
+        return;
+    }
+    row = qBound(0, row, shown.count());
+    beginInsertRows(QModelIndex(), row, row + items.count() - 1);
+    if (row == shown.count())
+        shown += items.toVector();
+    else
+        shown = shown.mid(0, row) + items.toVector() + shown.mid(row);
+    invalidateRows(row);
+    endInsertRows();
+}
+
+void PlaylistModel::appendItems(const QList<QSharedPointer<Item>> &items)
+{
+    insertItems(rowCount(), items);
+}
+
+void PlaylistModel::removeItemAt(int row)
+{
+    if (row < 0 || row >= rowCount())
+        return;
+    beginRemoveRows(QModelIndex(), row, row);
+    if (filtered) {
+        rowByUuid.remove(shown.at(row)->uuid());
+        shown.remove(row);
+        invalidateRows(row);
+    } else {
+        count_--;
+    }
+    endRemoveRows();
+}
+
+void PlaylistModel::removeItemsAt(const QList<int> &indices)
+{
+    QListIterator<int> iterator(indices);
+    iterator.toBack();
+    while (iterator.hasPrevious())
+        removeItemAt(iterator.previous());
+}
+
+void PlaylistModel::forgetItem(const QUuid &uuid)
+{
+    if (filtered) {
+        removeItemAt(rowOf(uuid));
+        return;
+    }
+    // The playlist no longer knows where it was, so if the count is off the
+    // view has to start over.
+    int count = playlist_ ? playlist_->count() : 0;
+    if (count == count_)
+        return;
+    beginResetModel();
+    count_ = count;
+    endResetModel();
+}
+
+void PlaylistModel::clear()
+{
+    beginResetModel();
+    count_ = 0;
+    shown.clear();
+    rowByUuid.clear();
+    rowsValidUntil = 0;
+    endResetModel();
+}
+
+void PlaylistModel::copyPlaylistRows()
+{
+    // The filtered rows start out as the playlist's, to be pared down from
+    // there.  Nothing changes on screen unless the count was off.
+    QVector<QSharedPointer<Item>> all = playlistItems();
+    bool reset = all.count() != count_;
+    if (reset)
+        beginResetModel();
+    filtered = true;
+    count_ = 0;
+    shown = all;
+    rowByUuid.clear();
+    rowsValidUntil = 0;
+    if (reset)
+        endResetModel();
+}
+
+QVector<QSharedPointer<Item>> PlaylistModel::playlistItems() const
+{
+    QVector<QSharedPointer<Item>> all;
+    if (!playlist_)
+        return all;
+    all.reserve(playlist_->count());
+    playlist_->iterateItems([&all](QSharedPointer<Item> item) {
+        all.append(item);
+    });
+    return all;
+}
+
+void PlaylistModel::invalidateRows(int from) const
+{
+    rowsValidUntil = std::min(rowsValidUntil, from);
+}
+
+
 
+DrawnPlaylist::DrawnPlaylist(QWidget *parent) : QListView(parent),
+    displayParser_(nullptr)
+{
+    searcher = sharedSearcher();
+
+    model_ = new PlaylistModel(this);
+    setModel(model_);
+    setUniformItemSizes(true);
     setSelectionMode(QAbstractItemView::ContiguousSelection);
     setDragDropMode(QAbstractItemView::InternalMove);
 
     setItemDelegate(new PlayPainter(this));
 
-    connect(worker, &QThread::finished, searcher, &QObject::deleteLater);
-    connect(model(), SIGNAL(rowsAboutToBeMoved(QModelIndex,int,int,QModelIndex,int)),
-            this, SLOT(model_rowsMoved(QModelIndex,int,int,QModelIndex,int)));
     connect(this, &DrawnPlaylist::searcher_filterPlaylist,
             searcher, &PlaylistSearcher::filterPlaylist,
             Qt::QueuedConnection);
+    connect(this, &DrawnPlaylist::searcher_forgetPlaylist,
+            searcher, &PlaylistSearcher::forgetPlaylist,
+            Qt::QueuedConnection);
     connect(searcher, &PlaylistSearcher::playlistFiltered,
-            this, &DrawnPlaylist::repopulateItems,
+            this, &DrawnPlaylist::refilterItems,
             Qt::QueuedConnection);
-    connect(this, &DrawnPlaylist::currentItemChanged,
-            this, &DrawnPlaylist::self_currentItemChanged);
-    connect(this, SIGNAL(itemDoubleClicked(QListWidgetItem*)),
-            this, SLOT(self_itemDoubleClicked(QListWidgetItem*)));
+    connect(selectionModel(), &QItemSelectionModel::currentChanged,
+            this, &DrawnPlaylist::self_currentChanged);
+    connect(this, &DrawnPlaylist::doubleClicked,
+            this, &DrawnPlaylist::self_doubleClicked);
     connect(this, SIGNAL(customContextMenuRequested(QPoint)),
             this, SLOT(self_customContextMenuRequested(QPoint)));
     setContextMenuPolicy(Qt::CustomContextMenu);
+
+    probeTimer = new QTimer(this);
+    probeTimer->setSingleShot(true);
+    probeTimer->setInterval(probeDelay);
+    connect(probeTimer, &QTimer::timeout,
+            this, &DrawnPlaylist::probeVisibleItems);
+    connect(verticalScrollBar(), &QScrollBar::valueChanged,
+            this, [this]() { probeTimer->start(); });
+    connect(model_, &PlaylistModel::rowsInserted,
+            this, [this]() { probeTimer->start(); });
+    connect(model_, &PlaylistModel::modelReset,
+            this, [this]() { probeTimer->start(); });
 }
 
 DrawnPlaylist::~DrawnPlaylist()
 {
-    worker->deleteLater();
+    emit searcher_forgetPlaylist(uuid_);
 }
 
 QSharedPointer<Playlist> DrawnPlaylist::playlist() const
@@ -143,44 +487,37 @@ QUuid DrawnPlaylist::uuid() const
 
 QUuid DrawnPlaylist::currentItemUuid() const
 {
-    PlayItem *item = reinterpret_cast<PlayItem*>(currentItem());
-    if (!item)
-        item = reinterpret_cast<PlayItem*>(QListWidget::item(0));
-    if (item)
-        return item->uuid();
-    return QUuid();
+    QModelIndex index = currentIndex();
+    return model_->uuidAt(index.isValid() ? index.row() : 0);
 }
 
 QList<QUuid> DrawnPlaylist::currentItemUuids() const
 {
     QList<QUuid> selected;
-    for (auto &i : selectedItems())
-        selected.append(QUuid(i->text()));
+    QModelIndexList rows = selectionModel()->selectedRows();
+    std::sort(rows.begin(), rows.end());
+    for (const QModelIndex &index : rows)
+        selected.append(model_->uuidAt(index.row()));
     return selected;
 }
 
 void DrawnPlaylist::traverseSelected(std::function<void (QUuid)> callback)
 {
-    for (auto &i : selectedItems())
-        callback(QUuid(i->text()));
+    for (const QUuid &uuid : currentItemUuids())
+        callback(uuid);
 }
 
 void DrawnPlaylist::setCurrentItem(QUuid itemUuid)
 {
-    QList<QListWidgetItem *> items = findItems(itemUuid.toString(), Qt::MatchExactly);
-    if (items.isEmpty())
-        setCurrentRow(-1);
-    else
-        QListWidget::setCurrentItem(items.first());
+    setCurrentRow(model_->rowOf(itemUuid));
 }
 
 void DrawnPlaylist::scrollToItem(QUuid itemUuid)
 {
-    auto items = findItems(itemUuid.toString(), Qt::MatchExactly);
-    if (items.empty())
+    int row = model_->rowOf(itemUuid);
+    if (row < 0)
         return;
-    auto item = items.first();
-    scrollTo(indexFromItem(item));
+    scrollTo(model_->index(row));
 }
 
 void DrawnPlaylist::setUuid(const QUuid &uuid)
@@ -191,44 +528,69 @@ void DrawnPlaylist::setUuid(const QUuid &uuid)
 
 void DrawnPlaylist::addItem(QUuid uuid)
 {
-    PlayItem *playItem = new PlayItem(uuid, uuid_, this);
-    QListWidget::addItem(playItem);
+    addItems({ uuid });
 }
 
 void DrawnPlaylist::addItems(const QList<QUuid> &items)
 {
-    for (const QUuid &item : items)
-        QListWidget::addItem(item.toString());
+    QSharedPointer<Playlist> playlist = this->playlist();
+    if (!playlist)
+        return;
+    QList<QSharedPointer<Item>> itemsToAdd;
+    for (const QUuid &uuid : items) {
+        QSharedPointer<Item> item = playlist->itemOf(uuid);
+        if (item)
+            itemsToAdd.append(item);
+    }
+    model_->appendItems(itemsToAdd);
 }
 
 void DrawnPlaylist::addItemsAfter(QUuid item, const QList<QUuid> &items)
 {
-    auto matchingRows = findItems(item.toString(), Qt::MatchExactly);
-    if (matchingRows.length() < 1)
+    QSharedPointer<Playlist> playlist = this->playlist();
+    if (!playlist)
         return;
-    int itemIndex = row(matchingRows[0]) + 1;
-    for (auto i : items) {
-        PlayItem *playItem = new PlayItem(i);
-        QListWidget::insertItem(itemIndex++, playItem);
+    QList<QSharedPointer<Item>> itemsToAdd;
+    for (const QUuid &uuid : items) {
+        QSharedPointer<Item> i = playlist->itemOf(uuid);
+        if (i && (currentFilterText.isEmpty()
+                  || PlaylistSearcher::itemMatchesFilter(i, currentFilterList)))
+            itemsToAdd.append(i);
     }
+    if (itemsToAdd.isEmpty())
+        return;
+    QUuid anchor = item;
+    if (!playlist->contains(item)) {
+        // Go by where the playlist put them instead.
+        Logger::log(logModule, QString("%1 to add after is not in the playlist")
+                    .arg(item.toString()));
+        anchor = itemsToAdd.first()->uuid();
+    }
+
+    // The filter may be hiding the item, so go after the nearest one before
+    // it that is shown, or to the top if there's none.
+    int row = anchor == item ? model_->rowOf(item) : -1;
+    for (QSharedPointer<Item> before = playlist->itemBefore(anchor);
+         row < 0 && before; before = playlist->itemBefore(before->uuid()))
+        row = model_->rowOf(before->uuid());
+    model_->insertItems(row + 1, itemsToAdd);
 }
 
 void DrawnPlaylist::removeItem(QUuid uuid)
 {
     QSharedPointer<Playlist> playlist = this->playlist();
-    if (playlist && playlist->contains(uuid))
-        playlist->removeItem(uuid);
-    auto matchingRows = findItems(uuid.toString(), Qt::MatchExactly);
-    if (matchingRows.length() > 0)
-        takeItem(row(matchingRows[0]));
+    if (!playlist || !playlist->contains(uuid)) {
+        model_->forgetItem(uuid);
+        return;
+    }
+    int row = model_->rowOf(uuid);
+    playlist->removeItem(uuid);
+    model_->removeItemAt(row);
 }
 
 void DrawnPlaylist::removeItems(const QList<int> &indicies)
 {
-    QListIterator<int> iterator(indicies);
-    iterator.toBack();
-    while (iterator.hasPrevious())
-        delete takeItem(iterator.previous());
+    model_->removeItemsAt(indicies);
 }
 
 void DrawnPlaylist::removeAll()
@@ -240,6 +602,27 @@ void DrawnPlaylist::removeAll()
     clear();
 }
 
+void DrawnPlaylist::clear()
+{
+    model_->clear();
+}
+
+int DrawnPlaylist::count() const
+{
+    return model_->rowCount();
+}
+
+int DrawnPlaylist::currentRow() const
+{
+    QModelIndex index = currentIndex();
+    return index.isValid() ? index.row() : -1;
+}
+
+void DrawnPlaylist::setCurrentRow(int row)
+{
+    setCurrentIndex(row < 0 ? QModelIndex() : model_->index(row));
+}
+
 QPair<QUuid,QUuid> DrawnPlaylist::importUrl(QUrl url)
 {
     QPair<QUuid,QUuid> info;
@@ -250,7 +633,31 @@ QPair<QUuid,QUuid> DrawnPlaylist::importUrl(QUrl url)
     info.second = item->uuid();
     if (currentFilterText.isEmpty() ||
             PlaylistSearcher::itemMatchesFilter(item, currentFilterList))
-        addItem(item->uuid());
+        model_->appendItems({ item });
+    return info;
+}
+
+QPair<QUuid,QUuid> DrawnPlaylist::importUrls(const QList<QUrl> &urls,
+                                             const QList<QVariantMap> &metadata)
+{
+    // Like importUrl, but takes the playlist lock once and hands the view a
+    // single range of new rows.  Returns the first imported item.
+    QPair<QUuid,QUuid> info;
+    QSharedPointer<Playlist> playlist = this->playlist();
+    if (!playlist || urls.isEmpty())
+        return info;
+    QList<QSharedPointer<Item>> added = playlist->addUrls(urls, metadata);
+    info.first = uuid_;
+    info.second = added.first()->uuid();
+
+    if (!currentFilterText.isEmpty()) {
+        QList<QSharedPointer<Item>> visible;
+        for (const QSharedPointer<Item> &item : added)
+            if (PlaylistSearcher::itemMatchesFilter(item, currentFilterList))
+                visible.append(item);
+        added = visible;
+    }
+    model_->appendItems(added);
     return info;
 }
 
@@ -292,9 +699,15 @@ void DrawnPlaylist::fromVMap(const QVariantMap &qvm)
     QVariantMap contents = qvm.value("contents").toMap();
     QSharedPointer<Playlist> p(new Playlist);
     p->fromVMap(contents);
+    fromPlaylist(p, qvm.value("nowplaying").toUuid());
+}
+
+void DrawnPlaylist::fromPlaylist(const QSharedPointer<Playlist> &p,
+                                 const QUuid &nowPlaying)
+{
     PlaylistCollection::getSingleton()->addPlaylist(p);
     setUuid(p->uuid());
-    nowPlayingItem_ = qvm.value("nowplaying").toUuid();
+    nowPlayingItem_ = nowPlaying;
     setCurrentItem(nowPlayingItem_);
 }
 
@@ -315,8 +728,29 @@ void DrawnPlaylist::setFilter(QString needles)
 
     currentFilterText = needles;
     currentFilterList = PlaylistSearcher::textToNeedles(needles);
-    searcher->bump();
-    emit searcher_filterPlaylist(playlist(), needles);
+    QSharedPointer<Playlist> playlist = this->playlist();
+    searcher->bump(playlist ? playlist->uuid() : QUuid());
+    emit searcher_filterPlaylist(playlist, needles);
+}
+
+void DrawnPlaylist::probeVisibleItems()
+{
+    if (!isVisible())
+        return;
+    QRect area = viewport()->rect();
+    int first = indexAt(area.topLeft()).row();
+    int last = indexAt(area.bottomLeft()).row();
+    if (first < 0)
+        return;
+    if (last < 0)
+        last = model_->rowCount() - 1;
+    QList<QSharedPointer<Item>> items;
+    for (int row = first; row <= last; row++) {
+        QSharedPointer<Item> item = model_->itemAt(row);
+        if (item)
+            items.append(item);
+    }
+    MediaProber::getSingleton()->probe(items, MediaProber::Visible);
 }
 
 bool DrawnPlaylist::event(QEvent *e)
@@ -331,65 +765,135 @@ bool DrawnPlaylist::event(QEvent *e)
         }
     }
     end:
-    return QListWidget::event(e);
+    return QListView::event(e);
 }
 
-void DrawnPlaylist::repopulateItems()
+void DrawnPlaylist::dropEvent(QDropEvent *event)
 {
-    clear();
+    // The whole selection is moved in one go, rather than a row at a time.
+    QModelIndexList selected = selectionModel()->selectedRows();
+    if (event->source() != this || selected.isEmpty()) {
+        event->ignore();
+        return;
+    }
+    int first = model_->rowCount();
+    int last = -1;
+    for (const QModelIndex &index : selected) {
+        first = std::min(first, index.row());
+        last = std::max(last, index.row());
+    }
+    QModelIndex target = indexAt(event->pos());
+    int row = target.isValid() ? target.row() : model_->rowCount();
+    if (target.isValid() && event->pos().y() > visualRect(target).center().y())
+        row++;
+
+    stopAutoScroll();
+    setState(NoState);
+    viewport()->update();
+    if (row >= first && row <= last + 1) {
+        event->ignore();
+        return;
+    }
+
+    if (!model_->moveRows(QModelIndex(), first, last - first + 1,
+                          QModelIndex(), row)) {
+        event->ignore();
+        return;
+    }
+    // The model has no removeRows(), so the view's clean-up after a move
+    // leaves the moved rows alone.
+    event->setDropAction(Qt::MoveAction);
+    event->accept();
+}
+
+QVector<QSharedPointer<Item>> DrawnPlaylist::withLateMatches(
+        const QSharedPointer<Playlist> &playlist,
+        const QVector<QSharedPointer<Item>> &shown) const
+{
+    // Only the rows the result leaves out need to be held to the filter.
+    QSet<Item*> found;
+    found.reserve(shown.count());
+    for (const QSharedPointer<Item> &item : shown)
+        found.insert(item.data());
+    QVector<QSharedPointer<Item>> kept = shown;
+    int count = model_->rowCount();
+    for (int row = 0; row < count; row++) {
+        QSharedPointer<Item> item = model_->itemAt(row);
+        if (item && !found.contains(item.data())
+                && PlaylistSearcher::itemMatchesFilter(item, currentFilterList))
+            kept.append(item);
+    }
+    if (kept.count() == shown.count())
+        return shown;
+    return playlist->inListOrder(kept);
+}
 
+void DrawnPlaylist::repopulateItems()
+{
     auto playlist = this->playlist();
-    if (playlist == nullptr)
+    if (playlist == nullptr || currentFilterText.isEmpty()) {
+        model_->setPlaylist(playlist);
+        setCurrentItem(lastSelectedItem);
         return;
+    }
 
+    QList<QSharedPointer<Item>> visible;
     auto itemAdder = [&](QSharedPointer<Item> item) {
         if (!item->hidden())
-            addItem(item->uuid());
+            visible.append(item);
     };
     playlist->iterateItems(itemAdder);
+    model_->setItems(playlist, visible);
     setCurrentItem(lastSelectedItem);
 }
 
-void DrawnPlaylist::model_rowsMoved(const QModelIndex &parent,
-                                     int start, int end,
-                                     const QModelIndex &destination, int row)
+void DrawnPlaylist::refilterItems(QUuid playlistUuid,
+                                  QVector<QSharedPointer<Item>> shown,
+                                  bool filtered, quint64 generation)
 {
-    Q_UNUSED(parent);
-    Q_UNUSED(destination);
-    QSharedPointer<Playlist> p = playlist();
-    if (p.isNull())
+    // The searcher says what matched, so the model only has to weigh the
+    // rows it has against those, and not the whole playlist.
+    auto playlist = this->playlist();
+    if (playlist == nullptr) {
+        clear();
         return;
-    QListWidgetItem *destinationItem = QListWidget::item(row);
-    QUuid destinationId = destinationItem ? QUuid(destinationItem->text())
-                                          : QUuid();
-    QList<QSharedPointer<Item>> itemsToGrab;
-    for (int index = start; index <= end; index++) {
-        QUuid itemUuid = QUuid(QListWidget::item(index)->text());
-        itemsToGrab.append(p->itemOf(itemUuid));
     }
-    p->takeItemsRaw(itemsToGrab);
-    p->addItems(destinationId, itemsToGrab);
+    if (playlist->uuid() != playlistUuid)
+        return;
+
+    if (!filtered) {
+        model_->unfilter();
+    } else {
+        // Items imported while the search ran are on screen but not in the
+        // result, so any that match are kept rather than merged away.
+        if (generation != playlist->generation())
+            shown = withLateMatches(playlist, shown);
+        model_->mergeItems(QList<QSharedPointer<Item>>::fromVector(shown));
+    }
+    if (!currentIndex().isValid())
+        setCurrentItem(lastSelectedItem);
 }
 
-void DrawnPlaylist::self_currentItemChanged(QListWidgetItem *current,
-                                             QListWidgetItem *previous)
+void DrawnPlaylist::self_currentChanged(const QModelIndex &current,
+                                        const QModelIndex &previous)
 {
     Q_UNUSED(previous);
-    QUuid uuid;
-    if (current && !(uuid=reinterpret_cast<PlayItem*>(current)->uuid()).isNull())
+    QUuid uuid = model_->uuidAt(current.isValid() ? current.row() : -1);
+    if (!uuid.isNull())
         lastSelectedItem = uuid;
 }
 
-void DrawnPlaylist::self_itemDoubleClicked(QListWidgetItem *item)
+void DrawnPlaylist::self_doubleClicked(const QModelIndex &index)
 {
-    PlayItem *playItem = reinterpret_cast<PlayItem*>(item);
-    emit itemDesired(playItem->playlistUuid(), playItem->uuid());
+    QSharedPointer<Item> item = model_->itemAt(index.row());
+    if (item)
+        emit itemDesired(item->playlistUuid(), item->uuid());
 }
 
 void DrawnPlaylist::self_customContextMenuRequested(const QPoint &p)
 {
-    PlayItem *playItem = reinterpret_cast<PlayItem*>(this->itemAt(p));
-    QUuid playItemUuid = playItem ? playItem->uuid() : QUuid();
+    QModelIndex index = indexAt(p);
+    QUuid playItemUuid = model_->uuidAt(index.isValid() ? index.row() : -1);
     emit contextMenuRequested(p, uuid_, playItemUuid);
 }
 
@@ -488,12 +992,3 @@ QSharedPointer<Playlist> DrawnQueue::playlist() const
 {
     return PlaylistCollection::getSingleton()->queuePlaylist();
 }
-
-void DrawnQueue::addItem(QUuid uuid)
-{
-    auto actualItem = ItemCollection::getSingleton()->itemOf(uuid);
-    if (actualItem.isNull())
-        return;
-    PlayItem *playItem = new PlayItem(uuid, actualItem->playlistUuid(), this);
-    QListWidget::addItem(playItem);
-}
@@ -1,13 +1,16 @@
 #ifndef QDRAWNPLAYLIST_H
 #define QDRAWNPLAYLIST_H
 
-#include <QListWidget>
+#include <QAbstractListModel>
+#include <QListView>
 #include <QUuid>
+#include <QVector>
 #include <functional>
 #include "playlist.h"
 
 class DisplayParser;
 class QThread;
+class QTimer;
 class PlaylistSearcher;
 
 class PlayPainter : public QAbstractItemDelegate {
@@ -21,24 +24,64 @@ public:
 };
 
 
-class PlayItem : public QListWidgetItem {
+// PlaylistModel exposes the visible items of a playlist to a view.  With no
+// filter on, rows are read straight out of the playlist; with one, they are
+// the items the searcher let through, and the uuid->row mapping for those is
+// only built when something asks for it.  The playlist is changed first and
+// the model told afterwards, except for moves, which go through moveRows().
+class PlaylistModel : public QAbstractListModel {
+    Q_OBJECT
 public:
-    PlayItem(const QUuid &uuid = QUuid(), const QUuid &playlistUuid = QUuid(), QListWidget *parent = nullptr);
-    ~PlayItem();
-
-    QUuid playlistUuid();
-    QUuid uuid();
+    PlaylistModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    Qt::ItemFlags flags(const QModelIndex &index) const;
+    Qt::DropActions supportedDropActions() const;
+    bool moveRows(const QModelIndex &sourceParent, int sourceRow, int count,
+                  const QModelIndex &destinationParent, int destinationChild);
+
+    QSharedPointer<Item> itemAt(int row) const;
+    QUuid uuidAt(int row) const;
+    int rowOf(const QUuid &uuid) const;
+
+    // Shows every item of playlist.
+    void setPlaylist(const QSharedPointer<Playlist> &playlist);
+    // Shows only items, which are in the playlist's order.
+    void setItems(const QSharedPointer<Playlist> &playlist,
+                  const QList<QSharedPointer<Item>> &items);
+    void mergeItems(const QList<QSharedPointer<Item>> &items);
+    // Goes back to showing every item, touching only the rows that differ.
+    void unfilter();
+    // Unfiltered, the rows are wherever the playlist put the items, and row
+    // is not used.
+    void insertItems(int row, const QList<QSharedPointer<Item>> &items);
+    void appendItems(const QList<QSharedPointer<Item>> &items);
+    void removeItemAt(int row);
+    void removeItemsAt(const QList<int> &indices);
+    // Drops the row of an item that has already left the playlist.
+    void forgetItem(const QUuid &uuid);
+    void clear();
 
 private:
-    QUuid playlistUuid_;
-    QUuid uuid_;
+    void copyPlaylistRows();
+    QVector<QSharedPointer<Item>> playlistItems() const;
+    void invalidateRows(int from) const;
+
+    QSharedPointer<Playlist> playlist_;
+    bool filtered = false;
+    // Rows the view has been told about while unfiltered.  The playlist may
+    // be ahead of this until the model is told what changed.
+    int count_ = 0;
+    QVector<QSharedPointer<Item>> shown;
+    // Row of every shown item.  Entries below rowsValidUntil are correct, the
+    // rest are rebuilt by rowOf when needed.
+    mutable QHash<QUuid, int> rowByUuid;
+    mutable int rowsValidUntil = 0;
 };
 
 
-// DrawnPlaylist abuses a ListWidget's items to store the uuid of playlist
-// items, which is decoded and looked up during drawing.  The alternative is a
-// subclass of QAbstractItemModel with about 1.5x the code.
-class DrawnPlaylist : public QListWidget {
+class DrawnPlaylist : public QListView {
     Q_OBJECT
 public:
     DrawnPlaylist(QWidget *parent = nullptr);
@@ -51,17 +94,24 @@ public:
     void traverseSelected(std::function<void(QUuid)> callback);
     void setCurrentItem(QUuid itemUuid);
     void scrollToItem(QUuid itemUuid);
-    virtual void addItem(QUuid uuid);
+    void addItem(QUuid uuid);
     void addItems(const QList<QUuid> &items);
     void addItemsAfter(QUuid item, const QList<QUuid> &items);
     void removeItem(QUuid uuid);
     void removeItems(const QList<int> &indicies);
     void removeAll();
+    void clear();
+
+    int count() const;
+    int currentRow() const;
+    void setCurrentRow(int row);
     template<class T>
     void sort(std::function<T(QSharedPointer<Item>)> converter,
               std::function<bool(const T &a, const T &b)> lessThan);
 
     QPair<QUuid,QUuid> importUrl(QUrl url);
+    QPair<QUuid,QUuid> importUrls(const QList<QUrl> &urls,
+                                  const QList<QVariantMap> &metadata = QList<QVariantMap>());
     void currentToQueue();
 
     QUuid nowPlayingItem();
@@ -69,43 +119,52 @@ public:
 
     QVariantMap toVMap() const;
     void fromVMap(const QVariantMap &qvm);
+    void fromPlaylist(const QSharedPointer<Playlist> &p, const QUuid &nowPlaying);
 
     void setDisplayParser(DisplayParser *parser);
     DisplayParser *displayParser();
 
     void setFilter(QString needles);
+    // Has the rows on screen probed ahead of everything else.
+    void probeVisibleItems();
 
 protected:
     bool event(QEvent *e);
+    void dropEvent(QDropEvent *event);
 
 private:
+    QVector<QSharedPointer<Item>> withLateMatches(
+            const QSharedPointer<Playlist> &playlist,
+            const QVector<QSharedPointer<Item>> &shown) const;
+
     QUuid uuid_;
-    QHash <QUuid, PlayItem*> itemsByUuid;
+    PlaylistModel *model_ = nullptr;
     QUuid lastSelectedItem;
     QUuid nowPlayingItem_;
     DisplayParser *displayParser_ = nullptr;
-    QThread *worker = nullptr;
-    PlaylistSearcher *searcher;
+    PlaylistSearcher *searcher = nullptr;
     QString currentFilterText;
     QStringList currentFilterList;
+    QTimer *probeTimer = nullptr;
 
 signals:
     // for lack of a better term that doesn't conflict with what we already
     // have, when an item is made hot by double clicking.
     void itemDesired(QUuid playlistUuid, QUuid itemUuid);
     void searcher_filterPlaylist(QSharedPointer<Playlist>, QString text);
+    void searcher_forgetPlaylist(QUuid playlist);
     void menuOpenItem(QUuid playlistUuid, QUuid itemUuid);
 
     void contextMenuRequested(QPoint p, QUuid playlistUuid, QUuid itemUuid);
 
 private slots:
     void repopulateItems();
+    void refilterItems(QUuid playlistUuid, QVector<QSharedPointer<Item>> shown,
+                       bool filtered, quint64 generation);
 
-    void model_rowsMoved(const QModelIndex & parent, int start, int end,
-                         const QModelIndex & destination, int row);
-    void self_currentItemChanged(QListWidgetItem *current,
-                                 QListWidgetItem *previous);
-    void self_itemDoubleClicked(QListWidgetItem *item);
+    void self_currentChanged(const QModelIndex &current,
+                             const QModelIndex &previous);
+    void self_doubleClicked(const QModelIndex &index);
     void self_customContextMenuRequested(const QPoint &p);
 };
 
@@ -135,7 +194,6 @@ class DrawnQueue : public DrawnPlaylist {
     Q_OBJECT
 public:
     virtual QSharedPointer<Playlist> playlist() const;
-    void addItem(QUuid uuid);
 };
 
 class PlaylistSelectionPrivate;
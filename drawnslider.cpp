@@ -264,6 +264,22 @@ void MediaSlider::setTick(double value, QString text)
     ticks.insert(value, text);
 }
 
+void MediaSlider::updateTicks(const QList<QPair<double, QString>> &gone,
+                              const QList<QPair<double, QString>> &added)
+{
+    if (gone.isEmpty() && added.isEmpty())
+        return;
+    for (const QPair<double, QString> &tick : gone) {
+        auto it = ticks.find(tick.first, tick.second);
+        if (it != ticks.end())
+            ticks.erase(it);
+    }
+    for (const QPair<double, QString> &tick : added)
+        ticks.insert(tick.first, tick.second);
+    redrawPics = true;
+    update();
+}
+
 void MediaSlider::setLoopA(double a)
 {
     vLoopA = a; updateLoopArea();
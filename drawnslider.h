@@ -71,6 +71,10 @@ public:
 
     void clearTicks();
     void setTick(double value, QString text);
+    // Takes out one tick for each of gone and puts in added, redrawing
+    // once.  Chapters may share a time, so ticks are matched by text too.
+    void updateTicks(const QList<QPair<double, QString>> &gone,
+                     const QList<QPair<double, QString>> &added);
     void setLoopA(double a);
     void setLoopB(double b);
     double loopA();
@@ -93,7 +97,7 @@ protected:
     void updateLoopArea();
 
     QString valueToTickText(double value);
-    QMap<double, QString> ticks;
+    QMultiMap<double, QString> ticks;
     double vLoopA = -1;
     double vLoopB = -1;
     QRectF loopArea = { -1, -1, 0, 0};
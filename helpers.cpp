@@ -632,10 +632,10 @@ void LogoDrawer::resizeGL(int w, int h)
     }
 }
 
-void LogoDrawer::paintGL(QOpenGLWidget *widget)
+void LogoDrawer::paintGL(QPaintDevice *device)
 {
-    QPainter painter(widget);
-    int ratio = widget->devicePixelRatio();
+    QPainter painter(device);
+    int ratio = device->devicePixelRatio();
     QRect window(-1, -1, 2*ratio, 2*ratio);
     painter.setWindow(window);
     painter.setRenderHint(QPainter::SmoothPixmapTransform);
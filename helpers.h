@@ -1,6 +1,7 @@
 // generic helper module for general-use static functions
 #ifndef HELPERS_H
 #define HELPERS_H
+#include <algorithm>
 #include <QObject>
 #include <QCoreApplication>
 #include <QWidget>
@@ -59,6 +60,33 @@ namespace Helpers {
     QVariantMap rectToVmap(const QRect &r);
     bool sizeFromString(QSize &size, const QString &text);
     bool pointFromString(QPoint &point, const QString &text);
+
+    // Where a list changed: at first, removed entries gave way to added
+    // ones, and everything before and after stayed put.
+    struct ListChange {
+        int first = 0;
+        int removed = 0;
+        int added = 0;
+        bool isEmpty() const { return removed == 0 && added == 0; }
+    };
+
+    template<class T>
+    ListChange listChange(const QList<T> &from, const QList<T> &to)
+    {
+        int common = std::min(from.count(), to.count());
+        int head = 0;
+        while (head < common && from.at(head) == to.at(head))
+            head++;
+        int tail = 0;
+        while (tail < common - head
+               && from.at(from.count() - 1 - tail) == to.at(to.count() - 1 - tail))
+            tail++;
+        ListChange change;
+        change.first = head;
+        change.removed = from.count() - head - tail;
+        change.added = to.count() - head - tail;
+        return change;
+    }
 }
 
 class IconThemer : public QObject {
@@ -94,7 +122,7 @@ public:
     void setLogoUrl(const QString &filename);
     void setLogoBackground(const QColor &color);
     void resizeGL(int w, int h);
-    void paintGL(QOpenGLWidget *widget);
+    void paintGL(QPaintDevice *device);
 
 signals:
     void logoSize(QSize size);
@@ -606,6 +606,7 @@ void MpvConnection::command_observe_property(const QVariantList &list,
     uint64_t id;
     if (list.count() != 3
             || (id = list.at(1).toULongLong())==0
+            || MpvController::isInternalPropertyId(id)
             || !list.at(2).canConvert<QString>()) {
         commandReturn(MPV_ERROR_INVALID_PARAMETER, requestId);
         return;
@@ -622,6 +623,7 @@ void MpvConnection::command_observe_property_string(const QVariantList &list,
     uint64_t id;
     if (list.count() != 3
             || (id = list.at(1).toULongLong())==0
+            || MpvController::isInternalPropertyId(id)
             || !list.at(2).canConvert<QString>())
         commandReturn(MPV_ERROR_INVALID_PARAMETER, requestId);
     else
@@ -632,7 +634,8 @@ void MpvConnection::command_unobserve_property(const QVariantList &list,
                                                const QVariant &requestId)
 {
     uint64_t id;
-    if (list.count() != 2 || (id = list.at(1).toULongLong())==0)
+    if (list.count() != 2 || (id = list.at(1).toULongLong())==0
+            || MpvController::isInternalPropertyId(id))
         commandReturn(MPV_ERROR_INVALID_PARAMETER, requestId);
     else
         commandReturn(mpvObject->controller()->unobservePropertiesById(QSet<uint64_t>() << id), requestId);
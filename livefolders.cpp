@@ -0,0 +1,378 @@
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <algorithm>
+#include <iterator>
+#include "livefolders.h"
+#include "directoryscanner.h"
+#include "playlist.h"
+
+// Changes come in bursts (a copy, an unpacked archive), so give them a
+// moment to pile up before listing the directories involved.
+constexpr int refreshDelay = 250;
+
+LiveFolders::LiveFolders(QObject *parent)
+    : QObject(parent)
+{
+    watcher = new QFileSystemWatcher(this);
+    connect(watcher, &QFileSystemWatcher::directoryChanged,
+            this, &LiveFolders::watcher_directoryChanged);
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setSingleShot(true);
+    refreshTimer->setInterval(refreshDelay);
+    connect(refreshTimer, &QTimer::timeout,
+            this, &LiveFolders::refreshPending);
+
+    auto scanner = DirectoryScanner::getSingleton().data();
+    connect(scanner, &DirectoryScanner::directoryListed,
+            this, &LiveFolders::scanner_directoryListed);
+    connect(scanner, &DirectoryScanner::scanFinished,
+            this, &LiveFolders::scanner_scanFinished);
+}
+
+LiveFolders::~LiveFolders()
+{
+    for (const QUuid &playlist : bindings.keys())
+        unbind(playlist);
+}
+
+void LiveFolders::bind(const QUuid &playlist, const QStringList &dirs)
+{
+    auto pl = PlaylistCollection::getSingleton()->playlistOf(playlist);
+    if (playlist.isNull() || !pl)
+        return;
+    unbind(playlist);
+
+    Binding &b = bindings[playlist];
+    for (const QString &dir : dirs)
+        b.roots.append(QDir::cleanPath(QFileInfo(dir).absoluteFilePath()));
+
+    // What the playlist already holds stands in for the last listings, so
+    // that on startup only what changed in the meantime is touched.
+    QSet<QString> touched;
+    pl->iterateItems([&](QSharedPointer<Item> item) {
+        QUrl url = item->url();
+        if (!url.isLocalFile())
+            return;
+        QString path = QDir::cleanPath(url.toLocalFile());
+        bool inTree = std::any_of(b.roots.constBegin(), b.roots.constEnd(),
+                                  [&path](const QString &root) {
+            return isUnder(path, root);
+        });
+        if (!inTree)
+            return;
+        b.items.insert(path, item->uuid());
+        QFileInfo info(path);
+        QString dir = info.path();
+        Folder &f = folders[dir];
+        if (f.playlist != playlist) {
+            if (f.watched)
+                watcher->removePath(dir);
+            f = Folder();
+            f.playlist = playlist;
+        }
+        f.files.append(info.fileName());
+        touched.insert(dir);
+    });
+    for (const QString &dir : touched) {
+        QStringList &files = folders[dir].files;
+        std::sort(files.begin(), files.end());
+        files.erase(std::unique(files.begin(), files.end()), files.end());
+    }
+
+    QList<QUrl> urls;
+    for (const QString &root : b.roots)
+        urls.append(QUrl::fromLocalFile(root));
+    b.walkJob = DirectoryScanner::getSingleton()->scan(urls);
+    jobs.insert(b.walkJob, { playlist, BindJob });
+}
+
+void LiveFolders::unbind(const QUuid &playlist)
+{
+    if (!bindings.contains(playlist))
+        return;
+    Binding b = bindings.take(playlist);
+    if (b.walkJob)
+        DirectoryScanner::getSingleton()->cancel(b.walkJob);
+    for (auto it = jobs.begin(); it != jobs.end();) {
+        if (it->playlist == playlist)
+            it = jobs.erase(it);
+        else
+            ++it;
+    }
+    QStringList unwatched;
+    for (auto it = folders.begin(); it != folders.end();) {
+        if (it->playlist != playlist) {
+            ++it;
+            continue;
+        }
+        if (it->watched)
+            unwatched.append(it.key());
+        pending.remove(it.key());
+        it = folders.erase(it);
+    }
+    if (!unwatched.isEmpty())
+        watcher->removePaths(unwatched);
+}
+
+bool LiveFolders::isBound(const QUuid &playlist) const
+{
+    return bindings.contains(playlist);
+}
+
+QStringList LiveFolders::directoriesOf(const QUuid &playlist) const
+{
+    return bindings.value(playlist).roots;
+}
+
+QVariantMap LiveFolders::toVMap() const
+{
+    QVariantMap qvm;
+    for (auto it = bindings.constBegin(); it != bindings.constEnd(); ++it)
+        qvm.insert(it.key().toString(), it->roots);
+    return qvm;
+}
+
+void LiveFolders::fromVMap(const QVariantMap &qvm)
+{
+    for (auto it = qvm.constBegin(); it != qvm.constEnd(); ++it)
+        bind(QUuid(it.key()), it.value().toStringList());
+}
+
+void LiveFolders::watcher_directoryChanged(const QString &path)
+{
+    QString dir = QDir::cleanPath(path);
+    if (!folders.contains(dir))
+        return;
+    pending.insert(dir);
+    if (!refreshTimer->isActive())
+        refreshTimer->start();
+}
+
+void LiveFolders::scanner_directoryListed(int job, QString dir,
+                                          QStringList files, QStringList dirs)
+{
+    if (!jobs.contains(job))
+        return;
+    Job j = jobs.value(job);
+    if (!bindings.contains(j.playlist))
+        return;
+    if (j.kind == BindJob)
+        bindings[j.playlist].walked.insert(dir);
+    applyListing(j, dir, files, dirs);
+}
+
+void LiveFolders::scanner_scanFinished(int job)
+{
+    if (!jobs.contains(job))
+        return;
+    Job j = jobs.take(job);
+    if (j.kind == BindJob && bindings.contains(j.playlist))
+        forgetStale(j.playlist);
+}
+
+void LiveFolders::refreshPending()
+{
+    auto scanner = DirectoryScanner::getSingleton();
+    for (const QString &dir : pending) {
+        if (!folders.contains(dir))
+            continue;
+        int job = scanner->refresh(dir);
+        jobs.insert(job, { folders.value(dir).playlist, RefreshJob });
+    }
+    pending.clear();
+}
+
+void LiveFolders::applyListing(const Job &job, const QString &dir,
+                               const QStringList &files, const QStringList &dirs)
+{
+    auto pl = PlaylistCollection::getSingleton()->playlistOf(job.playlist);
+    if (!pl) {
+        unbind(job.playlist);
+        return;
+    }
+    Folder previous = folders.value(dir);
+    if (previous.playlist != job.playlist)
+        previous = Folder();
+    QDir d(dir);
+    QList<QUuid> removed;
+
+    // Walks get to subdirectories by themselves, so only a directory that
+    // was listed on its own has its new ones walked.
+    if (job.kind == RefreshJob) {
+        QStringList goneDirs, newDirs;
+        std::set_difference(previous.dirs.constBegin(), previous.dirs.constEnd(),
+                            dirs.constBegin(), dirs.constEnd(),
+                            std::back_inserter(goneDirs));
+        std::set_difference(dirs.constBegin(), dirs.constEnd(),
+                            previous.dirs.constBegin(), previous.dirs.constEnd(),
+                            std::back_inserter(newDirs));
+        for (const QString &sub : goneDirs)
+            forgetTree(job.playlist, d.filePath(sub), removed);
+        if (!newDirs.isEmpty()) {
+            QList<QUrl> urls;
+            for (const QString &sub : newDirs)
+                urls.append(QUrl::fromLocalFile(d.filePath(sub)));
+            int grow = DirectoryScanner::getSingleton()->scan(urls);
+            jobs.insert(grow, { job.playlist, GrowJob });
+        }
+    }
+
+    QStringList goneFiles, newFiles;
+    std::set_difference(previous.files.constBegin(), previous.files.constEnd(),
+                        files.constBegin(), files.constEnd(),
+                        std::back_inserter(goneFiles));
+    std::set_difference(files.constBegin(), files.constEnd(),
+                        previous.files.constBegin(), previous.files.constEnd(),
+                        std::back_inserter(newFiles));
+
+    Binding &b = bindings[job.playlist];
+    QUuid renamed = goneFiles.count() == 1 && newFiles.count() == 1
+            ? b.items.value(d.filePath(goneFiles.first())) : QUuid();
+    if (!renamed.isNull() && pl->contains(renamed)) {
+        // One file out and one in is most likely a rename, so the item (and
+        // with it its place and any queueing) is kept.  Whatever was known
+        // about the old file needn't hold for the new one.
+        QString to = d.filePath(newFiles.first());
+        b.items.remove(d.filePath(goneFiles.first()));
+        b.items.insert(to, renamed);
+        pl->replaceItem(renamed, { QUrl::fromLocalFile(to) });
+        pl->setItemMetadata(renamed, QVariantMap());
+        emit itemsRenamed(job.playlist, { renamed });
+        newFiles.clear();
+    } else {
+        for (const QString &name : goneFiles) {
+            QUuid uuid = b.items.take(d.filePath(name));
+            if (uuid.isNull() || !pl->contains(uuid))
+                continue;
+            pl->removeItem(uuid);
+            removed.append(uuid);
+        }
+    }
+    if (!removed.isEmpty())
+        emit itemsRemoved(job.playlist, removed);
+
+    // New files go in after the file before them that's in the playlist, so
+    // that a directory's files stay together and in order.
+    QSet<QString> arriving = newFiles.toSet();
+    QUuid after;
+    QStringList batch;
+    auto flush = [&]() {
+        if (batch.isEmpty())
+            return;
+        QList<QUrl> urls;
+        for (const QString &name : batch)
+            urls.append(QUrl::fromLocalFile(d.filePath(name)));
+        auto items = ItemCollection::getSingleton()->addItems(urls);
+        QUuid where;
+        if (!after.isNull()) {
+            auto next = pl->itemAfter(after);
+            if (next)
+                where = next->uuid();
+        }
+        pl->addItems(where, items);
+        QList<QUuid> added;
+        for (int i = 0; i < items.count(); i++) {
+            b.items.insert(d.filePath(batch.at(i)), items.at(i)->uuid());
+            added.append(items.at(i)->uuid());
+        }
+        emit itemsAdded(job.playlist, after, added);
+        after = added.last();
+        batch.clear();
+    };
+    for (int i = 0; i < files.count() && !arriving.isEmpty(); i++) {
+        const QString &name = files.at(i);
+        if (arriving.remove(name)) {
+            batch.append(name);
+            continue;
+        }
+        QUuid uuid = b.items.value(d.filePath(name));
+        if (uuid.isNull() || !pl->contains(uuid))
+            continue;
+        flush();
+        after = uuid;
+    }
+    flush();
+
+    Folder &f = folders[dir];
+    f.playlist = job.playlist;
+    f.files = files;
+    f.dirs = dirs;
+    if (!f.watched)
+        f.watched = watcher->addPath(dir);
+}
+
+void LiveFolders::forgetTree(const QUuid &playlist, const QString &dir,
+                             QList<QUuid> &removed)
+{
+    auto pl = PlaylistCollection::getSingleton()->playlistOf(playlist);
+    Binding &b = bindings[playlist];
+    for (auto it = b.items.begin(); it != b.items.end();) {
+        if (!isUnder(it.key(), dir)) {
+            ++it;
+            continue;
+        }
+        if (pl && pl->contains(it.value())) {
+            pl->removeItem(it.value());
+            removed.append(it.value());
+        }
+        it = b.items.erase(it);
+    }
+    QStringList unwatched;
+    for (auto it = folders.begin(); it != folders.end();) {
+        if (it->playlist != playlist || !isUnder(it.key(), dir)) {
+            ++it;
+            continue;
+        }
+        if (it->watched)
+            unwatched.append(it.key());
+        pending.remove(it.key());
+        it = folders.erase(it);
+    }
+    if (!unwatched.isEmpty())
+        watcher->removePaths(unwatched);
+}
+
+void LiveFolders::forgetStale(const QUuid &playlist)
+{
+    // Anything in a directory the walk didn't come across is gone.
+    auto pl = PlaylistCollection::getSingleton()->playlistOf(playlist);
+    Binding &b = bindings[playlist];
+    QList<QUuid> removed;
+    for (auto it = b.items.begin(); it != b.items.end();) {
+        if (b.walked.contains(QFileInfo(it.key()).path())) {
+            ++it;
+            continue;
+        }
+        if (pl && pl->contains(it.value())) {
+            pl->removeItem(it.value());
+            removed.append(it.value());
+        }
+        it = b.items.erase(it);
+    }
+    QStringList unwatched;
+    for (auto it = folders.begin(); it != folders.end();) {
+        if (it->playlist != playlist || b.walked.contains(it.key())) {
+            ++it;
+            continue;
+        }
+        if (it->watched)
+            unwatched.append(it.key());
+        it = folders.erase(it);
+    }
+    if (!unwatched.isEmpty())
+        watcher->removePaths(unwatched);
+    b.walked.clear();
+    b.walkJob = 0;
+    if (!removed.isEmpty())
+        emit itemsRemoved(playlist, removed);
+}
+
+bool LiveFolders::isUnder(const QString &path, const QString &dir)
+{
+    if (path == dir)
+        return true;
+    return path.startsWith(dir.endsWith('/') ? dir : dir + '/');
+}
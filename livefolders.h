@@ -0,0 +1,88 @@
+#ifndef LIVEFOLDERS_H
+#define LIVEFOLDERS_H
+// Playlists that follow directories.  A bound playlist is filled by walking
+// its directories in the background, and from then on every directory in
+// the tree is watched.  When one changes, only that directory is listed
+// again and compared with what it held before, so files coming and going
+// (or being renamed) cost a single listing rather than a rescan.
+//
+// Changes are made through the playlist itself, and announced so that the
+// views can follow along.  A directory follows one playlist at a time.
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QUuid>
+#include <QVariantMap>
+
+class QFileSystemWatcher;
+class QTimer;
+class LiveFolders : public QObject {
+    Q_OBJECT
+public:
+    explicit LiveFolders(QObject *parent = nullptr);
+    ~LiveFolders();
+
+    // Makes playlist follow the trees under dirs.  Items already in it that
+    // belong to the trees are kept, and those whose files are gone removed.
+    void bind(const QUuid &playlist, const QStringList &dirs);
+    // The playlist keeps its items, but stops following its directories.
+    void unbind(const QUuid &playlist);
+    bool isBound(const QUuid &playlist) const;
+    QStringList directoriesOf(const QUuid &playlist) const;
+
+    QVariantMap toVMap() const;
+    void fromVMap(const QVariantMap &qvm);
+
+signals:
+    // after is the item they were put after, or null if they were appended.
+    void itemsAdded(QUuid playlist, QUuid after, QList<QUuid> items);
+    void itemsRemoved(QUuid playlist, QList<QUuid> items);
+    void itemsRenamed(QUuid playlist, QList<QUuid> items);
+
+private slots:
+    void watcher_directoryChanged(const QString &path);
+    void scanner_directoryListed(int job, QString dir, QStringList files,
+                                 QStringList dirs);
+    void scanner_scanFinished(int job);
+    void refreshPending();
+
+private:
+    enum JobKind { BindJob, GrowJob, RefreshJob };
+    struct Job {
+        QUuid playlist;
+        JobKind kind;
+    };
+    struct Folder {
+        QUuid playlist;
+        QStringList files;
+        QStringList dirs;
+        bool watched = false;
+    };
+    struct Binding {
+        QStringList roots;
+        // Items by the path of their file.
+        QHash<QString, QUuid> items;
+        // Directories seen by the walk that filled the playlist.
+        QSet<QString> walked;
+        int walkJob = 0;
+    };
+
+    void applyListing(const Job &job, const QString &dir,
+                      const QStringList &files, const QStringList &dirs);
+    void forgetTree(const QUuid &playlist, const QString &dir,
+                    QList<QUuid> &removed);
+    void forgetStale(const QUuid &playlist);
+    void removeItems(const QUuid &playlist, const QStringList &paths);
+    static bool isUnder(const QString &path, const QString &dir);
+
+    QFileSystemWatcher *watcher = nullptr;
+    QTimer *refreshTimer = nullptr;
+    QHash<QUuid, Binding> bindings;
+    QHash<QString, Folder> folders;
+    QHash<int, Job> jobs;
+    QSet<QString> pending;
+};
+
+#endif // LIVEFOLDERS_H
@@ -18,6 +18,11 @@
 #include "storage.h"
 #include "mainwindow.h"
 #include "manager.h"
+#include "mediainfocache.h"
+#include "mediaprober.h"
+#include "playlist.h"
+#include "playlistreader.h"
+#include "playlistsaver.h"
 #include "settingswindow.h"
 #include "mpvwidget.h"
 #include "propertieswindow.h"
@@ -51,6 +56,10 @@ int main(int argc, char *argv[])
     qRegisterMetaType<MpvController::OptionList>("MpvController::OptionList");
     qRegisterMetaType<MpvErrorCode>("MpvErrorCode");
     qRegisterMetaType<uint64_t>("uint64_t");
+    qRegisterMetaType<QList<PlaylistStore::Tab>>("QList<PlaylistStore::Tab>");
+    qRegisterMetaType<QList<PlaylistReader::Entry>>("QList<PlaylistReader::Entry>");
+    qRegisterMetaType<QVector<QSharedPointer<Item>>>("QVector<QSharedPointer<Item>>");
+    qRegisterMetaType<MediaProber::Results>("MediaProber::Results");
 
     QTranslator qtTranslator;
     qtTranslator.load("qt_" + QLocale::system().name(),
@@ -93,8 +102,14 @@ Flow::~Flow()
         mpvServer = nullptr;
     }
     if (mainWindow) {
-        if (programMode == PrimaryMode)
-            storage.writeVList("playlists", mainWindow->playlistWindow()->tabsToVList());
+        MediaProber::getSingleton()->stop();
+        if (programMode == PrimaryMode) {
+            storage.writeCache("mediainfo", MediaInfoCache::getSingleton()->toData());
+            playlistSaver->save(mainWindow->playlistWindow()->tabsToStore());
+            playlistSaver->finish();
+            storage.writeVMap("livefolders", mainWindow->playlistWindow()->liveFoldersToVMap());
+            storage.writeIndex("playlists", PlaylistCollection::getSingleton()->searchIndexesToData());
+        }
         delete mainWindow;
         mainWindow = nullptr;
     }
@@ -123,6 +138,10 @@ Flow::~Flow()
         delete thumbnailerWindow;
         thumbnailerWindow = nullptr;
     }
+    if (thumbnailJobs) {
+        delete thumbnailJobs;
+        thumbnailJobs = nullptr;
+    }
     if (logWindow) {
         delete logWindow;
         logWindow = nullptr;
@@ -147,19 +166,29 @@ void Flow::parseArgs()
     QCommandLineOption noFilesOpt("no-files", tr("Do not load file history, playlists, or favorites."));
     QCommandLineOption sizeOpt("size", tr("Main window size."), "w,h");
     QCommandLineOption posOpt("pos", tr("Main window position."), "x,y");
+    QCommandLineOption nativeVideoOpt("native-video", tr("Draw video straight to a native window. Controls are not shown over it."));
+    QCommandLineOption thumbnailOpt("thumbnail", tr("Make thumbnail sheets of the urls, and of any left over from a previous run, then quit. No window is shown."));
+    QCommandLineOption softwareRenderOpt("software-render", tr("Make thumbnail sheets without the graphics card."));
 
     parser.addOption(freestandingOpt);
     parser.addOption(noConfigOpt);
     parser.addOption(noFilesOpt);
     parser.addOption(sizeOpt);
     parser.addOption(posOpt);
+    parser.addOption(nativeVideoOpt);
+    parser.addOption(thumbnailOpt);
+    parser.addOption(softwareRenderOpt);
     parser.addPositionalArgument("urls", tr("URLs to open, optionally."), "[urls...]");
 
     parser.process(QCoreApplication::arguments());
 
     programMode = parser.isSet(freestandingOpt) ? FreestandingMode : UnknownMode;
+    if (parser.isSet(thumbnailOpt))
+        programMode = ThumbnailMode;
     cliNoConfig = parser.isSet(noConfigOpt);
     cliNoFiles = parser.isSet(noFilesOpt);
+    cliNativeVideo = parser.isSet(nativeVideoOpt);
+    cliSoftwareRender = parser.isSet(softwareRenderOpt);
     validCliSize = parser.isSet(sizeOpt) && Helpers::sizeFromString(cliSize, parser.value(sizeOpt));
     validCliPos = parser.isSet(posOpt) && Helpers::pointFromString(cliPos, parser.value(posOpt));
     customFiles = parser.positionalArguments();
@@ -192,7 +221,25 @@ void Flow::init() {
     connect(logThread, &QThread::finished,
             logger, &QObject::deleteLater);
 
+    thumbnailJobs = new ThumbnailJobs(this);
+    thumbnailJobs->setSoftwareRender(cliSoftwareRender);
+    connect(thumbnailJobs, &ThumbnailJobs::changed,
+            this, &Flow::thumbnailjobs_changed);
+    if (!cliNoFiles && (programMode == PrimaryMode || programMode == ThumbnailMode)
+            && thumbnailJobs->claimSavedQueue(Storage::fetchConfigPath() + "/thumbnailjobs.lock"))
+        thumbnailJobs->fromVMap(storage.readVMap("thumbnailjobs"));
+    if (programMode == ThumbnailMode) {
+        // Nothing else is needed to make sheets.
+        QList<QUrl> urls;
+        for (const QString &file : customFiles)
+            urls.append(QUrl::fromUserInput(file, QDir::currentPath(), QUrl::AssumeLocalFile));
+        thumbnailJobs->enqueue(urls);
+        return;
+    }
+
     mainWindow = new MainWindow();
+    if (cliNativeVideo)
+        mainWindow->setMpvWidgetType(Helpers::EmbedWidget);
     playbackManager = new PlaybackManager(this);
     playbackManager->setMpvObject(mainWindow->mpvObject(), true);
     playbackManager->setPlaylistWindow(mainWindow->playlistWindow());
@@ -202,6 +249,7 @@ void Flow::init() {
     favoritesWindow = new FavoritesWindow();
     logWindow = new LogWindow();
     thumbnailerWindow = new ThumbnailerWindow();
+    playlistSaver = new PlaylistSaver(this);
 
     server = new MpcQtServer(mainWindow, playbackManager, this);
     server->setMainWindow(mainWindow);
@@ -265,9 +313,46 @@ void Flow::init() {
 
 int Flow::run()
 {
-    auto playlist = cliNoFiles ? QVariantList() : storage.readVList("playlists");
+    if (programMode == ThumbnailMode) {
+        // The players' offscreen widgets coming and going mustn't end it.
+        qApp->setQuitOnLastWindowClosed(false);
+        connect(thumbnailJobs, &ThumbnailJobs::finished,
+                qApp, &QCoreApplication::quit, Qt::QueuedConnection);
+        QMetaObject::invokeMethod(thumbnailJobs, "start", Qt::QueuedConnection);
+        return qApp->exec();
+    }
+
+    QList<PlaylistStore::Tab> tabs;
     auto geometry = cliNoConfig ? QVariantMap() : storage.readVMap("geometry");
-    mainWindow->playlistWindow()->tabsFromVList(playlist);
+    bool stored = !cliNoFiles && storage.hasPlaylists("playlists");
+    if (stored && playlistSaver->restore(tabs)) {
+        mainWindow->playlistWindow()->tabsFromStore(tabs);
+    } else if (stored) {
+        // The store was there but couldn't be read, and has been set aside.
+        // The json file predates it, so bringing that back would only hand
+        // the user an older library as if nothing had happened.
+        mainWindow->playlistWindow()->tabsFromVList(QVariantList());
+    } else {
+        // Without a binary store, fall back to (and migrate from) the json
+        // file older versions saved.
+        auto playlist = cliNoFiles ? QVariantList() : storage.readVList("playlists");
+        mainWindow->playlistWindow()->tabsFromVList(playlist);
+    }
+    if (!cliNoFiles) {
+        PlaylistCollection::getSingleton()->searchIndexesFromData(storage.readIndex("playlists"));
+        MediaInfoCache::getSingleton()->fromData(storage.readCache("mediainfo"));
+    }
+    // Everything from here on is a change to what was just read in.
+    PlaylistCollection::getSingleton()->journal()->setRecording(true);
+    if (programMode == PrimaryMode) {
+        playlistSaver->start();
+        // Catching up with the folders changes the playlists, so it has to
+        // come after recording starts.
+        if (!cliNoFiles)
+            mainWindow->playlistWindow()->liveFoldersFromVMap(storage.readVMap("livefolders"));
+        // Carry on with sheets that a previous run didn't get to.
+        QMetaObject::invokeMethod(thumbnailJobs, "start", Qt::QueuedConnection);
+    }
     restoreWindows(geometry);
     return qApp->exec();
 }
@@ -312,6 +397,8 @@ void Flow::setupMainWindowConnections()
     // mainwindow -> manager
     connect(mainWindow, &MainWindow::severalFilesOpened,
             playbackManager, &PlaybackManager::openSeveralFiles);
+    connect(mainWindow, &MainWindow::directoryOpened,
+            playbackManager, &PlaybackManager::openDirectory);
     connect(mainWindow, &MainWindow::fileOpened,
             playbackManager, &PlaybackManager::openFile);
     connect(mainWindow, &MainWindow::dvdbdOpened,
@@ -388,6 +475,8 @@ void Flow::setupMainWindowConnections()
             mainWindow, &MainWindow::setTime);
     connect(playbackManager, &PlaybackManager::titleChanged,
             mainWindow, &MainWindow::setMediaTitle);
+    connect(playbackManager, &PlaybackManager::nowPlayingChanged,
+            mainWindow, &MainWindow::setNowPlaying);
     connect(playbackManager, &PlaybackManager::chapterTitleChanged,
             mainWindow, &MainWindow::setChapterTitle);
     connect(playbackManager, &PlaybackManager::videoSizeChanged,
@@ -572,6 +661,10 @@ void Flow::setupMpvObjectConnections()
     connect(mpvObject, &MpvObject::chaptersChanged,
             propertiesWindow, &PropertiesWindow::setChapters);
 
+    // manager -> properties
+    connect(playbackManager, &PlaybackManager::mediaInfoCached,
+            propertiesWindow, &PropertiesWindow::setMediaInfo);
+
     // settingswindow -> log
     auto logger = Logger::singleton();
     connect(settingsWindow, &SettingsWindow::loggingEnabled,
@@ -637,10 +730,14 @@ void Flow::setupFlowConnections()
             this, &Flow::settingswindow_screenshotFormat);
 
     // playlistwindow -> this.storage
-    connect(mainWindow->playlistWindow(), &PlaylistWindow::importPlaylist,
-            this, &Flow::importPlaylist);
     connect(mainWindow->playlistWindow(), &PlaylistWindow::exportPlaylist,
             this, &Flow::exportPlaylist);
+    connect(mainWindow->playlistWindow(), &PlaylistWindow::exportPlaylistData,
+            this, &Flow::exportPlaylistData);
+
+    // playlistwindow -> this.thumbnailjobs
+    connect(mainWindow->playlistWindow(), &PlaylistWindow::thumbnailSheetsRequested,
+            this, &Flow::playlistwindow_thumbnailSheetsRequested);
 
     // manager -> this.screensaver
     connect(playbackManager, &PlaybackManager::systemShouldHibernate,
@@ -658,6 +755,10 @@ void Flow::setupFlowConnections()
     connect(favoritesWindow, &FavoritesWindow::favoriteTracks,
             this, &Flow::favoriteswindow_favoriteTracks);
 
+    // playlistsaver -> this
+    connect(playlistSaver, &PlaylistSaver::saveDue,
+            this, &Flow::playlistsaver_saveDue);
+
     // this.screensaver -> this
     connect(screenSaver, &ScreenSaver::systemShutdown,
             this, &Flow::endProgram);
@@ -1090,20 +1191,37 @@ void Flow::favoriteswindow_favoriteTracks(const QList<TrackInfo> &files, const Q
     favoriteStreams = streams;
 }
 
+void Flow::playlistsaver_saveDue()
+{
+    playlistSaver->save(mainWindow->playlistWindow()->tabsToStore());
+}
+
+void Flow::playlistwindow_thumbnailSheetsRequested(const QList<QUrl> &urls)
+{
+    thumbnailJobs->setOutput(screenshotDirectory, screenshotFormat);
+    thumbnailJobs->enqueue(urls);
+    thumbnailJobs->start();
+}
+
+void Flow::thumbnailjobs_changed()
+{
+    if (thumbnailJobs->ownsSavedQueue())
+        storage.writeVMap("thumbnailjobs", thumbnailJobs->toVMap());
+}
+
 void Flow::endProgram()
 {
     writeConfig();
     qApp->quit();
 }
 
-void Flow::importPlaylist(QString fname)
+void Flow::exportPlaylist(QString fname, QStringList items)
 {
-    //CHECKME: addSimplePlaylist should be a slot?
-    mainWindow->playlistWindow()->addSimplePlaylist(storage.readM3U(fname));
+    storage.writeM3U(fname, items);
 }
 
-void Flow::exportPlaylist(QString fname, QStringList items)
+void Flow::exportPlaylistData(QString fname, QVariantMap data)
 {
-    storage.writeM3U(fname, items);
+    storage.exportVMap(fname, data);
 }
 
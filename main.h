@@ -12,16 +12,19 @@
 #include "propertieswindow.h"
 #include "favoriteswindow.h"
 #include "thumbnailerwindow.h"
+#include "thumbnailjobs.h"
 #include "platform/screensaver.h"
 #include "platform/devicemanager.h"
 
 class MprisInstance;
+class PlaylistSaver;
 class QThread;
 
 // a simple class to control program exection and own application objects
 class Flow : public QObject {
     Q_OBJECT
-    enum ProgramMode { UnknownMode, EarlyQuitMode, PrimaryMode, FreestandingMode, };
+    enum ProgramMode { UnknownMode, EarlyQuitMode, PrimaryMode, FreestandingMode,
+                       ThumbnailMode, };
 
 public:
     explicit Flow(QObject *owner = nullptr);
@@ -78,10 +81,13 @@ private slots:
     void settingswindow_encodeTemplate(const QString &fmt);
     void settingswindow_screenshotFormat(const QString &fmt);
     void favoriteswindow_favoriteTracks(const QList<TrackInfo> &files, const QList<TrackInfo> &streams);
+    void playlistsaver_saveDue();
+    void playlistwindow_thumbnailSheetsRequested(const QList<QUrl> &urls);
+    void thumbnailjobs_changed();
 
     void endProgram();
-    void importPlaylist(QString fname);
     void exportPlaylist(QString fname, QStringList items);
+    void exportPlaylistData(QString fname, QVariantMap data);
 
 private:
     MpcQtServer *server = nullptr;
@@ -95,6 +101,8 @@ private:
     FavoritesWindow *favoritesWindow = nullptr;
     LogWindow *logWindow = nullptr;
     ThumbnailerWindow *thumbnailerWindow = nullptr;
+    PlaylistSaver *playlistSaver = nullptr;
+    ThumbnailJobs *thumbnailJobs = nullptr;
     QThread *logThread = nullptr;
     Storage storage;
     QVariantMap settings;
@@ -106,6 +114,8 @@ private:
     ProgramMode programMode = UnknownMode;
     bool cliNoConfig = false;
     bool cliNoFiles = false;
+    bool cliNativeVideo = false;
+    bool cliSoftwareRender = false;
     QSize cliSize;
     QPoint cliPos;
     bool validCliSize = false;
@@ -568,6 +568,13 @@ void MainWindow::setupPositionSlider()
             this, &MainWindow::position_sliderMoved);
     connect(positionSlider_, &MediaSlider::hoverValue,
             this, &MainWindow::position_hoverValue);
+    connect(positionSlider_, &MediaSlider::hoverEnd,
+            this, &MainWindow::position_hoverEnd);
+
+    seekPreviewer = new SeekPreviewer(this);
+    connect(seekPreviewer, &SeekPreviewer::frameReady,
+            this, &MainWindow::seekPreviewer_frameReady, Qt::QueuedConnection);
+    seekPreview = new QLabel(positionSlider_, Qt::ToolTip);
 }
 
 void MainWindow::setupVolumeSlider()
@@ -601,6 +608,11 @@ void MainWindow::setupMpvObject()
             this, &MainWindow::setNoVideoSize);
 }
 
+void MainWindow::setMpvWidgetType(Helpers::MpvWidgetType widgetType)
+{
+    setupMpvWidget(widgetType);
+}
+
 void MainWindow::setupMpvWidget(Helpers::MpvWidgetType widgetType)
 {
     bool embeddedBottomArea = ui->bottomArea->parentWidget() == mpvw;
@@ -1086,6 +1098,58 @@ void MainWindow::updateDiscList()
     ui->menuFileOpenDisc->setEnabled(addedSomething);
 }
 
+void MainWindow::updateSeekPreview()
+{
+    // The frame sits above the time tooltip, centered on the cursor.
+    QImage frame = seekPreviewer->frameAt(hoverTime);
+    if (frame.isNull()) {
+        seekPreview->hide();
+        return;
+    }
+    seekPreview->setPixmap(QPixmap::fromImage(frame));
+    seekPreview->resize(frame.size());
+    int y = (timeTooltipAbove ? -40 : 0) - frame.height() - 4;
+    seekPreview->move(positionSlider_->mapToGlobal(QPoint(int(hoverX) - frame.width() / 2, y)));
+    seekPreview->show();
+}
+
+void MainWindow::updateMenuItems(QMenu *menu, QList<QAction *> &actions,
+                                 const QList<QPair<int64_t, QString>> &items,
+                                 Helpers::ListChange change,
+                                 void (MainWindow::*selected)(int64_t))
+{
+    // Should the menu not hold the list the change was taken against,
+    // rebuild all of it.
+    if (change.first + change.removed > actions.count()
+            || actions.count() - change.removed + change.added != items.count())
+        change = { 0, actions.count(), items.count() };
+
+    // Only the changed stretch of actions is deleted and recreated.
+    for (int i = 0; i < change.removed; i++)
+        delete actions.takeAt(change.first);
+    QAction *before = actions.value(change.first);
+    for (int i = change.first; i < change.first + change.added; i++) {
+        const QPair<int64_t,QString> &item = items.at(i);
+        QAction *action = new QAction(item.second, this);
+        action->setData(qlonglong(item.first));
+        connect(action, &QAction::triggered, this, [this,action,selected]() {
+            emit (this->*selected)(action->data().toLongLong());
+        });
+        menu->insertAction(before, action);
+        actions.insert(i, action);
+    }
+
+    // The actions after it kept their text, but their ids may have moved
+    // along with their position (chapter ids are indices).
+    if (change.removed == change.added)
+        return;
+    for (int i = change.first + change.added; i < items.count(); i++) {
+        QAction *action = actions.at(i);
+        if (action->data().toLongLong() != items.at(i).first)
+            action->setData(qlonglong(items.at(i).first));
+    }
+}
+
 QList<QUrl> MainWindow::doQuickOpenFileDialog()
 {
     QList<QUrl> urls;
@@ -1220,6 +1284,11 @@ void MainWindow::setMediaTitle(QString title)
     setWindowTitle(window_title);
 }
 
+void MainWindow::setNowPlaying(QUrl url)
+{
+    seekPreviewer->open(url);
+}
+
 void MainWindow::setChapterTitle(QString title)
 {
     ui->chapter->setText(!title.isEmpty() ? title : "-");
@@ -1334,6 +1403,8 @@ void MainWindow::setPlaybackState(PlaybackManager::PlaybackState state)
     isPlaying = state != PlaybackManager::StoppedState;
     isPaused = state == PlaybackManager::PausedState;
     setUiEnabledState(state != PlaybackManager::StoppedState);
+    if (state == PlaybackManager::StoppedState)
+        seekPreviewer->close();
     if (isPaused) {
         ui->actionPlayPause->setChecked(true);
         ui->pause->setChecked(true);
@@ -1351,77 +1422,63 @@ void MainWindow::setPlaybackType(PlaybackManager::PlaybackType type)
     setUiEnabledState(type != PlaybackManager::None);
 }
 
-void MainWindow::setChapters(QList<QPair<double, QString>> chapters)
+void MainWindow::setChapters(QList<QPair<double, QString>> chapters,
+                             Helpers::ListChange change)
 {
-    positionSlider_->clearTicks();
-    ui->menuNavigateChapters->clear();
+    if (change.first + change.removed > chapterList.count()
+            || chapterList.count() - change.removed + change.added != chapters.count())
+        change = { 0, chapterList.count(), chapters.count() };
+    positionSlider_->updateTicks(chapterList.mid(change.first, change.removed),
+                                 chapters.mid(change.first, change.added));
+    chapterList = chapters;
+
+    QList<QPair<int64_t,QString>> items;
     int64_t index = 0;
-    for (const QPair<double,QString> &chapter : chapters) {
-        positionSlider_->setTick(chapter.first, chapter.second);
-        QAction *action = new QAction(this);
-        action->setText(chapter.second);
-        connect (action, &QAction::triggered, [this,index]() {
-           emit chapterSelected(index);
-        });
-        ui->menuNavigateChapters->addAction(action);
-        ++index;
-    }
+    for (const QPair<double,QString> &chapter : chapters)
+        items.append({ index++, chapter.second });
+    updateMenuItems(ui->menuNavigateChapters, chapterActions, items, change,
+                    &MainWindow::chapterSelected);
 }
 
-void MainWindow::setAudioTracks(QList<QPair<int64_t, QString>> tracks)
+void MainWindow::setAudioTracks(QList<QPair<int64_t, QString>> tracks,
+                                Helpers::ListChange change)
 {
-    ui->menuPlayAudio->clear();
-    for (const QPair<int64_t, QString> &track : tracks) {
-        QAction *action = new QAction(this);
-        action->setText(track.second);
-        int64_t index = track.first;
-        connect(action, &QAction::triggered, [this,index] {
-            emit audioTrackSelected(index);
-        });
-        ui->menuPlayAudio->addAction(action);
-    }
+    updateMenuItems(ui->menuPlayAudio, audioTrackActions, tracks, change,
+                    &MainWindow::audioTrackSelected);
     hasAudio = !tracks.isEmpty();
 }
 
-void MainWindow::setVideoTracks(QList<QPair<int64_t, QString>> tracks)
+void MainWindow::setVideoTracks(QList<QPair<int64_t, QString>> tracks,
+                                Helpers::ListChange change)
 {
-    ui->menuPlayVideo->clear();
-    for (const QPair<int64_t, QString> &track : tracks) {
-        QAction *action = new QAction(this);
-        action->setText(track.second);
-        int64_t index = track.first;
-        connect(action, &QAction::triggered, [this,index]() {
-           emit videoTrackSelected(index);
-        });
-        ui->menuPlayVideo->addAction(action);
-    }
+    updateMenuItems(ui->menuPlayVideo, videoTrackActions, tracks, change,
+                    &MainWindow::videoTrackSelected);
     hasVideo = !tracks.isEmpty();
     updateOnTop();
 }
 
-void MainWindow::setSubtitleTracks(QList<QPair<int64_t, QString> > tracks)
+void MainWindow::setSubtitleTracks(QList<QPair<int64_t, QString> > tracks,
+                                   Helpers::ListChange change)
 {
-    ui->menuPlaySubtitles->clear();
     hasSubs = !tracks.isEmpty();
     ui->actionPlaySubtitlesEnabled->setEnabled(hasSubs);
     ui->subs->setEnabled(hasSubs);
     ui->actionPlaySubtitlesNext->setEnabled(hasSubs);
     ui->actionPlaySubtitlesPrevious->setEnabled(hasSubs);
-    if (!hasSubs)
+    if (!hasSubs) {
+        updateMenuItems(ui->menuPlaySubtitles, subtitleTrackActions, tracks,
+                        change, &MainWindow::subtitleTrackSelected);
+        ui->menuPlaySubtitles->clear();
         return;
-    ui->menuPlaySubtitles->addAction(ui->actionPlaySubtitlesEnabled);
-    ui->menuPlaySubtitles->addAction(ui->actionPlaySubtitlesNext);
-    ui->menuPlaySubtitles->addAction(ui->actionPlaySubtitlesPrevious);
-    ui->menuPlaySubtitles->addSeparator();
-    for (const QPair<int64_t, QString> &track : tracks) {
-        QAction *action = new QAction(this);
-        action->setText(track.second);
-        int64_t index = track.first;
-        connect(action, &QAction::triggered, [this,index]() {
-            emit subtitleTrackSelected(index);
-        });
-        ui->menuPlaySubtitles->addAction(action);
     }
+    if (ui->menuPlaySubtitles->isEmpty()) {
+        ui->menuPlaySubtitles->addAction(ui->actionPlaySubtitlesEnabled);
+        ui->menuPlaySubtitles->addAction(ui->actionPlaySubtitlesNext);
+        ui->menuPlaySubtitles->addAction(ui->actionPlaySubtitlesPrevious);
+        ui->menuPlaySubtitles->addSeparator();
+    }
+    updateMenuItems(ui->menuPlaySubtitles, subtitleTrackActions, tracks,
+                    change, &MainWindow::subtitleTrackSelected);
 }
 
 void MainWindow::setVolume(int level)
@@ -1561,16 +1618,9 @@ void MainWindow::on_actionFileOpenDirectory_triggered()
         return;
     lastDir = url;
 
-    // If we pass the directory and let Helpers::filterUrls handle it,
-    // we may freeze if the user selects the root folder.  So only
-    // pass through the folder contents for now.  To expand all
-    // subfolders, Drag-and-drop or pass folders through the cli.
-    QDir dir(url.toLocalFile());
-    QList<QUrl> list;
-    QFileInfoList f = dir.entryInfoList(QDir::NoDotAndDotDot | QDir::Files);
-    for (auto &file : f)
-        list.append(QUrl::fromLocalFile(file.absoluteFilePath()));
-    emit severalFilesOpened(list);
+    // The whole tree is scanned in the background, so even the root folder
+    // won't freeze us.
+    emit directoryOpened(url);
 }
 
 void MainWindow::on_actionFileOpenNetworkStream_triggered()
@@ -2233,7 +2283,21 @@ void MainWindow::position_hoverValue(double value, QString text, double x)
     QPoint where = positionSlider_->mapToGlobal(QPoint(int(x), timeTooltipAbove ? -40 : 0));
     QToolTip::showText(where, t, positionSlider_);
 
-    //FIXME: use a widget not the system tooltip?
+    hoverTime = value;
+    hoverX = x;
+    updateSeekPreview();
+}
+
+void MainWindow::position_hoverEnd()
+{
+    hoverTime = -1;
+    seekPreview->hide();
+}
+
+void MainWindow::seekPreviewer_frameReady()
+{
+    if (hoverTime >= 0)
+        updateSeekPreview();
 }
 
 void MainWindow::on_play_clicked()
@@ -1,6 +1,7 @@
 #ifndef HOSTWINDOW_H
 #define HOSTWINDOW_H
 
+#include <QLabel>
 #include <QMainWindow>
 #include <mpvwidget.h>
 #include <QMenuBar>
@@ -10,6 +11,7 @@
 #include "drawnstatus.h"
 #include "manager.h"
 #include "playlistwindow.h"
+#include "seekpreviewer.h"
 #include "platform/screensaver.h"
 
 namespace Ui {
@@ -42,6 +44,7 @@ public:
     QSize desirableSize(bool first_run = false);
     QPoint desirablePosition(QSize &size, bool first_run = false);
     void unfreezeWindow();
+    void setMpvWidgetType(Helpers::MpvWidgetType widgetType);
 
 protected:
     void resizeEvent(QResizeEvent *event);
@@ -102,12 +105,18 @@ private:
     void updateWindowFlags();
     void updateMouseHideTime();
     void updateDiscList();
+    void updateSeekPreview();
+    void updateMenuItems(QMenu *menu, QList<QAction*> &actions,
+                         const QList<QPair<int64_t,QString>> &items,
+                         Helpers::ListChange change,
+                         void (MainWindow::*selected)(int64_t));
     QList<QUrl> doQuickOpenFileDialog();
 
 signals:
     void instanceShouldQuit();
     void fileOpened(QUrl what, QUrl subs);
     void severalFilesOpened(QList<QUrl> what, bool important = false);
+    void directoryOpened(QUrl where);
     void severalFilesOpenedForPlaylist(QUuid destination, QList<QUrl> what);
     void dvdbdOpened(QUrl what);
     void streamOpened(QUrl what);
@@ -162,6 +171,7 @@ public slots:
     void setInfoColors(const QColor &foreground, const QColor &background);
     void setTime(double time, double length);
     void setMediaTitle(QString title);
+    void setNowPlaying(QUrl url);
     void setChapterTitle(QString title);
     void setVideoSize(QSize size);
     void setVolumeStep(int stepSize);
@@ -178,10 +188,14 @@ public slots:
     void setFullscreenHidePanels(bool hidden);
     void setPlaybackState(PlaybackManager::PlaybackState state);
     void setPlaybackType(PlaybackManager::PlaybackType type);
-    void setChapters(QList<QPair<double,QString>> chapters);
-    void setAudioTracks(QList<QPair<int64_t,QString>> tracks);
-    void setVideoTracks(QList<QPair<int64_t,QString>> tracks);
-    void setSubtitleTracks(QList<QPair<int64_t,QString>> tracks);
+    void setChapters(QList<QPair<double,QString>> chapters,
+                     Helpers::ListChange change);
+    void setAudioTracks(QList<QPair<int64_t,QString>> tracks,
+                        Helpers::ListChange change);
+    void setVideoTracks(QList<QPair<int64_t,QString>> tracks,
+                        Helpers::ListChange change);
+    void setSubtitleTracks(QList<QPair<int64_t,QString>> tracks,
+                           Helpers::ListChange change);
     void setVolume(int level);
     void setVolumeDouble(double level);
     void setVolumeMax(int level);
@@ -308,6 +322,8 @@ private slots:
     void mpvw_customContextMenuRequested(const QPoint &pos);
     void position_sliderMoved(int position);
     void position_hoverValue(double value, QString text, double x);
+    void position_hoverEnd();
+    void seekPreviewer_frameReady();
     void on_play_clicked();
     void volume_sliderMoved(double position);
     void playlistWindow_windowDocked();
@@ -328,6 +344,8 @@ private:
     //MpvGlCbWidget *mpvw = nullptr;
     MediaSlider *positionSlider_ = nullptr;
     VolumeSlider *volumeSlider_ = nullptr;
+    SeekPreviewer *seekPreviewer = nullptr;
+    QLabel *seekPreview = nullptr;
     StatusTime *timePosition = nullptr;
     StatusTime *timeDuration = nullptr;
     PlaylistWindow *playlistWindow_ = nullptr;
@@ -344,6 +362,8 @@ private:
     int bottomAreaHideTime = 0;
     bool timeTooltipShown = true;
     bool timeTooltipAbove = true;
+    double hoverTime = -1;
+    double hoverX = 0;
 
     QString previousOpenDir;
     QSize noVideoSize_ = QSize(500,270);
@@ -369,6 +389,11 @@ private:
 
     IconThemer themer;
     QList<QAction *> menuFavoritesTail;
+    QList<QAction *> chapterActions;
+    QList<QPair<double,QString>> chapterList;
+    QList<QAction *> audioTrackActions;
+    QList<QAction *> videoTrackActions;
+    QList<QAction *> subtitleTrackActions;
     MouseStateMap mouseMapWindowed;
     MouseStateMap mouseMapFullscreen;
 };
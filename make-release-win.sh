@@ -41,6 +41,7 @@ libpcre2-16-0.dll
 libpng16-16.dll
 libstdc++-6.dll
 libwinpthread-1.dll
+Qt5Concurrent.dll
 Qt5Core.dll
 Qt5Gui.dll
 Qt5Network.dll
@@ -1,5 +1,7 @@
 #include <cmath>
+#include <QFileInfo>
 #include "manager.h"
+#include "directoryscanner.h"
 #include "mainwindow.h"
 #include "mpvwidget.h"
 #include "helpers.h"
@@ -10,6 +12,11 @@ using namespace Helpers;
 PlaybackManager::PlaybackManager(QObject *parent) :
     QObject(parent)
 {
+    auto scanner = DirectoryScanner::getSingleton();
+    connect(scanner.data(), &DirectoryScanner::filesFound,
+            this, &PlaybackManager::scanner_filesFound);
+    connect(scanner.data(), &DirectoryScanner::scanFinished,
+            this, &PlaybackManager::scanner_scanFinished);
 }
 
 void PlaybackManager::setMpvObject(MpvObject *mpvObject, bool makeConnections)
@@ -83,6 +90,21 @@ PlaybackManager::PlaybackState PlaybackManager::playbackState()
 }
 
 void PlaybackManager::openSeveralFiles(QList<QUrl> what, bool important)
+{
+    addSeveralFiles(what, important);
+}
+
+void PlaybackManager::openDirectory(QUrl where)
+{
+    // Files are added as the scanner finds them, into the playlist the first
+    // ones went to.
+    if (directoryScan)
+        DirectoryScanner::getSingleton()->cancel(directoryScan);
+    directoryScanAdded = false;
+    directoryScan = DirectoryScanner::getSingleton()->scan({ where });
+}
+
+QUuid PlaybackManager::addSeveralFiles(const QList<QUrl> &what, bool important)
 {
     if (important) {
         playlistWindow_->setCurrentPlaylist(QUuid());
@@ -96,6 +118,7 @@ void PlaybackManager::openSeveralFiles(QList<QUrl> what, bool important)
         QUrl urlToPlay = playlistWindow_->getUrlOf(info.first, info.second);
         startPlayWithUuid(urlToPlay, info.first, info.second, false);
     }
+    return info.first;
 }
 
 void PlaybackManager::openFile(QUrl what, QUrl with)
@@ -423,6 +446,8 @@ void PlaybackManager::startPlayWithUuid(QUrl what, QUuid playlistUuid,
 
     mpvStartTime = -1.0;
     nowPlaying_ = what;
+    if (what.isLocalFile())
+        DirectoryScanner::getSingleton()->prefetch(QFileInfo(what.toLocalFile()).absolutePath());
     mpvObject_->fileOpen(what.isLocalFile() ? what.toLocalFile()
                                             : what.fromPercentEncoding(what.toEncoded()));
     mpvObject_->setSubFile(with.toString());
@@ -439,6 +464,108 @@ void PlaybackManager::startPlayWithUuid(QUrl what, QUuid playlistUuid,
         playlistWindow_->setExtraPlayTimes(playlistUuid, itemUuid, playbackPlayTimes - 1);
     }
     emit nowPlayingChanged(nowPlaying_, nowPlayingList, nowPlayingItem);
+
+    // Show what is known about the file while mpv opens it.
+    nowPlayingKey = MediaInfoCache::keyOf(what);
+    nowPlayingInfo = MediaInfo();
+    if (nowPlayingKey.isEmpty()
+            || !MediaInfoCache::getSingleton()->find(nowPlayingKey, nowPlayingInfo)
+            || nowPlayingInfo.isEmpty())
+        return;
+    if (nowPlayingInfo.duration > 0) {
+        mpvLength = nowPlayingInfo.duration;
+        emit timeChanged(0, mpvLength);
+    }
+    if (nowPlayingInfo.videoSize.isValid())
+        emit videoSizeChanged(nowPlayingInfo.videoSize);
+    if (!nowPlayingInfo.chapters.isEmpty())
+        showChapters(nowPlayingInfo.chapters);
+    if (!nowPlayingInfo.tracks.isEmpty())
+        showTracks(nowPlayingInfo.tracks);
+    emit mediaInfoCached(nowPlayingInfo);
+}
+
+void PlaybackManager::showChapters(const QVariantList &chapters)
+{
+    QList<QPair<double,QString>> list;
+    for (const QVariant &v : chapters) {
+        QMap<QString, QVariant> node = v.toMap();
+        QString text = QString("[%1] - %2").arg(
+                toDateFormat(node["time"].toDouble()),
+                node["title"].toString());
+        QPair<double,QString> item(node["time"].toDouble(), text);
+        list.append(item);
+    }
+    // Only pass on what changed, as long lists are costly to rebuild.
+    Helpers::ListChange change = Helpers::listChange(chapterList, list);
+    if (change.isEmpty())
+        return;
+    chapterList = list;
+    numChapters = list.count();
+    emit chaptersAvailable(list, change);
+}
+
+void PlaybackManager::showTracks(const QVariantList &tracks)
+{
+    auto oldVideoList = videoList;
+    auto oldAudioList = audioList;
+    auto oldSubtitleList = subtitleList;
+    videoList.clear();
+    audioList.clear();
+    subtitleList.clear();
+    QPair<int64_t,QString> item;
+
+    auto str = [](QVariantMap map, QString key) {
+        return map[key].toString();
+    };
+    auto formatter = [&str](QVariantMap track) {
+        QString output;
+        output.append(QString("%1: ").arg(str(track,"id")));
+        if (track.contains("codec"))
+            output.append(QString("[%1] ").arg(str(track,"codec")));
+        if (track.contains("lang"))
+            output.append(QString("%1 ").arg(str(track,"lang")));
+        if (track.contains("title"))
+            output.append(QString("- %1 ").arg(str(track,"title")));
+        return output;
+    };
+
+    for (const QVariant &track : tracks) {
+        QVariantMap t = track.toMap();
+        item.first = t["id"].toLongLong();
+        item.second = formatter(t);
+        if (str(t,"type") == "video") {
+            videoList.append(item);
+        } else if (str(t,"type") == "audio") {
+            audioList.append(item);
+        } else if (str(t,"type") == "sub") {
+            subtitleList.append(item);
+        }
+    }
+    if (!subtitleList.isEmpty())
+        subtitleList.append({0, tr("0: None")});
+
+    // Track lists are sent again when only the selection changed, and the
+    // menus need only hear about the kinds of track that did change.
+    Helpers::ListChange change = Helpers::listChange(oldVideoList, videoList);
+    if (!change.isEmpty())
+        emit videoTracksAvailable(videoList, change);
+    change = Helpers::listChange(oldAudioList, audioList);
+    if (!change.isEmpty())
+        emit audioTracksAvailable(audioList, change);
+    change = Helpers::listChange(oldSubtitleList, subtitleList);
+    if (!change.isEmpty())
+        emit subtitleTracksAvailable(subtitleList, change);
+
+    emit hasNoVideo(videoList.empty());
+    emit hasNoAudio(audioList.empty());
+    emit hasNoSubtitles(subtitleList.empty());
+}
+
+void PlaybackManager::rememberMediaInfo()
+{
+    if (!nowPlayingKey.isEmpty())
+        MediaInfoCache::getSingleton()->insert(nowPlayingKey, nowPlayingInfo);
 }
 
 void PlaybackManager::selectDesiredTracks()
@@ -552,30 +679,14 @@ void PlaybackManager::playPrevTrack()
 
 bool PlaybackManager::playNextFileUrl(QUrl url, int delta)
 {
-    QFileInfo info;
-    QDir dir;
-    QStringList files;
-    int index;
-    QString nextFile;
-
-
-    if (url.isEmpty())
+    // The scanner keeps a sorted listing of the folder, which was most
+    // likely fetched when this file started playing.
+    if (url.isEmpty() || !url.isLocalFile())
         return false;
-    info = QFileInfo(url.toLocalFile());
-    if (!info.exists())
+    QString nextFile = DirectoryScanner::getSingleton()->fileAfter(url.toLocalFile(), delta);
+    if (nextFile.isEmpty())
         return false;
-    dir = info.dir();
-    files = dir.entryList(QDir::Files, QDir::Name);
-    index = files.indexOf(info.fileName());
-    if (index == -1)
-        return false;
-    do {
-        index += delta;
-        if (index < 0 || index >= files.count())
-            return false;
-        nextFile = dir.filePath(files.value(index));
-        url = QUrl::fromLocalFile(nextFile);
-    } while (!Helpers::urlSurvivesFilter(url));
+    url = QUrl::fromLocalFile(nextFile);
     playlistWindow_->replaceItem(nowPlayingList, nowPlayingItem, { url });
     startPlayWithUuid(url, nowPlayingList, nowPlayingItem, false);
     return true;
@@ -615,6 +726,10 @@ void PlaybackManager::mpvw_playTimeChanged(double time)
 void PlaybackManager::mpvw_playLengthChanged(double length)
 {
     mpvLength = length;
+    if (length > 0 && length != nowPlayingInfo.duration) {
+        nowPlayingInfo.duration = length;
+        rememberMediaInfo();
+    }
 }
 
 void PlaybackManager::mpvw_seekableChanged(bool yes)
@@ -680,70 +795,30 @@ void PlaybackManager::mpvw_chapterDataChanged(QVariantMap metadata)
 
 void PlaybackManager::mpvw_chaptersChanged(QVariantList chapters)
 {
-    QList<QPair<double,QString>> list;
-    for (QVariant &v : chapters) {
-        QMap<QString, QVariant> node = v.toMap();
-        QString text = QString("[%1] - %2").arg(
-                toDateFormat(node["time"].toDouble()),
-                node["title"].toString());
-        QPair<double,QString> item(node["time"].toDouble(), text);
-        list.append(item);
+    showChapters(chapters);
+    if (!chapters.isEmpty()) {
+        nowPlayingInfo.chapters = chapters;
+        rememberMediaInfo();
     }
-    numChapters = list.count();
-    emit chaptersAvailable(list);
 }
 
 void PlaybackManager::mpvw_tracksChanged(QVariantList tracks)
 {
-    videoList.clear();
-    audioList.clear();
-    subtitleList.clear();
-    QPair<int64_t,QString> item;
-
-    auto str = [](QVariantMap map, QString key) {
-        return map[key].toString();
-    };
-    auto formatter = [&str](QVariantMap track) {
-        QString output;
-        output.append(QString("%1: ").arg(str(track,"id")));
-        if (track.contains("codec"))
-            output.append(QString("[%1] ").arg(str(track,"codec")));
-        if (track.contains("lang"))
-            output.append(QString("%1 ").arg(str(track,"lang")));
-        if (track.contains("title"))
-            output.append(QString("- %1 ").arg(str(track,"title")));
-        return output;
-    };
-
-    for (QVariant &track : tracks) {
-        QVariantMap t = track.toMap();
-        item.first = t["id"].toLongLong();
-        item.second = formatter(t);
-        if (str(t,"type") == "video") {
-            videoList.append(item);
-        } else if (str(t,"type") == "audio") {
-            audioList.append(item);
-        } else if (str(t,"type") == "sub") {
-            subtitleList.append(item);
-        }
-    }
-    if (!subtitleList.isEmpty())
-        subtitleList.append({0, tr("0: None")});
-
-    emit videoTracksAvailable(videoList);
-    emit audioTracksAvailable(audioList);
-    emit subtitleTracksAvailable(subtitleList);
-
+    showTracks(tracks);
     selectDesiredTracks();
-
-    emit hasNoVideo(videoList.empty());
-    emit hasNoAudio(audioList.empty());
-    emit hasNoSubtitles(subtitleList.empty());
+    if (!tracks.isEmpty()) {
+        nowPlayingInfo.tracks = tracks;
+        rememberMediaInfo();
+    }
 }
 
 void PlaybackManager::mpvw_videoSizeChanged(QSize size)
 {
     emit videoSizeChanged(size);
+    if (size.isValid() && size != nowPlayingInfo.videoSize) {
+        nowPlayingInfo.videoSize = size;
+        rememberMediaInfo();
+    }
 }
 
 void PlaybackManager::mpvw_fpsChanged(double fps)
@@ -778,7 +853,12 @@ void PlaybackManager::mpvw_videoBitrateChanged(double bitrate)
 
 void PlaybackManager::mpvw_metadataChanged(QVariantMap metadata)
 {
-    playlistWindow_->setMetadata(nowPlayingList, nowPlayingItem, metadata);
+    nowPlayingInfo.metadata = metadata;
+    rememberMediaInfo();
+    // The item keeps the duration and stream details too, as if probed.
+    playlistWindow_->setMetadata(nowPlayingList, nowPlayingItem,
+                                 nowPlayingKey.isEmpty() ? metadata
+                                                         : nowPlayingInfo.itemMetadata());
 }
 
 void PlaybackManager::mpvw_playlistChanged(const QVariantList &playlist)
@@ -790,3 +870,20 @@ void PlaybackManager::mpvw_playlistChanged(const QVariantList &playlist)
     playlistWindow_->replaceItem(nowPlayingList, nowPlayingItem, urls);
     playItem(nowPlayingList, nowPlayingItem);
 }
+
+void PlaybackManager::scanner_filesFound(int job, QList<QUrl> files)
+{
+    if (job != directoryScan)
+        return;
+    if (!directoryScanAdded)
+        directoryScanList = addSeveralFiles(files, false);
+    else
+        playlistWindow_->addToPlaylist(directoryScanList, files);
+    directoryScanAdded = true;
+}
+
+void PlaybackManager::scanner_scanFinished(int job)
+{
+    if (job == directoryScan)
+        directoryScan = 0;
+}
@@ -12,6 +12,7 @@
 #include <QSize>
 #include <QVariant>
 #include "helpers.h"
+#include "mediainfocache.h"
 
 class MpvObject;
 class PlaylistWindow;
@@ -39,11 +40,15 @@ signals:
     void stateChanged(PlaybackState state);
     void typeChanged(PlaybackType type);
     // Transmit a map of chapter index to time,description pairs
-    void chaptersAvailable(QList<QPair<double,QString>> chapters);
+    void chaptersAvailable(QList<QPair<double,QString>> chapters,
+                           Helpers::ListChange change);
     // These signals transmit a list of (id, description) pairs
-    void audioTracksAvailable(QList<QPair<int64_t,QString>> tracks);
-    void videoTracksAvailable(QList<QPair<int64_t,QString>> tracks);
-    void subtitleTracksAvailable(QList<QPair<int64_t,QString>> tracks);
+    void audioTracksAvailable(QList<QPair<int64_t,QString>> tracks,
+                              Helpers::ListChange change);
+    void videoTracksAvailable(QList<QPair<int64_t,QString>> tracks,
+                              Helpers::ListChange change);
+    void subtitleTracksAvailable(QList<QPair<int64_t,QString>> tracks,
+                                 Helpers::ListChange change);
     void hasNoVideo(bool empty);
     void hasNoAudio(bool empty);
     void hasNoSubtitles(bool empty);
@@ -58,6 +63,8 @@ signals:
     void systemShouldStandby();
     void systemShouldHibernate();
     void currentTrackInfo(TrackInfo track);
+    // What the cache knows of a file that is being opened.
+    void mediaInfoCached(MediaInfo info);
 
     void fpsChanged(double fps);
     void avsyncChanged(double sync);
@@ -69,6 +76,7 @@ signals:
 public slots:
     // load functions
     void openSeveralFiles(QList<QUrl> what, bool important = false);
+    void openDirectory(QUrl where);
     void openFile(QUrl what, QUrl with = QUrl());
 
     void playDiscFiles(QUrl where);             // from dvd/bd open
@@ -125,8 +133,12 @@ public slots:
     void sendCurrentTrackInfo();
 
 private:
+    QUuid addSeveralFiles(const QList<QUrl> &what, bool important);
     void startPlayWithUuid(QUrl what, QUuid playlistUuid, QUuid itemUuid,
                            bool isRepeating, QUrl with = QUrl());
+    void showChapters(const QVariantList &chapters);
+    void showTracks(const QVariantList &tracks);
+    void rememberMediaInfo();
     void selectDesiredTracks();
     void updateSubtitleTrack();
     void checkAfterPlayback(bool playlistMode);
@@ -158,6 +170,8 @@ private slots:
     void mpvw_playlistChanged(const QVariantList &playlist);
     void mpvw_audioBitrateChanged(double bitrate);
     void mpvw_videoBitrateChanged(double bitrate);
+    void scanner_filesFound(int job, QList<QUrl> files);
+    void scanner_scanFinished(int job);
 
 private:
     MpvObject *mpvObject_ = nullptr;
@@ -166,6 +180,14 @@ private:
     QUuid nowPlayingList;
     QUuid nowPlayingItem;
     QString nowPlayingTitle;
+    // The file's key in the MediaInfoCache, and what is known about it.
+    QString nowPlayingKey;
+    MediaInfo nowPlayingInfo;
+    // The directory being added by openDirectory, and the playlist it goes
+    // to once its first files have arrived.
+    int directoryScan = 0;
+    bool directoryScanAdded = false;
+    QUuid directoryScanList;
 
     double mpvStartTime = -1.0;
     double mpvTime = 0.0;
@@ -185,6 +207,7 @@ private:
     QString subtitleListSelected;
     int64_t subtitleTrackSelected = 1;
     bool subtitleEnabled = true;
+    QList<QPair<double,QString>> chapterList;
     int numChapters = 0;
 
     int playbackPlayTimes = 1;
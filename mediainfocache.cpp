@@ -0,0 +1,193 @@
+#include <QDataStream>
+#include <QDateTime>
+#include <QUrl>
+#include <QVector>
+#include <algorithm>
+#include <cstring>
+#include "mediainfocache.h"
+
+// Roughly how much the cache may take up, in bytes as saved.
+constexpr qint64 maxCacheCost = 32 * 1024 * 1024;
+// Evicting goes down to this, so that it isn't done on every insert.
+constexpr qint64 evictedCacheCost = maxCacheCost / 4 * 3;
+// Cache file magic and version.
+static const char cacheMagic[] = "MPQM";
+constexpr quint32 cacheVersion = 1;
+
+static QDataStream &operator<<(QDataStream &out, const MediaInfo &info)
+{
+    return out << info.duration << info.tracks << info.chapters
+               << info.metadata << info.videoSize;
+}
+
+static QDataStream &operator>>(QDataStream &in, MediaInfo &info)
+{
+    return in >> info.duration >> info.tracks >> info.chapters
+              >> info.metadata >> info.videoSize;
+}
+
+bool MediaInfo::isEmpty() const
+{
+    return duration <= 0 && tracks.isEmpty() && chapters.isEmpty()
+            && metadata.isEmpty() && !videoSize.isValid();
+}
+
+QVariantMap MediaInfo::itemMetadata() const
+{
+    QVariantMap m = metadata;
+    if (duration > 0)
+        m.insert("duration", duration);
+    for (const QVariant &v : tracks) {
+        QVariantMap track = v.toMap();
+        QString type = track.value("type").toString();
+        if (type == "video" && !track.value("albumart").toBool()
+                && !m.contains("video-codec")) {
+            m.insert("video-codec", track.value("codec"));
+            if (track.contains("demux-w")) {
+                m.insert("width", track.value("demux-w"));
+                m.insert("height", track.value("demux-h"));
+            }
+        } else if (type == "audio" && !m.contains("audio-codec")) {
+            m.insert("audio-codec", track.value("codec"));
+        }
+    }
+    if (!m.contains("width") && videoSize.isValid()) {
+        m.insert("width", videoSize.width());
+        m.insert("height", videoSize.height());
+    }
+    return m;
+}
+
+
+
+QSharedPointer<MediaInfoCache> MediaInfoCache::cache;
+
+MediaInfoCache::MediaInfoCache()
+{
+
+}
+
+QSharedPointer<MediaInfoCache> MediaInfoCache::getSingleton()
+{
+    if (cache.isNull())
+        cache.reset(new MediaInfoCache());
+    return cache;
+}
+
+QString MediaInfoCache::keyOf(const QFileInfo &info)
+{
+    if (!info.isFile())
+        return QString();
+    return QString("%1|%2|%3").arg(info.absoluteFilePath()).arg(info.size())
+            .arg(info.lastModified().toMSecsSinceEpoch());
+}
+
+QString MediaInfoCache::keyOf(const QUrl &url)
+{
+    if (!url.isLocalFile())
+        return QString();
+    return keyOf(QFileInfo(url.toLocalFile()));
+}
+
+bool MediaInfoCache::find(const QString &key, MediaInfo &info)
+{
+    QMutexLocker locker(&lock);
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return false;
+    it->lastUsed = ++tick;
+    info = it->info;
+    return true;
+}
+
+void MediaInfoCache::insert(const QString &key, const MediaInfo &info)
+{
+    if (key.isEmpty())
+        return;
+    qint64 cost = costOf(key, info);
+    QMutexLocker locker(&lock);
+    Entry &entry = entries[key];
+    totalCost += cost - entry.cost;
+    entry.info = info;
+    entry.lastUsed = ++tick;
+    entry.cost = cost;
+    evict();
+}
+
+QByteArray MediaInfoCache::toData()
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out.writeRawData(cacheMagic, 4);
+    QMutexLocker locker(&lock);
+    out << cacheVersion << quint32(entries.count());
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it)
+        out << it.key() << it->lastUsed << it->cost << it->info;
+    return data;
+}
+
+void MediaInfoCache::fromData(const QByteArray &data)
+{
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_0);
+    char magic[4];
+    quint32 version, count;
+    if (in.readRawData(magic, 4) != 4 || memcmp(magic, cacheMagic, 4))
+        return;
+    in >> version >> count;
+    if (in.status() != QDataStream::Ok || version != cacheVersion)
+        return;
+
+    QHash<QString, Entry> loaded;
+    quint64 lastTick = 0;
+    for (quint32 i = 0; i < count; i++) {
+        QString key;
+        Entry entry;
+        in >> key >> entry.lastUsed >> entry.cost >> entry.info;
+        if (in.status() != QDataStream::Ok)
+            return;
+        lastTick = std::max(lastTick, entry.lastUsed);
+        loaded.insert(key, entry);
+    }
+
+    // Anything added in the meantime is newer than what was on disk, and
+    // its ticks go after the loaded ones.
+    QMutexLocker locker(&lock);
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        it->lastUsed += lastTick;
+        loaded.insert(it.key(), *it);
+    }
+    entries.swap(loaded);
+    tick += lastTick;
+    totalCost = 0;
+    for (const Entry &entry : entries)
+        totalCost += entry.cost;
+    evict();
+}
+
+qint64 MediaInfoCache::costOf(const QString &key, const MediaInfo &info)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << key << info;
+    // Plus the tick and the cost themselves.
+    return data.size() + 16;
+}
+
+void MediaInfoCache::evict()
+{
+    if (totalCost <= maxCacheCost)
+        return;
+    QVector<QPair<quint64, QString>> byAge;
+    byAge.reserve(entries.count());
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it)
+        byAge.append({ it->lastUsed, it.key() });
+    std::sort(byAge.begin(), byAge.end());
+    for (const auto &aged : byAge) {
+        if (totalCost <= evictedCacheCost)
+            break;
+        totalCost -= entries.take(aged.second).cost;
+    }
+}
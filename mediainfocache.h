@@ -0,0 +1,69 @@
+#ifndef MEDIAINFOCACHE_H
+#define MEDIAINFOCACHE_H
+// What is known about media files, by file identity: path, size and
+// modification time.  Filled in by the prober and by playback, and read back
+// so that lengths, tracks, chapters and tags can be shown before mpv has
+// opened a file again.  Kept on disk as a single file in the config path.
+//
+// Entries carry the tick they were last used at.  Once the estimated size
+// of the whole goes over a cap, the least recently used ones are dropped.
+
+#include <QFileInfo>
+#include <QHash>
+#include <QMetaType>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QSize>
+#include <QVariantList>
+#include <QVariantMap>
+
+struct MediaInfo {
+    double duration = 0;
+    QVariantList tracks;
+    QVariantList chapters;
+    QVariantMap metadata;
+    QSize videoSize;
+
+    bool isEmpty() const;
+    // The metadata, plus duration and stream details, in the form playlist
+    // items keep them.
+    QVariantMap itemMetadata() const;
+};
+
+Q_DECLARE_METATYPE(MediaInfo)
+
+class MediaInfoCache {
+private:
+    MediaInfoCache();
+    static QSharedPointer<MediaInfoCache> cache;
+
+public:
+    static QSharedPointer<MediaInfoCache> getSingleton();
+
+    // The key of a file, or nothing if it isn't one.
+    static QString keyOf(const QFileInfo &info);
+    static QString keyOf(const QUrl &url);
+
+    bool find(const QString &key, MediaInfo &info);
+    void insert(const QString &key, const MediaInfo &info);
+
+    QByteArray toData();
+    void fromData(const QByteArray &data);
+
+private:
+    struct Entry {
+        MediaInfo info;
+        quint64 lastUsed = 0;
+        qint64 cost = 0;
+    };
+
+    static qint64 costOf(const QString &key, const MediaInfo &info);
+    void evict();
+
+    QMutex lock;
+    QHash<QString, Entry> entries;
+    quint64 tick = 0;
+    qint64 totalCost = 0;
+};
+
+#endif // MEDIAINFOCACHE_H
@@ -0,0 +1,315 @@
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <mpv/client.h>
+#include <mpv/qthelper.hpp>
+#include "mediaprober.h"
+#include "playlist.h"
+
+// Opening files is mostly waiting on the disk, which playback needs more.
+constexpr int maxProbers = 2;
+// Give up on a file that takes longer than this to open.
+constexpr int probeTimeout = 10000;
+// A sweep looks at this many items of its playlist at a time.
+constexpr int sweepBatchSize = 64;
+
+QSharedPointer<MediaProber> MediaProber::prober;
+
+MediaProber::MediaProber() : QObject()
+{
+    pool.setMaxThreadCount(maxProbers);
+}
+
+MediaProber::~MediaProber()
+{
+    stop();
+}
+
+QSharedPointer<MediaProber> MediaProber::getSingleton()
+{
+    if (prober.isNull())
+        prober.reset(new MediaProber());
+    return prober;
+}
+
+void MediaProber::probe(const QList<QSharedPointer<Item>> &items, Priority priority)
+{
+    QList<Request> requests;
+    Request r;
+    for (const QSharedPointer<Item> &item : items)
+        if (requestFor(item, r))
+            requests.append(r);
+    if (requests.isEmpty())
+        return;
+
+    QMutexLocker locker(&lock);
+    if (stopping)
+        return;
+    QList<Request> fresh;
+    for (const Request &r : requests) {
+        auto it = queued.constFind(r.item);
+        if (it != queued.constEnd() && (*it == Visible || priority == Background))
+            continue;
+        queued.insert(r.item, priority);
+        fresh.append(r);
+    }
+    if (priority == Visible)
+        visible = fresh + visible;
+    else
+        background.append(fresh);
+    while (servers < maxProbers && servers < queued.count()) {
+        servers++;
+        QtConcurrent::run(&pool, this, &MediaProber::serve);
+    }
+}
+
+void MediaProber::sweep(const QSharedPointer<Playlist> &playlist)
+{
+    // The snapshot shares the item list, so taking it costs nothing here.
+    QSharedPointer<Playlist> snapshot = playlist->snapshot();
+    QMutexLocker locker(&lock);
+    if (stopping)
+        return;
+    swept = snapshot;
+    sweepPosition = 0;
+    while (servers < maxProbers) {
+        servers++;
+        QtConcurrent::run(&pool, this, &MediaProber::serve);
+    }
+}
+
+void MediaProber::forget(const QUuid &playlist)
+{
+    QMutexLocker locker(&lock);
+    if (swept && swept->uuid() == playlist)
+        swept.reset();
+    found.remove(playlist);
+    auto ofPlaylist = [this, &playlist](const Request &r) {
+        if (r.playlist != playlist)
+            return false;
+        queued.remove(r.item);
+        return true;
+    };
+    visible.erase(std::remove_if(visible.begin(), visible.end(), ofPlaylist),
+                  visible.end());
+    background.erase(std::remove_if(background.begin(), background.end(), ofPlaylist),
+                     background.end());
+}
+
+void MediaProber::stop()
+{
+    {
+        QMutexLocker locker(&lock);
+        stopping = true;
+        visible.clear();
+        background.clear();
+        queued.clear();
+        swept.reset();
+        found.clear();
+    }
+    pool.waitForDone();
+}
+
+bool MediaProber::requestFor(const QSharedPointer<Item> &item, Request &r)
+{
+    if (item->metadata().contains("duration"))
+        return false;
+    QUrl url = item->url();
+    if (!url.isLocalFile())
+        return false;
+    r = { item->playlistUuid(), item->uuid(), url.toLocalFile() };
+    return true;
+}
+
+void MediaProber::sweepNext_()
+{
+    // The caller holds the lock.  Only one batch is queued at a time, so
+    // the queue stays small however big the playlist is.
+    Request r;
+    while (swept && background.isEmpty()) {
+        int end = std::min(sweepPosition + sweepBatchSize, swept->count());
+        for (; sweepPosition < end; sweepPosition++) {
+            QSharedPointer<Item> item = swept->itemAt(sweepPosition);
+            if (!item || queued.contains(item->uuid()) || !requestFor(item, r))
+                continue;
+            queued.insert(r.item, Background);
+            background.append(r);
+        }
+        if (sweepPosition >= swept->count())
+            swept.reset();
+    }
+}
+
+bool MediaProber::take(Request &r)
+{
+    QMutexLocker locker(&lock);
+    while (!stopping) {
+        if (visible.isEmpty() && background.isEmpty())
+            sweepNext_();
+        bool fromVisible = !visible.isEmpty();
+        if (!fromVisible && background.isEmpty())
+            break;
+        r = fromVisible ? visible.takeFirst() : background.takeFirst();
+        auto it = queued.find(r.item);
+        if (it == queued.end() || *it != (fromVisible ? Visible : Background))
+            continue;
+        queued.erase(it);
+        r.priority = fromVisible ? Visible : Background;
+        return true;
+    }
+    servers--;
+    return false;
+}
+
+void MediaProber::serve()
+{
+    QThread::currentThread()->setPriority(QThread::LowPriority);
+    mpv_handle *mpv = nullptr;
+    Request r;
+    while (take(r)) {
+        QString key = MediaInfoCache::keyOf(QFileInfo(r.path));
+        if (key.isEmpty())
+            continue;
+        // Files that couldn't be probed are cached with nothing, so that
+        // they aren't tried again.
+        MediaInfo info;
+        if (!MediaInfoCache::getSingleton()->find(key, info)) {
+            if (!mpv)
+                mpv = createHandle();
+            if (!mpv)
+                continue;
+            bool usable = true;
+            info = probeFile(mpv, r.path, usable);
+            if (usable) {
+                MediaInfoCache::getSingleton()->insert(key, info);
+            } else {
+                // It's stuck or gone, so start over with a new one.
+                mpv_terminate_destroy(mpv);
+                mpv = nullptr;
+            }
+        }
+        if (!info.isEmpty())
+            report(r, info.itemMetadata());
+    }
+    // Whatever the last batch left behind.
+    flush();
+    if (mpv)
+        mpv_terminate_destroy(mpv);
+}
+
+void MediaProber::report(const Request &r, const QVariantMap &metadata)
+{
+    {
+        QMutexLocker locker(&lock);
+        found[r.playlist].insert(r.item, metadata);
+        if (r.priority == Background && !background.isEmpty())
+            return;
+    }
+    flush();
+}
+
+void MediaProber::flush()
+{
+    QHash<QUuid, Results> ready;
+    {
+        QMutexLocker locker(&lock);
+        ready.swap(found);
+    }
+    for (auto it = ready.constBegin(); it != ready.constEnd(); ++it)
+        emit probed(it.key(), it.value());
+}
+
+mpv_handle *MediaProber::createHandle()
+{
+    mpv_handle *mpv = mpv_create();
+    if (!mpv)
+        return nullptr;
+    static const char *options[][2] = {
+        { "config", "no" }, { "load-scripts", "no" }, { "ytdl", "no" },
+        { "terminal", "no" }, { "msg-level", "all=no" },
+        { "vo", "null" }, { "ao", "null" }, { "audio-display", "no" },
+        { "idle", "yes" }, { "pause", "yes" }
+    };
+    for (auto &option : options)
+        mpv_set_option_string(mpv, option[0], option[1]);
+    if (mpv_initialize(mpv) < 0) {
+        mpv_terminate_destroy(mpv);
+        return nullptr;
+    }
+    // Everything wanted is known once the demuxer has opened the file and
+    // before any decoder is set up.
+    mpv_hook_add(mpv, 0, "on_preloaded", 0);
+    return mpv;
+}
+
+MediaInfo MediaProber::probeFile(mpv_handle *mpv, const QString &path, bool &usable)
+{
+    MediaInfo info;
+    QByteArray file = path.toUtf8();
+    const char *load[] = { "loadfile", file.constData(), nullptr };
+    if (mpv_command(mpv, load) < 0)
+        return info;
+
+    QElapsedTimer timer;
+    timer.start();
+    while (true) {
+        qint64 remaining = probeTimeout - timer.elapsed();
+        if (remaining <= 0) {
+            usable = false;
+            return info;
+        }
+        mpv_event *event = mpv_wait_event(mpv, remaining / 1000.0);
+        switch (event->event_id) {
+        case MPV_EVENT_HOOK: {
+            auto hook = static_cast<mpv_event_hook *>(event->data);
+            info = readProperties(mpv);
+            mpv_hook_continue(mpv, hook->id);
+            const char *stop[] = { "stop", nullptr };
+            mpv_command(mpv, stop);
+            break;
+        }
+        case MPV_EVENT_END_FILE:
+            return info;
+        case MPV_EVENT_SHUTDOWN:
+            usable = false;
+            return info;
+        default:
+            break;
+        }
+    }
+}
+
+MediaInfo MediaProber::readProperties(mpv_handle *mpv)
+{
+    // Tags get the same treatment as MpvObject gives them while playing.
+    MediaInfo info;
+    QVariantMap tags = nodeProperty(mpv, "metadata").toMap();
+    for (auto it = tags.constBegin(); it != tags.constEnd(); ++it)
+        info.metadata.insert(it.key().toLower(), it.value());
+
+    double duration = 0;
+    if (mpv_get_property(mpv, "duration", MPV_FORMAT_DOUBLE, &duration) >= 0)
+        info.duration = duration;
+    info.tracks = nodeProperty(mpv, "track-list").toList();
+    info.chapters = nodeProperty(mpv, "chapter-list").toList();
+    for (const QVariant &v : info.tracks) {
+        QVariantMap track = v.toMap();
+        if (track.value("type") == "video" && !track.value("albumart").toBool()) {
+            info.videoSize = QSize(track.value("demux-w").toInt(),
+                                   track.value("demux-h").toInt());
+            break;
+        }
+    }
+    return info;
+}
+
+QVariant MediaProber::nodeProperty(mpv_handle *mpv, const char *name)
+{
+    mpv_node node;
+    if (mpv_get_property(mpv, name, MPV_FORMAT_NODE, &node) < 0)
+        return QVariant();
+    mpv::qt::node_autofree f(&node);
+    return mpv::qt::node_to_variant(&node);
+}
@@ -0,0 +1,89 @@
+#ifndef MEDIAPROBER_H
+#define MEDIAPROBER_H
+// Fills in item metadata without playing anything.  A few headless libmpv
+// instances (no audio or video output, no config, no scripts) open files up
+// to the point where the demuxer knows their tags, duration and streams,
+// and then move on.  What they find goes to the MediaInfoCache, which is
+// looked in first.
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QUuid>
+#include <QVariantMap>
+#include "mediainfocache.h"
+
+struct mpv_handle;
+class Item;
+class Playlist;
+class MediaProber : public QObject {
+    Q_OBJECT
+private:
+    MediaProber();
+    static QSharedPointer<MediaProber> prober;
+
+public:
+    enum Priority { Background, Visible };
+    // Metadata found, by item.
+    typedef QHash<QUuid, QVariantMap> Results;
+
+    ~MediaProber();
+    static QSharedPointer<MediaProber> getSingleton();
+
+    // Queues those of items that are local files and have not been probed.
+    // Visible ones go ahead of anything queued in the background, newest
+    // first, and items already queued are moved up to them.
+    void probe(const QList<QSharedPointer<Item>> &items, Priority priority);
+    // Works through the whole of playlist once nothing else is queued, a
+    // batch at a time, in place of whatever playlist it was sweeping.
+    void sweep(const QSharedPointer<Playlist> &playlist);
+    // Drops whatever is still queued for playlist.
+    void forget(const QUuid &playlist);
+    // Drops the queues and waits for the files being probed.
+    void stop();
+
+signals:
+    // Visible items are reported as soon as they are done.  Background ones
+    // are held until the batch they were queued in is, so that a sweep
+    // updates its playlist a batch at a time.
+    void probed(QUuid playlist, MediaProber::Results metadata);
+
+private:
+    struct Request {
+        QUuid playlist;
+        QUuid item;
+        QString path;
+        Priority priority;
+    };
+
+    static bool requestFor(const QSharedPointer<Item> &item, Request &r);
+    void sweepNext_();
+    bool take(Request &r);
+    void report(const Request &r, const QVariantMap &metadata);
+    void flush();
+    void serve();
+    static mpv_handle *createHandle();
+    static MediaInfo probeFile(mpv_handle *mpv, const QString &path, bool &usable);
+    static MediaInfo readProperties(mpv_handle *mpv);
+    static QVariant nodeProperty(mpv_handle *mpv, const char *name);
+
+    QMutex lock;
+    QList<Request> visible;
+    QList<Request> background;
+    // Which queue each queued item is wanted from.  Requests are left in the
+    // other queue when moved, and skipped when they come up.
+    QHash<QUuid, Priority> queued;
+    // A snapshot of the playlist being swept, and how far into it we are.
+    QSharedPointer<Playlist> swept;
+    int sweepPosition = 0;
+    // What was found but not yet reported, by playlist.
+    QHash<QUuid, Results> found;
+    int servers = 0;
+    bool stopping = false;
+    // Declared last, so that it is torn down (and waited on) first.
+    QThreadPool pool;
+};
+
+#endif // MEDIAPROBER_H
@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui network widgets
+QT       += core gui network widgets concurrent
 
 QMAKE_CXXFLAGS += -Wall
 
@@ -148,6 +148,12 @@ SOURCES += main.cpp\
     mpvwidget.cpp \
     mainwindow.cpp \
     playlist.cpp \
+    orderindex.cpp \
+    playlistindex.cpp \
+    playlistjournal.cpp \
+    playlistreader.cpp \
+    playlistsaver.cpp \
+    playliststore.cpp \
     manager.cpp \
     helpers.cpp \
     playlistwindow.cpp \
@@ -161,6 +167,12 @@ SOURCES += main.cpp\
     favoriteswindow.cpp \
     actioneditor.cpp \
     drawnplaylist.cpp \
+    directoryscanner.cpp \
+    livefolders.cpp \
+    mediainfocache.cpp \
+    mediaprober.cpp \
+    thumbnailjobs.cpp \
+    seekpreviewer.cpp \
     drawnslider.cpp \
     drawnstatus.cpp \
     platform/screensaver.cpp \
@@ -173,6 +185,12 @@ HEADERS  += \
     mpvwidget.h \
     mainwindow.h \
     playlist.h \
+    orderindex.h \
+    playlistindex.h \
+    playlistjournal.h \
+    playlistreader.h \
+    playlistsaver.h \
+    playliststore.h \
     manager.h \
     main.h \
     helpers.h \
@@ -187,6 +205,12 @@ HEADERS  += \
     favoriteswindow.h \
     actioneditor.h \
     drawnplaylist.h \
+    directoryscanner.h \
+    livefolders.h \
+    mediainfocache.h \
+    mediaprober.h \
+    thumbnailjobs.h \
+    seekpreviewer.h \
     drawnslider.h \
     drawnstatus.h \
     platform/screensaver.h \
@@ -12,7 +12,10 @@
 #include <QThread>
 #include <QTimer>
 #include <QOpenGLContext>
+#include <QScreen>
+#include <QWindow>
 #include <QMouseEvent>
+#include <QContextMenuEvent>
 #include <QMetaObject>
 #include <QDir>
 #include <QDebug>
@@ -35,9 +38,21 @@
 #define GLAPIENTRY
 #endif
 
-#define HANDLE_PROP(p, method, converter, dflt) \
+// Playback position, about twelve times a second.
+constexpr int timeThrottle = 1000/12;
+// Playback statistics, for the status bar and the stats page.
+constexpr int statsThrottle = 250;
+// mpv only works bitrates out about once a second anyway.
+constexpr int bitrateThrottle = 500;
+// Throttled properties are sampled this often, and their intervals are
+// rounded to it.
+constexpr int sampleResolution = 1000/24;
+// How often frame timings are written to the log, when debugging.
+constexpr int timingLogInterval = 1000;
+
+#define HANDLE_PROP(p, format, throttle, method, converter, dflt) \
 { \
-    p, \
+    p, format, throttle, \
     [](MpvObject *self, bool ok, const QVariant &v) -> void { \
         if (ok && v.canConvert<decltype(dflt)>()) \
             emit self->method(v.converter());  \
@@ -46,28 +61,49 @@
     } \
 }
 
-MpvObject::PropertyDispatchMap MpvObject::propertyDispatch = {
-    HANDLE_PROP("time-pos", self_playTimeChanged, toDouble, -1.0),
-    HANDLE_PROP("duration", self_playLengthChanged, toDouble, -1.0),
-    HANDLE_PROP("seekable", seekableChanged, toBool, false),
-    HANDLE_PROP("pause", pausedChanged, toBool, true),
-    HANDLE_PROP("media-title", mediaTitleChanged, toString, QString()),
-    HANDLE_PROP("chapter-metadata", chapterDataChanged, toMap, QVariantMap()),
-    HANDLE_PROP("chapter-list", chaptersChanged, toList, QVariantList()),
-    HANDLE_PROP("track-list", tracksChanged, toList, QVariantList()),
-    HANDLE_PROP("estimated-vf-fps", fpsChanged, toDouble, 0.0),
-    HANDLE_PROP("avsync", avsyncChanged, toDouble, 0.0),
-    HANDLE_PROP("frame-drop-count", displayFramedropsChanged, toLongLong, 0ll),
-    HANDLE_PROP("decoder-frame-drop-count", decoderFramedropsChanged, toLongLong, 0ll),
-    HANDLE_PROP("audio-bitrate", audioBitrateChanged, toDouble, 0.0),
-    HANDLE_PROP("video-bitrate", videoBitrateChanged, toDouble, 0.0),
-    HANDLE_PROP("metadata", self_metadata, toMap, QVariantMap()),
-    HANDLE_PROP("audio-device-list", self_audioDeviceList, toList, QVariantList()),
-    HANDLE_PROP("filename", fileNameChanged, toString, QString()),
-    HANDLE_PROP("file-format", fileFormatChanged, toString, QString()),
-    HANDLE_PROP("file-date-created", fileCreationTimeChanged, toLongLong, 0ll),
-    HANDLE_PROP("file-size", fileSizeChanged, toLongLong, 0ll),
-    HANDLE_PROP("path", filePathChanged, toString, QString())
+MpvObject::PropertyDispatchTable MpvObject::propertyDispatch = {
+    HANDLE_PROP("time-pos", MPV_FORMAT_DOUBLE, timeThrottle,
+                self_playTimeChanged, toDouble, -1.0),
+    HANDLE_PROP("pause", MPV_FORMAT_FLAG, 0,
+                pausedChanged, toBool, true),
+    HANDLE_PROP("media-title", MPV_FORMAT_STRING, 0,
+                mediaTitleChanged, toString, QString()),
+    HANDLE_PROP("chapter-metadata", MPV_FORMAT_NODE, 0,
+                chapterDataChanged, toMap, QVariantMap()),
+    HANDLE_PROP("track-list", MPV_FORMAT_NODE, 0,
+                self_tracks, toList, QVariantList()),
+    HANDLE_PROP("chapter-list", MPV_FORMAT_NODE, 0,
+                self_chapters, toList, QVariantList()),
+    HANDLE_PROP("duration", MPV_FORMAT_DOUBLE, 0,
+                self_playLengthChanged, toDouble, -1.0),
+    HANDLE_PROP("estimated-vf-fps", MPV_FORMAT_DOUBLE, statsThrottle,
+                fpsChanged, toDouble, 0.0),
+    HANDLE_PROP("avsync", MPV_FORMAT_DOUBLE, statsThrottle,
+                avsyncChanged, toDouble, 0.0),
+    HANDLE_PROP("frame-drop-count", MPV_FORMAT_INT64, statsThrottle,
+                displayFramedropsChanged, toLongLong, 0ll),
+    HANDLE_PROP("decoder-frame-drop-count", MPV_FORMAT_INT64, statsThrottle,
+                decoderFramedropsChanged, toLongLong, 0ll),
+    HANDLE_PROP("audio-bitrate", MPV_FORMAT_DOUBLE, bitrateThrottle,
+                audioBitrateChanged, toDouble, 0.0),
+    HANDLE_PROP("video-bitrate", MPV_FORMAT_DOUBLE, bitrateThrottle,
+                videoBitrateChanged, toDouble, 0.0),
+    HANDLE_PROP("metadata", MPV_FORMAT_NODE, 0,
+                self_metadata, toMap, QVariantMap()),
+    HANDLE_PROP("audio-device-list", MPV_FORMAT_NODE, 0,
+                self_audioDeviceList, toList, QVariantList()),
+    HANDLE_PROP("filename", MPV_FORMAT_STRING, 0,
+                fileNameChanged, toString, QString()),
+    HANDLE_PROP("file-format", MPV_FORMAT_STRING, 0,
+                fileFormatChanged, toString, QString()),
+    HANDLE_PROP("file-size", MPV_FORMAT_STRING, 0,
+                fileSizeChanged, toLongLong, 0ll),
+    HANDLE_PROP("file-date-created", MPV_FORMAT_NODE, 0,
+                fileCreationTimeChanged, toLongLong, 0ll),
+    HANDLE_PROP("path", MPV_FORMAT_STRING, 0,
+                filePathChanged, toString, QString()),
+    HANDLE_PROP("seekable", MPV_FORMAT_FLAG, 0,
+                seekableChanged, toBool, false)
 };
 
 MpvObject::MpvObject(QObject *owner, const QString &clientName) : QObject(owner)
@@ -84,6 +120,8 @@ MpvObject::MpvObject(QObject *owner, const QString &clientName) : QObject(owner)
     hideTimer = new QTimer(this);
     hideTimer->setSingleShot(true);
     hideTimer->setInterval(1000);
+    sampleTimer = new QTimer(this);
+    sampleTimer->setInterval(sampleResolution);
 
     // Wire the basic mpv functions to avoid littering the codebase with
     // QMetaObject::invokeMethod.
@@ -101,20 +139,24 @@ MpvObject::MpvObject(QObject *owner, const QString &clientName) : QObject(owner)
             ctrl, &MpvController::showStatsPage, Qt::QueuedConnection);
 
     // Wire up the event-handling callbacks
-    connect(ctrl, &MpvController::mpvPropertyChanged,
-            this, &MpvObject::ctrl_mpvPropertyChanged, Qt::QueuedConnection);
+    connect(ctrl, &MpvController::propertyChanged,
+            this, &MpvObject::ctrl_propertyChanged, Qt::QueuedConnection);
     connect(ctrl, &MpvController::hookEvent,
             this, &MpvObject::ctrl_hookEvent, Qt::QueuedConnection);
     connect(ctrl, &MpvController::unhandledMpvEvent,
             this, &MpvObject::ctrl_unhandledMpvEvent, Qt::QueuedConnection);
     connect(ctrl, &MpvController::videoSizeChanged,
             this, &MpvObject::ctrl_videoSizeChanged, Qt::QueuedConnection);
+    connect(ctrl, &MpvController::typedPropertiesWaiting,
+            this, &MpvObject::ctrl_typedPropertiesWaiting, Qt::QueuedConnection);
 
     // Wire up the mouse and timer-related callbacks
     connect(this, &MpvObject::mouseMoved,
             this, &MpvObject::self_mouseMoved);
     connect(hideTimer, &QTimer::timeout,
             this, &MpvObject::hideTimer_timeout);
+    connect(sampleTimer, &QTimer::timeout,
+            this, &MpvObject::sampleTimer_timeout);
 
     // Wire up the logging interface
     connect(ctrl, &MpvController::logMessageByParts,
@@ -141,39 +183,21 @@ MpvObject::MpvObject(QObject *owner, const QString &clientName) : QObject(owner)
     // clean up objects when the worker thread is deleted
     connect(worker, &QThread::finished, ctrl, &MpvController::deleteLater);
 
-    // Observe some properties
-    MpvController::PropertyList options = {
-        { "time-pos", 0, MPV_FORMAT_DOUBLE },
-        { "pause", 0, MPV_FORMAT_FLAG },
-        { "media-title", 0, MPV_FORMAT_STRING },
-        { "chapter-metadata", 0, MPV_FORMAT_NODE },
-        { "track-list", 0, MPV_FORMAT_NODE },
-        { "chapter-list", 0, MPV_FORMAT_NODE },
-        { "duration", 0, MPV_FORMAT_DOUBLE },
-        { "estimated-vf-fps", 0, MPV_FORMAT_DOUBLE },
-        { "avsync", 0, MPV_FORMAT_DOUBLE },
-        { "frame-drop-count", 0, MPV_FORMAT_INT64 },
-        { "decoder-frame-drop-count", 0, MPV_FORMAT_INT64 },
-        { "audio-bitrate", 0, MPV_FORMAT_DOUBLE },
-        { "video-bitrate", 0, MPV_FORMAT_DOUBLE },
-        { "paused-for-cache", 0, MPV_FORMAT_FLAG },
-        { "metadata", 0, MPV_FORMAT_NODE },
-        { "audio-device-list", 0, MPV_FORMAT_NODE },
-        { "filename", 0, MPV_FORMAT_STRING },
-        { "file-format", 0, MPV_FORMAT_STRING },
-        { "file-size", 0, MPV_FORMAT_STRING },
-        { "file-date-created", 0, MPV_FORMAT_NODE },
-        { "path", 0, MPV_FORMAT_STRING },
-        { "seekable", 0, MPV_FORMAT_FLAG }
-    };
-    QSet<QString> throttled = {
-        "time-pos", "avsync", "estimated-vf-fps", "frame-drop-count",
-        "decoder-frame-drop-count", "audio-bitrate", "video-bitrate"
-    };
+    // Observe the properties we dispatch, by their index.  The throttled
+    // ones are sampled from the controller instead of being signalled.
+    MpvController::PropertyList options;
+    for (int i = 0; i < propertyDispatch.count(); i++) {
+        const PropertyDispatch &p = propertyDispatch.at(i);
+        bool sampled = p.throttleMsec > 0;
+        options.append({ p.name, MpvController::internalPropertyId(i),
+                         p.format, sampled });
+        if (sampled)
+            sampledProperties.append({ i, std::max(1, (p.throttleMsec + sampleResolution/2)
+                                                      / sampleResolution) });
+    }
     QMetaObject::invokeMethod(ctrl, "observeProperties",
                               Qt::QueuedConnection,
-                              Q_ARG(const MpvController::PropertyList &, options),
-                              Q_ARG(const QSet<QString> &, throttled));
+                              Q_ARG(const MpvController::PropertyList &, options));
 
     QMetaObject::invokeMethod(ctrl, "addHook",
                               Qt::QueuedConnection,
@@ -592,18 +616,21 @@ void MpvObject::hideCursor()
     widget->self()->setCursor(Qt::BlankCursor);
 }
 
-void MpvObject::ctrl_mpvPropertyChanged(QString name, QVariant v)
+void MpvObject::ctrl_propertyChanged(int index, QVariant v)
 {
+    if (index < 0 || index >= propertyDispatch.count()) {
+        LogStream("mpvobject") << "property " << index << " changed, but was not in dispatch list.";
+        return;
+    }
+    const PropertyDispatch &p = propertyDispatch.at(index);
     if (debugMessages)
-        LogStream("mpvobject") << name << " property changed to " << v;
+        LogStream("mpvobject") << p.name << " property changed to " << v;
 
     bool ok = v.type() < QVariant::UserType;
-    if (propertyDispatch.contains(name))
-        propertyDispatch[name](this, ok, v);
-    else
-        LogStream("mpvobject") << name << " property changed, but was not in dispatch list.";
+    p.dispatch(this, ok, v);
 }
 
+
 void MpvObject::ctrl_hookEvent(QString name, uint64_t selfId, uint64_t mpvId)
 {
     if (reinterpret_cast<MpvObject*>(selfId) != this)
@@ -623,6 +650,10 @@ void MpvObject::ctrl_unhandledMpvEvent(int eventLevel)
     case MPV_EVENT_START_FILE: {
         if (debugMessages)
             Logger::log("mpvobject", "start file");
+        // Whatever the new file has is news, even if it is the same.
+        tracks_.clear();
+        chapters_.clear();
+        metadata_.clear();
         emit playbackLoading();
         break;
     }
@@ -632,6 +663,12 @@ void MpvObject::ctrl_unhandledMpvEvent(int eventLevel)
         emit playbackStarted();
         break;
     }
+    case MPV_EVENT_PLAYBACK_RESTART: {
+        // Sent once playback is going again after opening or seeking, with
+        // the frame at the new position out.
+        emit playbackRestarted();
+        break;
+    }
     case MPV_EVENT_END_FILE: {
         if (debugMessages)
             Logger::log("mpvobject", "end file");
@@ -659,6 +696,13 @@ void MpvObject::ctrl_videoSizeChanged(QSize size)
     emit videoSizeChanged(videoSize_);
 }
 
+void MpvObject::ctrl_typedPropertiesWaiting()
+{
+    // Idle and paused players send nothing, so only tick while they do.
+    if (!sampleTimer->isActive())
+        sampleTimer->start();
+}
+
 void MpvObject::self_playTimeChanged(double playTime)
 {
     playTime_ = playTime;
@@ -676,9 +720,32 @@ void MpvObject::self_metadata(QVariantMap metadata)
     QVariantMap map;
     for (auto it = metadata.begin(); it != metadata.end(); it++)
         map.insert(it.key().toLower(), it.value());
+    // mpv notifies on every change to a stream's tags, whether or not the
+    // ones we see changed.
+    if (map == metadata_)
+        return;
+    metadata_ = map;
     emit metaDataChanged(map);
 }
 
+void MpvObject::self_tracks(QVariantList tracks)
+{
+    // Selecting a track sends the whole list again.  The listeners rebuild
+    // menus from it, so leave them be when it is the same.
+    if (tracks == tracks_)
+        return;
+    tracks_ = tracks;
+    emit tracksChanged(tracks);
+}
+
+void MpvObject::self_chapters(QVariantList chapters)
+{
+    if (chapters == chapters_)
+        return;
+    chapters_ = chapters;
+    emit chaptersChanged(chapters);
+}
+
 void MpvObject::self_audioDeviceList(const QVariantList &list)
 {
     emit audioDeviceList(AudioDevice::listFromVList(list));
@@ -696,6 +763,31 @@ void MpvObject::hideTimer_timeout()
     hideCursor();
 }
 
+void MpvObject::sampleTimer_timeout()
+{
+    sampleTick++;
+    QVariant v;
+    bool busy = false;
+    for (const SampledProperty &p : sampledProperties) {
+        if (sampleTick % p.intervalTicks != 0) {
+            busy = busy || ctrl->hasTypedProperty(p.index);
+        } else if (ctrl->takeTypedProperty(p.index, v)) {
+            ctrl_propertyChanged(p.index, v);
+            busy = true;
+        }
+    }
+    if (busy)
+        return;
+
+    // Nothing is happening, so stop until the controller says otherwise.  A
+    // change landing while the wake is rearmed is caught by looking again.
+    ctrl->rearmTypedWake();
+    for (const SampledProperty &p : sampledProperties)
+        if (ctrl->hasTypedProperty(p.index))
+            return;
+    sampleTimer->stop();
+}
+
 //----------------------------------------------------------------------------
 
 MpvWidgetInterface::MpvWidgetInterface(MpvObject *object)
@@ -748,6 +840,28 @@ static void* GLAPIENTRY glMPGetNativeDisplay(const char* name)
     return nullptr;
 }
 
+static void assignNativeDisplay(mpv_render_param &param, const char *prefix)
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_DARWIN)
+    if (QGuiApplication::platformName().contains("xcb")) {
+        Logger::log(prefix, "assigning x11 display");
+        param.type = MPV_RENDER_PARAM_X11_DISPLAY;
+        param.data = QX11Info::display();
+        return;
+    }
+    if (QGuiApplication::platformName().contains("wayland")) {
+        Logger::log(prefix, "assigning wayland display");
+        QPlatformNativeInterface *native = QGuiApplication::platformNativeInterface();
+        param.type = MPV_RENDER_PARAM_WL_DISPLAY;
+        param.data = native->nativeResourceForWindow("display", nullptr);
+        return;
+    }
+#else
+    Q_UNUSED(param);
+#endif
+    Logger::log(prefix, "unknown display mode (eglfs et al)");
+}
+
  void *MpvGlWidget::get_proc_address(void *ctx, const char *name)
  {
     (void)ctx;
@@ -792,6 +906,12 @@ MpvGlWidget::MpvGlWidget(MpvObject *object, QWidget *parent) :
     connect(mpvObject, &MpvObject::playbackFinished,
             this, &MpvGlWidget::self_playbackFinished);
     setContextMenuPolicy(Qt::CustomContextMenu);
+
+    paceTimer = new QTimer(this);
+    paceTimer->setSingleShot(true);
+    paceTimer->setTimerType(Qt::PreciseTimer);
+    connect(paceTimer, &QTimer::timeout,
+            this, [this]() { update(); });
 }
 
 MpvGlWidget::~MpvGlWidget()
@@ -858,24 +978,10 @@ void MpvGlWidget::initializeGL()
         { MPV_RENDER_PARAM_INVALID, nullptr }
     };
     QWidget *nativeParent = nativeParentWidget();
-    if (nativeParent == nullptr) {
+    if (nativeParent == nullptr)
         Logger::log("glwidget", "no native parent handle");
-    }
-#if defined(Q_OS_UNIX) && !defined(Q_OS_DARWIN)
-    else if (QGuiApplication::platformName().contains("xcb")) {
-        Logger::log("glwidget", "assigning x11 display");
-        params[2].type = MPV_RENDER_PARAM_X11_DISPLAY;
-        params[2].data = QX11Info::display();
-    } else if (QGuiApplication::platformName().contains("wayland")) {
-        Logger::log("glwidget", "assigning wayland display");
-        QPlatformNativeInterface *native = QGuiApplication::platformNativeInterface();
-        params[2].type = MPV_RENDER_PARAM_WL_DISPLAY;
-        params[2].data = native->nativeResourceForWindow("display", nullptr);
-    } else
-#endif
-    {
-        Logger::log("glwidget", "unknown display mode (eglfs et al)");
-    }
+    else
+        assignNativeDisplay(params[2], "glwidget");
     render = ctrl->createRenderContext(params);
     mpv_render_context_set_update_callback(render, MpvGlWidget::render_update, this);
 }
@@ -890,13 +996,21 @@ void MpvGlWidget::paintGL()
         return;
     }
 
-    bool yes = true;
+    // The frame was scheduled for its time already, so don't let mpv wait
+    // for it on the gui thread.
+    int yes = 1, no = 0;
     mpv_opengl_fbo fbo { static_cast<int>(defaultFramebufferObject()), glWidth, glHeight, 0 };
     mpv_render_param params[] {
         {MPV_RENDER_PARAM_OPENGL_FBO, &fbo },
-        {MPV_RENDER_PARAM_FLIP_Y, &yes}
+        {MPV_RENDER_PARAM_FLIP_Y, &yes},
+        {MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME, &no},
+        {MPV_RENDER_PARAM_INVALID, nullptr}
     };
+    QElapsedTimer renderClock;
+    renderClock.start();
     mpv_render_context_render(render, params);
+    renderNsec = renderClock.nsecsElapsed();
+    frameRendered = true;
 }
 
 void MpvGlWidget::resizeGL(int w, int h)
@@ -924,6 +1038,13 @@ void MpvGlWidget::render_update(void *ctx)
     QMetaObject::invokeMethod(reinterpret_cast<MpvGlWidget*>(ctx), "maybeUpdate");
 }
 
+int64_t MpvGlWidget::vsyncMicroseconds()
+{
+    QWindow *handle = window()->windowHandle();
+    qreal rate = handle && handle->screen() ? handle->screen()->refreshRate() : 0;
+    return int64_t(1000000 / (rate >= 1 ? rate : 60));
+}
+
 void MpvGlWidget::maybeUpdate()
 {
     if (window()->isMinimized()) {
@@ -932,15 +1053,72 @@ void MpvGlWidget::maybeUpdate()
         context()->swapBuffers(context()->surface());
         self_frameSwapped();
         doneCurrent();
-    } else {
+        return;
+    }
+    if (drawLogo || !render) {
         update();
+        return;
+    }
+
+    // Nothing to paint unless mpv has a new frame, or wants the current
+    // one redrawn.  While paused, this is most of the time.
+    if (!(mpv_render_context_update(render) & MPV_RENDER_UPDATE_FRAME))
+        return;
+
+    // Paint a refresh ahead of the frame's time, so that the swap, which
+    // waits for vblank, puts it on screen when due.
+    mpv_render_frame_info info {};
+    mpv_render_param param { MPV_RENDER_PARAM_NEXT_FRAME_INFO, &info };
+    frameTarget = 0;
+    if (mpv_render_context_get_info(render, param) >= 0
+            && (info.flags & MPV_RENDER_FRAME_INFO_PRESENT)
+            && info.target_time > 0) {
+        frameTarget = info.target_time;
+        int64_t wait = frameTarget - ctrl->timeMicroseconds() - vsyncMicroseconds();
+        if (wait >= 1000) {
+            paceTimer->start(int(wait / 1000));
+            return;
+        }
     }
+    paceTimer->stop();
+    update();
 }
 
 void MpvGlWidget::self_frameSwapped()
 {
-    if (!drawLogo)
-        mpv_render_context_report_swap(render);
+    if (drawLogo)
+        return;
+    mpv_render_context_report_swap(render);
+    if (!frameRendered)
+        return;
+    frameRendered = false;
+
+    if (!timingClock.isValid())
+        timingClock.start();
+    // Gaps from pausing or seeking would swamp the average.
+    if (swapClock.isValid() && swapClock.elapsed() < timingLogInterval)
+        swapNsecTotal += swapClock.nsecsElapsed();
+    swapClock.start();
+    timedFrames++;
+    renderNsecTotal += renderNsec;
+    // Late by more than half a refresh means it missed its vblank.
+    if (frameTarget > 0 && ctrl->timeMicroseconds() > frameTarget + vsyncMicroseconds() / 2)
+        lateFrames++;
+    if (timingClock.elapsed() >= timingLogInterval)
+        logTimings();
+}
+
+void MpvGlWidget::logTimings()
+{
+    if (mpvObject->clientDebuggingMessages() && timedFrames > 0) {
+        LogStream("glwidget") << "frames: " << timedFrames
+                              << ", late: " << lateFrames
+                              << ", render: " << renderNsecTotal / timedFrames / 1e6 << "ms"
+                              << ", swap interval: " << swapNsecTotal / timedFrames / 1e6 << "ms";
+    }
+    timingClock.restart();
+    timedFrames = lateFrames = 0;
+    renderNsecTotal = swapNsecTotal = 0;
 }
 
 void MpvGlWidget::self_playbackStarted()
@@ -949,6 +1127,208 @@ void MpvGlWidget::self_playbackStarted()
 }
 
 void MpvGlWidget::self_playbackFinished()
+{
+    paceTimer->stop();
+    swapClock.invalidate();
+    drawLogo = true;
+    update();
+}
+
+
+
+MpvEmbedWidget::MpvEmbedWidget(MpvObject *object) :
+    QOpenGLWindow(QOpenGLWindow::NoPartialUpdate), MpvWidgetInterface(object)
+{
+    container = QWidget::createWindowContainer(this);
+    container->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(this, &QOpenGLWindow::frameSwapped,
+            this, &MpvEmbedWidget::self_frameSwapped);
+    connect(mpvObject, &MpvObject::playbackStarted,
+            this, &MpvEmbedWidget::self_playbackStarted);
+    connect(mpvObject, &MpvObject::playbackFinished,
+            this, &MpvEmbedWidget::self_playbackFinished);
+}
+
+MpvEmbedWidget::~MpvEmbedWidget()
+{
+    makeCurrent();
+    if (render) {
+        ctrl->destroyRenderContext(render);
+        render = nullptr;
+    }
+    if (logo) {
+        delete logo;
+        logo = nullptr;
+    }
+    doneCurrent();
+    // The container would delete its window, i.e. us, if it went first.
+    // Going after, it finds nothing left to delete.
+    container->hide();
+    container->deleteLater();
+}
+
+QWidget *MpvEmbedWidget::self()
+{
+    return container;
+}
+
+void MpvEmbedWidget::initMpv()
+{
+    // this takes place in initializeGL
+}
+
+void MpvEmbedWidget::setLogoUrl(const QString &filename)
+{
+    makeCurrent();
+    if (!logo) {
+        logo = new LogoDrawer(this);
+        connect(logo, &LogoDrawer::logoSize,
+                mpvObject, &MpvObject::logoSizeChanged);
+    }
+    logo->setLogoUrl(filename);
+    logo->resizeGL(width(), height());
+    if (drawLogo)
+        update();
+    doneCurrent();
+}
+
+void MpvEmbedWidget::setLogoBackground(const QColor &color)
+{
+    logo->setLogoBackground(color);
+}
+
+void MpvEmbedWidget::setDrawLogo(bool yes)
+{
+    drawLogo = yes;
+    update();
+}
+
+void MpvEmbedWidget::initializeGL()
+{
+    if (!logo)
+        logo = new LogoDrawer(this);
+
+    mpv_opengl_init_params glInit { &MpvGlWidget::get_proc_address, this, nullptr };
+    mpv_render_param params[] {
+        { MPV_RENDER_PARAM_API_TYPE, const_cast<char*>(MPV_RENDER_API_TYPE_OPENGL) },
+        { MPV_RENDER_PARAM_OPENGL_INIT_PARAMS, &glInit },
+        { MPV_RENDER_PARAM_INVALID, nullptr },
+        { MPV_RENDER_PARAM_INVALID, nullptr }
+    };
+    assignNativeDisplay(params[2], "embedwidget");
+    render = ctrl->createRenderContext(params);
+    mpv_render_context_set_update_callback(render, MpvEmbedWidget::render_update, this);
+}
+
+void MpvEmbedWidget::paintGL()
+{
+    if (mpvObject->clientDebuggingMessages())
+        Logger::log("embedwidget", "paintGL");
+    if (drawLogo || !render) {
+        if (logo)
+            logo->paintGL(this);
+        return;
+    }
+
+    // Without partial updates, the default framebuffer is the window's own.
+    int yes = 1;
+    mpv_opengl_fbo fbo { static_cast<int>(defaultFramebufferObject()), glWidth, glHeight, 0 };
+    mpv_render_param params[] {
+        {MPV_RENDER_PARAM_OPENGL_FBO, &fbo },
+        {MPV_RENDER_PARAM_FLIP_Y, &yes},
+        {MPV_RENDER_PARAM_INVALID, nullptr}
+    };
+    mpv_render_context_render(render, params);
+}
+
+void MpvEmbedWidget::resizeGL(int w, int h)
+{
+    qreal r = devicePixelRatio();
+    glWidth = int(w * r);
+    glHeight = int(h * r);
+    if (logo)
+        logo->resizeGL(width(), height());
+}
+
+bool MpvEmbedWidget::event(QEvent *event)
+{
+    switch (event->type()) {
+    case QEvent::MouseMove: {
+        auto mouse = static_cast<QMouseEvent*>(event);
+        emit mpvObject->mouseMoved(mouse->x(), mouse->y());
+        break;
+    }
+    case QEvent::MouseButtonPress: {
+        auto mouse = static_cast<QMouseEvent*>(event);
+        emit mpvObject->mousePress(mouse->x(), mouse->y());
+        break;
+    }
+    case QEvent::MouseButtonRelease: {
+        // Native windows don't get context menu events on every platform.
+        auto mouse = static_cast<QMouseEvent*>(event);
+        if (mouse->button() == Qt::RightButton) {
+            QContextMenuEvent menuEvent(QContextMenuEvent::Mouse, mouse->pos(),
+                                        mouse->globalPos(), mouse->modifiers());
+            QCoreApplication::sendEvent(container, &menuEvent);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    switch (event->type()) {
+    case QEvent::MouseMove:
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::Wheel:
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:
+        QCoreApplication::sendEvent(container, event);
+        return true;
+    default:
+        return QOpenGLWindow::event(event);
+    }
+}
+
+void MpvEmbedWidget::render_update(void *ctx)
+{
+    QMetaObject::invokeMethod(reinterpret_cast<MpvEmbedWidget*>(ctx), "maybeUpdate");
+}
+
+void MpvEmbedWidget::maybeUpdate()
+{
+    if (drawLogo || !render) {
+        update();
+        return;
+    }
+    if (!(mpv_render_context_update(render) & MPV_RENDER_UPDATE_FRAME))
+        return;
+    if (!isExposed()) {
+        // mpv waits on its frames being drawn, so draw them even when they
+        // can't be seen.
+        makeCurrent();
+        paintGL();
+        doneCurrent();
+        mpv_render_context_report_swap(render);
+        return;
+    }
+    update();
+}
+
+void MpvEmbedWidget::self_frameSwapped()
+{
+    if (!drawLogo)
+        mpv_render_context_report_swap(render);
+}
+
+void MpvEmbedWidget::self_playbackStarted()
+{
+    drawLogo = false;
+}
+
+void MpvEmbedWidget::self_playbackFinished()
 {
     drawLogo = true;
     update();
@@ -971,20 +1351,18 @@ void MpvCallback::reply(QVariant value)
 
 
 
+// Set in the reply_userdata of the properties MpvObject observes, which
+// carry their index in the rest.  Ipc clients may not use ids with it set.
+constexpr uint64_t internalPropertyTag = uint64_t(1) << 63;
+
 MpvController::MpvController(QObject *parent) : QObject(parent),
     lastVideoSize(0,0)
 {
-    throttler = new QTimer(this);
-    connect(throttler, &QTimer::timeout,
-            this, &MpvController::flushProperties);
-    throttler->setInterval(1000/12);
-    throttler->start();
 }
 
 MpvController::~MpvController()
 {
     stop();
-    throttler->deleteLater();
 }
 
 void MpvController::create(const OptionList &earlyOptions)
@@ -1036,13 +1414,29 @@ void MpvController::continueHook(uint64_t mpvId)
     mpv_hook_continue(mpv, mpvId);
 }
 
-int MpvController::observeProperties(const MpvController::PropertyList &properties,
-                                      const QSet<QString> &throttled)
+uint64_t MpvController::internalPropertyId(int index)
+{
+    return internalPropertyTag | uint64_t(index);
+}
+
+bool MpvController::isInternalPropertyId(uint64_t userData)
+{
+    return userData & internalPropertyTag;
+}
+
+int MpvController::observeProperties(const MpvController::PropertyList &properties)
 {
     int rval = 0;
-    foreach (const MpvProperty &item, properties)
+    foreach (const MpvProperty &item, properties) {
+        int index = int(item.userData & ~internalPropertyTag);
+        if (item.typed && isInternalPropertyId(item.userData)
+                && index < maxTypedProperties
+                && (item.format == MPV_FORMAT_DOUBLE
+                    || item.format == MPV_FORMAT_INT64
+                    || item.format == MPV_FORMAT_FLAG))
+            typedSlots[index].format = item.format;
         rval  = std::min(rval, mpv_observe_property(mpv, item.userData, item.name.toUtf8().data(), item.format));
-    throttledProperties.unite(throttled);
+    }
     return rval;
 }
 
@@ -1054,11 +1448,6 @@ int MpvController::unobservePropertiesById(const QSet<uint64_t> &ids)
     return rval;
 }
 
-void MpvController::setThrottleTime(int msec)
-{
-    throttler->setInterval(msec);
-}
-
 QString MpvController::clientName()
 {
     return QString::fromUtf8(mpv_client_name(mpv));
@@ -1192,16 +1581,54 @@ void MpvController::parseMpvEvents()
     }
 }
 
-void MpvController::setThrottledProperty(const QString &name, const QVariant &v, uint64_t userData)
+bool MpvController::takeTypedProperty(int index, QVariant &v)
+{
+    if (index < 0 || index >= maxTypedProperties)
+        return false;
+    TypedSlot &slot = typedSlots[index];
+    int state = slot.state.exchange(NoChange, std::memory_order_acquire);
+    if (state == NoChange)
+        return false;
+    // None of these need an allocation.
+    if (state == ValueUnavailable)
+        v = QVariant::fromValue<MpvErrorCode>(MpvErrorCode(MPV_ERROR_PROPERTY_UNAVAILABLE));
+    else if (slot.format == MPV_FORMAT_DOUBLE)
+        v = slot.real.load(std::memory_order_relaxed);
+    else if (slot.format == MPV_FORMAT_FLAG)
+        v = slot.integer.load(std::memory_order_relaxed) != 0;
+    else
+        v = qlonglong(slot.integer.load(std::memory_order_relaxed));
+    return true;
+}
+
+bool MpvController::hasTypedProperty(int index)
 {
-    throttledValues.insert(name, QPair<QVariant,uint64_t>(v,userData));
+    if (index < 0 || index >= maxTypedProperties)
+        return false;
+    return typedSlots[index].state.load(std::memory_order_seq_cst) != NoChange;
 }
 
-void MpvController::flushProperties()
+void MpvController::rearmTypedWake()
 {
-    for (auto it = throttledValues.begin(); it != throttledValues.end(); it++)
-        emit mpvPropertyChanged(it.key(), it.value().first, it.value().second);
-    throttledValues.clear();
+    typedWakeArmed.store(true, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void MpvController::setTypedProperty(TypedSlot &slot, const mpv_event_property *prop)
+{
+    // A newer value may land between the reader clearing the state and
+    // loading it.  Then it is read twice, which does no harm.
+    if (prop->format != slot.format || prop->data == nullptr) {
+        slot.state.store(ValueUnavailable, std::memory_order_release);
+        return;
+    }
+    if (prop->format == MPV_FORMAT_DOUBLE)
+        slot.real.store(*reinterpret_cast<double*>(prop->data), std::memory_order_relaxed);
+    else if (prop->format == MPV_FORMAT_FLAG)
+        slot.integer.store(*reinterpret_cast<int*>(prop->data), std::memory_order_relaxed);
+    else
+        slot.integer.store(*reinterpret_cast<int64_t*>(prop->data), std::memory_order_relaxed);
+    slot.state.store(ValueChanged, std::memory_order_release);
 }
 
 void MpvController::handleMpvEvent(mpv_event *event)
@@ -1268,12 +1695,23 @@ void MpvController::handleMpvEvent(mpv_event *event)
         break;
     }
     case MPV_EVENT_PROPERTY_CHANGE: {
-        QVariant v = propertyToVariant(reinterpret_cast<mpv_event_property*>(event->data));
-        QString propname = QString::fromUtf8(reinterpret_cast<mpv_event_property*>(event->data)->name);
-        if (throttledProperties.contains(propname))
-            setThrottledProperty(propname, v, event->reply_userdata);
-        else
-            emit mpvPropertyChanged(propname, v, event->reply_userdata);
+        auto prop = reinterpret_cast<mpv_event_property*>(event->data);
+        if (!isInternalPropertyId(event->reply_userdata)) {
+            emit mpvPropertyChanged(QString::fromUtf8(prop->name),
+                                    propertyToVariant(prop),
+                                    event->reply_userdata);
+            break;
+        }
+        int index = int(event->reply_userdata & ~internalPropertyTag);
+        if (index < maxTypedProperties && typedSlots[index].format != MPV_FORMAT_NONE) {
+            setTypedProperty(typedSlots[index], prop);
+            // Pairs with rearmTypedWake, so that the reader either sees this
+            // change or hears about it.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (typedWakeArmed.exchange(false, std::memory_order_seq_cst))
+                emit typedPropertiesWaiting();
+        } else
+            emit propertyChanged(index, propertyToVariant(prop));
         break;
     }
     case MPV_EVENT_LOG_MESSAGE: {
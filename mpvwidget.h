@@ -1,12 +1,15 @@
 #ifndef MPVWIDGET_H
 #define MPVWIDGET_H
 
+#include <QElapsedTimer>
 #include <QOpenGLWidget>
+#include <QOpenGLWindow>
 #include <QOpenGLTexture>
 #include <QTimer>
 #include <QVariant>
 #include <QSet>
 #include <QMap>
+#include <atomic>
 #include <functional>
 #include <mpv/client.h>
 //#include <mpv/opengl_cb.h>
@@ -28,7 +31,15 @@ class MpvObject : public QObject
     Q_OBJECT
 
     typedef std::function<void(MpvObject*,bool,const QVariant&)> PropertyDispatchFunction;
-    typedef QMap<QString, PropertyDispatchFunction> PropertyDispatchMap;
+    struct PropertyDispatch {
+        const char *name;
+        mpv_format format;
+        // Changes are passed on at most once per this many msec, or as they
+        // come when zero.
+        int throttleMsec;
+        PropertyDispatchFunction dispatch;
+    };
+    typedef QVector<PropertyDispatch> PropertyDispatchTable;
 public:
     explicit MpvObject(QObject *owner, const QString &clientName = "mpv");
     ~MpvObject();
@@ -106,6 +117,7 @@ signals:
     void seekableChanged(bool yes);
     void playbackLoading();
     void playbackStarted();
+    void playbackRestarted();
     void pausedChanged(bool yes);
     void playbackFinished();
     void playbackIdling();
@@ -140,20 +152,25 @@ private:
     void hideCursor();
 
 private slots:
-    void ctrl_mpvPropertyChanged(QString name, QVariant v);
+    void ctrl_propertyChanged(int index, QVariant v);
     void ctrl_hookEvent(QString name, uint64_t selfId, uint64_t mpvId);
     void ctrl_unhandledMpvEvent(int eventLevel);
     void ctrl_videoSizeChanged(QSize size);
+    void ctrl_typedPropertiesWaiting();
     void self_playTimeChanged(double playTime);
     void self_playLengthChanged(double playLength);
     void self_metadata(QVariantMap metadata);
+    void self_tracks(QVariantList tracks);
+    void self_chapters(QVariantList chapters);
     void self_audioDeviceList(const QVariantList &list);
     void hideTimer_timeout();
+    void sampleTimer_timeout();
 
     void self_mouseMoved();
 
 private:
-    static PropertyDispatchMap propertyDispatch;
+    // Observed properties, by the index they are reported with.
+    static PropertyDispatchTable propertyDispatch;
 
     Helpers::MpvWidgetType widgetType = Helpers::NullWidget;
     QLayout *hostLayout = nullptr;
@@ -163,11 +180,25 @@ private:
 
     QThread *worker = nullptr;
     QTimer *hideTimer = nullptr;
+    QTimer *sampleTimer = nullptr;
+
+    // Throttled properties are taken from the controller on every so many
+    // ticks of the sample timer.
+    struct SampledProperty {
+        int index;
+        int intervalTicks;
+    };
+    QVector<SampledProperty> sampledProperties;
+    uint64_t sampleTick = 0;
 
     QVariantMap cachedState;
     QSize videoSize_;
     double playTime_ = 0.0;
     double playLength_ = 0.0;
+    // The last of these passed on, to hold back repeats.
+    QVariantList tracks_;
+    QVariantList chapters_;
+    QVariantMap metadata_;
 
     int shownStatsPage = 0;
     bool loopImages = true;
@@ -223,6 +254,8 @@ protected:
 
 private:
     static void render_update(void *ctx);
+    int64_t vsyncMicroseconds();
+    void logTimings();
 
 private slots:
     void maybeUpdate();
@@ -235,14 +268,69 @@ private:
     LogoDrawer *logo = nullptr;
     bool drawLogo = true;
     int glWidth = 0, glHeight = 0;
+
+    // Frames are painted about one refresh ahead of when mpv wants them
+    // shown, rather than as soon as they are ready.
+    QTimer *paceTimer = nullptr;
+    int64_t frameTarget = 0;
+    bool frameRendered = false;
+    qint64 renderNsec = 0;
+
+    // Frame timing since timingClock was last restarted.
+    QElapsedTimer timingClock;
+    QElapsedTimer swapClock;
+    int timedFrames = 0;
+    int lateFrames = 0;
+    qint64 renderNsecTotal = 0;
+    qint64 swapNsecTotal = 0;
 };
 
 
 // FIXME: implement MpvVulkanCbWidget
 typedef MpvGlWidget MpvVulkanCbWidget;
 
-// FIXME: implement MpvEmbedWidget
-typedef MpvGlWidget MpvEmbedWidget;
+// Renders straight to the surface of a native window, which is put in the
+// widget tree with a window container.  This skips the full-frame copy that
+// QOpenGLWidget makes when compositing its fbo into the window, at the cost
+// of widgets no longer being drawn over the video.  Input is handed to the
+// container, so that it reaches the widgets around it as usual.
+class MpvEmbedWidget : public QOpenGLWindow, public MpvWidgetInterface
+{
+    Q_OBJECT
+    Q_INTERFACES(MpvWidgetInterface)
+
+public:
+    explicit MpvEmbedWidget(MpvObject *object);
+    ~MpvEmbedWidget();
+
+    QWidget *self();
+    void initMpv();
+    void setLogoUrl(const QString &filename);
+    void setLogoBackground(const QColor &color);
+    void setDrawLogo(bool yes);
+
+protected:
+    void initializeGL();
+    void paintGL();
+    void resizeGL(int w, int h);
+    bool event(QEvent *event);
+
+private:
+    static void render_update(void *ctx);
+
+private slots:
+    void maybeUpdate();
+    void self_frameSwapped();
+    void self_playbackStarted();
+    void self_playbackFinished();
+
+private:
+    QWidget *container = nullptr;
+    mpv_render_context *render = nullptr;
+    LogoDrawer *logo = nullptr;
+    bool drawLogo = true;
+    int glWidth = 0, glHeight = 0;
+};
 
 
 
@@ -291,8 +379,12 @@ public:
         QString name;
         uint64_t userData;
         mpv_format format;
-        MpvProperty(const QString &name, uint64_t userData, mpv_format format)
-            : name(name), userData(userData), format(format) {}
+        // Whether to leave changes for takeTypedProperty rather than signal
+        // them.  Only for internal ids and numeric formats.
+        bool typed;
+        MpvProperty(const QString &name, uint64_t userData, mpv_format format,
+                    bool typed = false)
+            : name(name), userData(userData), format(format), typed(typed) {}
     };
     typedef QVector<MpvProperty> PropertyList;
     struct MpvOption {
@@ -304,16 +396,37 @@ public:
     MpvController(QObject *parent = nullptr);
     ~MpvController();
 
+    // Properties observed with an internal id are reported by their index
+    // through propertyChanged, or left for takeTypedProperty when typed.
+    // Any other id (i.e. from ipc clients) is reported by name through
+    // mpvPropertyChanged.
+    static uint64_t internalPropertyId(int index);
+    static bool isInternalPropertyId(uint64_t userData);
+
+    // Typed properties skip the event queue.  The latest change of each is
+    // kept in a slot of atomics, and this takes it out if there was one
+    // since the last call.  Safe to call from any thread, but only one.
+    bool takeTypedProperty(int index, QVariant &v);
+    // Whether there is a change of the property waiting to be taken.
+    bool hasTypedProperty(int index);
+    // Has the next change of any typed property emit typedPropertiesWaiting,
+    // for when the reader stops looking.
+    void rearmTypedWake();
+
 signals:
     void durationChanged(int value);
     void positionChanged(int value);
     void mpvPropertyChanged(QString name, QVariant v, uint64_t userData);
+    void propertyChanged(int index, QVariant v);
     void logMessageByParts(QString prefix, QString level, QString msg);
     //void logMessage(QString message);
     void clientMessage(uint64_t id, QStringList args);
     void videoSizeChanged(QSize size);
     void hookEvent(QString hookName, uint64_t selfId, uint64_t mpvId);
     void unhandledMpvEvent(int eventNumber);
+    // A typed property changed, and nobody was looking.  Emitted once until
+    // rearmTypedWake is called.
+    void typedPropertiesWaiting();
 
 public slots:
     void create(const MpvController::OptionList &earlyOptions);
@@ -324,10 +437,8 @@ public slots:
     void addHook(const QString &name, uint64_t selfId);
     void continueHook(uint64_t mpvId);
 
-    int observeProperties(const MpvController::PropertyList &properties,
-                          const QSet<QString> &throttled = QSet<QString>());
+    int observeProperties(const MpvController::PropertyList &properties);
     int unobservePropertiesById(const QSet<uint64_t> &ids);
-    void setThrottleTime(int msec);
 
     QString clientName();
     QStringList protocolList();
@@ -351,19 +462,26 @@ public slots:
     void parseMpvEvents();
 
 private:
-    void setThrottledProperty(const QString &name, const QVariant &v, uint64_t userData);
-    void flushProperties();
+    enum TypedState { NoChange, ValueChanged, ValueUnavailable };
+    struct TypedSlot {
+        std::atomic<int> state { NoChange };
+        std::atomic<double> real { 0.0 };
+        std::atomic<int64_t> integer { 0 };
+        // Written before the property is observed, and left alone after.
+        mpv_format format = MPV_FORMAT_NONE;
+    };
+
     void handleMpvEvent(mpv_event *event);
+    static void setTypedProperty(TypedSlot &slot, const mpv_event_property *prop);
     static void mpvWakeup(void *ctx);
 
     mpv::qt::Handle mpv;
     QStringList protocolList_;
     QSize lastVideoSize = QSize(0,0);
 
-    QTimer *throttler = nullptr;
-    QSet<QString> throttledProperties;
-    typedef QMap<QString,QPair<QVariant,uint64_t>> ThrottledValueMap;
-    ThrottledValueMap throttledValues;
+    static constexpr int maxTypedProperties = 32;
+    TypedSlot typedSlots[maxTypedProperties];
+    std::atomic<bool> typedWakeArmed { true };
 
     int shownStatsPage = 0;
 };
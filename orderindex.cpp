@@ -0,0 +1,164 @@
+#include "orderindex.h"
+
+OrderIndex::OrderIndex()
+{
+}
+
+void OrderIndex::insert(int position, int count, int *ids)
+{
+    if (count <= 0)
+        return;
+    for (int i = 0; i < count; i++)
+        ids[i] = newNode();
+    int added = build(ids, count);
+    int first, rest;
+    split(root, position, first, rest);
+    root = merge(merge(first, added), rest);
+    nodes[root].parent = -1;
+}
+
+void OrderIndex::remove(int id)
+{
+    // The children's priorities are all below this node's, so the merged
+    // pair can take its place as it is.
+    Node &node = nodes[id];
+    int merged = merge(node.left, node.right);
+    int parent = node.parent;
+    if (merged >= 0)
+        nodes[merged].parent = parent;
+    if (parent < 0)
+        root = merged;
+    else if (nodes[parent].left == id)
+        nodes[parent].left = merged;
+    else
+        nodes[parent].right = merged;
+    for (int p = parent; p >= 0; p = nodes[p].parent)
+        nodes[p].size--;
+    nodes[id] = Node();
+    unused.push_back(id);
+}
+
+int OrderIndex::position(int id) const
+{
+    // Everything to the left of the node and of each ancestor it is on the
+    // right of comes before it.
+    int index = sizeOf(nodes[id].left);
+    for (int n = id, p = nodes[id].parent; p >= 0; n = p, p = nodes[p].parent)
+        if (nodes[p].right == n)
+            index += sizeOf(nodes[p].left) + 1;
+    return index;
+}
+
+int OrderIndex::count() const
+{
+    return sizeOf(root);
+}
+
+void OrderIndex::clear()
+{
+    nodes.clear();
+    unused.clear();
+    root = -1;
+}
+
+int OrderIndex::sizeOf(int node) const
+{
+    return node < 0 ? 0 : nodes[node].size;
+}
+
+void OrderIndex::update(int node)
+{
+    Node &n = nodes[node];
+    n.size = 1 + sizeOf(n.left) + sizeOf(n.right);
+    if (n.left >= 0)
+        nodes[n.left].parent = node;
+    if (n.right >= 0)
+        nodes[n.right].parent = node;
+}
+
+int OrderIndex::newNode()
+{
+    // xorshift32 is plenty to keep the tree balanced.
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    int id;
+    if (!unused.empty()) {
+        id = unused.back();
+        unused.pop_back();
+    } else {
+        id = int(nodes.size());
+        nodes.emplace_back();
+    }
+    nodes[id].priority = seed;
+    return id;
+}
+
+int OrderIndex::build(const int *ids, int count)
+{
+    // Entries arrive in order, so the tree can be built in one pass with
+    // the right spine on a stack, rather than by count separate inserts.
+    std::vector<int> spine;
+    for (int i = 0; i < count; i++) {
+        int id = ids[i];
+        int last = -1;
+        while (!spine.empty() && nodes[spine.back()].priority < nodes[id].priority) {
+            last = spine.back();
+            spine.pop_back();
+            update(last);
+        }
+        nodes[id].left = last;
+        if (!spine.empty())
+            nodes[spine.back()].right = id;
+        spine.push_back(id);
+    }
+    int top = spine.front();
+    while (!spine.empty()) {
+        update(spine.back());
+        spine.pop_back();
+    }
+    return top;
+}
+
+void OrderIndex::split(int node, int count, int &first, int &rest)
+{
+    if (node < 0) {
+        first = rest = -1;
+        return;
+    }
+    int leftSize = sizeOf(nodes[node].left);
+    if (count <= leftSize) {
+        int left;
+        split(nodes[node].left, count, first, left);
+        nodes[node].left = left;
+        rest = node;
+    } else {
+        int right;
+        split(nodes[node].right, count - leftSize - 1, right, rest);
+        nodes[node].right = right;
+        first = node;
+    }
+    update(node);
+    if (first >= 0)
+        nodes[first].parent = -1;
+    if (rest >= 0)
+        nodes[rest].parent = -1;
+}
+
+int OrderIndex::merge(int first, int rest)
+{
+    if (first < 0)
+        return rest;
+    if (rest < 0)
+        return first;
+    if (nodes[first].priority > nodes[rest].priority) {
+        int right = merge(nodes[first].right, rest);
+        nodes[first].right = right;
+        update(first);
+        return first;
+    }
+    int left = merge(first, nodes[rest].left);
+    nodes[rest].left = left;
+    update(rest);
+    return rest;
+}
@@ -0,0 +1,50 @@
+#ifndef ORDERINDEX_H
+#define ORDERINDEX_H
+// The positions of a sequence of entries, kept as an implicit treap so that
+// finding where an entry is, and inserting or removing entries anywhere,
+// all take logarithmic time.  Nothing has to be renumbered when entries go
+// in or out at the front.
+//
+// Entries are known by the ids insert() hands out, which stay the same for
+// as long as the entry is there.  Ids of removed entries are reused.  It
+// only uses the standard library, so that the benchmarks can build it on
+// its own.
+
+#include <cstdint>
+#include <vector>
+
+class OrderIndex {
+public:
+    OrderIndex();
+
+    // Puts count new entries at position, in order, and writes their ids to
+    // ids.
+    void insert(int position, int count, int *ids);
+    void remove(int id);
+    int position(int id) const;
+    int count() const;
+    void clear();
+
+private:
+    struct Node {
+        int left = -1;
+        int right = -1;
+        int parent = -1;
+        int size = 1;
+        uint32_t priority = 0;
+    };
+
+    int sizeOf(int node) const;
+    void update(int node);
+    int newNode();
+    int build(const int *ids, int count);
+    void split(int node, int count, int &first, int &rest);
+    int merge(int first, int rest);
+
+    std::vector<Node> nodes;
+    std::vector<int> unused;
+    int root = -1;
+    uint32_t seed = 0x9e3779b9;
+};
+
+#endif // ORDERINDEX_H
@@ -1,13 +1,52 @@
 #include <QFileInfo>
 #include <QMutableListIterator>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
 #include <cmath>
+#include <vector>
 #include "playlist.h"
 
-Item::Item(QUrl url)
+// How many earlier search results to keep around per playlist.
+constexpr int maxCachedFilters = 8;
+// Searches smaller than this many items aren't worth farming out.
+constexpr int minSearchChunk = 4096;
+// Playlists at least this big get a search index built in the background.
+constexpr int minIndexedCount = 50000;
+// Items are fed to the index builder in batches of this size, so that
+// searches and edits don't wait on the whole build.
+constexpr int indexBatchSize = 4096;
+constexpr quint32 searchIndexMagic = 0x6d706369;   // "mpci"
+constexpr quint32 searchIndexVersion = 2;
+
+// Search text is compared case-folded and with diacritics removed, so that
+// typing "cafe" also finds the accented spelling.
+static QString foldForSearch(const QString &text)
+{
+    QString decomposed = text.normalized(QString::NormalizationForm_KD);
+    QString folded;
+    folded.reserve(decomposed.size());
+    for (const QChar &c : decomposed) {
+        QChar::Category category = c.category();
+        if (category == QChar::Mark_NonSpacing
+                || category == QChar::Mark_SpacingCombining
+                || category == QChar::Mark_Enclosing)
+            continue;
+        folded.append(c);
+    }
+    return folded.toCaseFolded();
+}
+
+Item::Item(QUrl url) : Item(QUuid::createUuid(), url)
+{
+
+}
+
+Item::Item(const QUuid &uuid, const QUrl &url)
 {
     static int globalCounter = 0;
     setUrl(url);
-    setUuid(QUuid::createUuid());
+    setUuid(uuid);
     setOriginalPosition(globalCounter++);   // Preserve order on first restore
     setQueuePosition(0);
     setExtraPlayTimes(0);
@@ -36,22 +75,50 @@ void Item::setPlaylistUuid(const QUuid &uuid)
 
 QUrl Item::url() const
 {
+    QMutexLocker locker(&lock);
     return url_;
 }
 
 void Item::setUrl(const QUrl &url)
 {
+    QMutexLocker locker(&lock);
     url_ = url;
+    searchKeyValid_ = false;
 }
 
 QVariantMap Item::metadata() const
 {
+    QMutexLocker locker(&lock);
+    unpackMetadata_();
     return metadata_;
 }
 
 void Item::setMetadata(const QVariantMap &qvm)
 {
+    QMutexLocker locker(&lock);
     metadata_ = qvm;
+    packedMetadata_.clear();
+    searchKeyValid_ = false;
+}
+
+QByteArray Item::packedMetadata() const
+{
+    QMutexLocker locker(&lock);
+    if (!packedMetadata_.isEmpty() || metadata_.isEmpty())
+        return packedMetadata_;
+    QByteArray packed;
+    QDataStream out(&packed, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << metadata_;
+    return packed;
+}
+
+void Item::setPackedMetadata(const QByteArray &packed)
+{
+    QMutexLocker locker(&lock);
+    metadata_.clear();
+    packedMetadata_ = packed;
+    searchKeyValid_ = false;
 }
 
 int Item::originalPosition()
@@ -117,13 +184,37 @@ bool Item::hidden()
 
 QString Item::toDisplayString() const
 {
-    if (url().isLocalFile())
-        return QFileInfo(url().toLocalFile()).completeBaseName();
-    return url().toDisplayString(QUrl::FullyDecoded);
+    return displayString(url());
+}
+
+QString Item::searchKey() const
+{
+    QMutexLocker locker(&lock);
+    if (!searchKeyValid_) {
+        // Fields are joined by a newline, which a needle never contains, so
+        // matches cannot straddle two fields.
+        QString key = displayString(url_);
+        unpackMetadata_();
+        for (const QVariant &v : metadata_) {
+            key.append(QLatin1Char('\n'));
+            key.append(v.toString());
+        }
+        searchKey_ = foldForSearch(key);
+        searchKeyValid_ = true;
+    }
+    return searchKey_;
+}
+
+QString Item::displayString(const QUrl &url)
+{
+    if (url.isLocalFile())
+        return QFileInfo(url.toLocalFile()).completeBaseName();
+    return url.toDisplayString(QUrl::FullyDecoded);
 }
 
 QString Item::toString() const
 {
+    QMutexLocker locker(&lock);
     return url_.isLocalFile() ? url_.toLocalFile() : url_.url();
 }
 
@@ -144,9 +235,23 @@ QVariantMap Item::toVMap() const
 
 void Item::fromVMap(const QVariantMap &qvm)
 {
+    QMutexLocker locker(&lock);
+    searchKeyValid_ = false;
     url_ = qvm.contains("url") ? qvm.value("url").toUrl() : QUrl();
     uuid_ = qvm.contains("uuid") ? qvm.value("uuid").toUuid() : QUuid::createUuid();
     metadata_ = qvm.contains("metadata") ? qvm.value("metadata").toMap() : QVariantMap();
+    packedMetadata_.clear();
+}
+
+void Item::unpackMetadata_() const
+{
+    // The caller holds the lock.
+    if (packedMetadata_.isEmpty())
+        return;
+    QDataStream in(packedMetadata_);
+    in.setVersion(QDataStream::Qt_5_0);
+    in >> metadata_;
+    packedMetadata_.clear();
 }
 
 QSharedPointer<ItemCollection> ItemCollection::collection;
@@ -183,6 +288,19 @@ QSharedPointer<Item> ItemCollection::addItem(const QUuid &itemUuid, const QUrl &
     return item;
 }
 
+QList<QSharedPointer<Item>> ItemCollection::addItems(const QList<QUrl> &urls)
+{
+    QList<QSharedPointer<Item>> added;
+    added.reserve(urls.count());
+    items.reserve(items.count() + urls.count());
+    for (const QUrl &url : urls) {
+        auto item = QSharedPointer<Item>::create(url);
+        items.insert(item->uuid(), item);
+        added.append(item);
+    }
+    return added;
+}
+
 QSharedPointer<Item> ItemCollection::itemOf(const QUuid &itemUuid)
 {
     return items.value(itemUuid, QSharedPointer<Item>());
@@ -215,22 +333,32 @@ Playlist::~Playlist()
 QSharedPointer<Item> Playlist::addItem(const QUrl &url)
 {
     QWriteLocker locker(&listLock);
+    ++generation_;
     QSharedPointer<Item> i(ItemCollection::getSingleton()->addItem(url));
     i->setPlaylistUuid(uuid_);
     items.append(i);
     itemsByUuid.insert(i->uuid(), i);
+    if (searchIndex_)
+        searchIndex_->addItem(i);
+    if (PlaylistJournal *j = journal())
+        j->insertItems(uuid_, QUuid(), { i });
     return i;
 }
 
 QSharedPointer<Item> Playlist::addItem(const QUuid &uuid, const QUrl &url)
 {
     QWriteLocker locker(&listLock);
+    ++generation_;
     QSharedPointer<Item> i(ItemCollection::getSingleton()->addItem(uuid, url));
     i->setPlaylistUuid(uuid_);
     i->setUrl(url);
     i->setUuid(uuid);
     items.append(i);
     itemsByUuid.insert(uuid, i);
+    if (searchIndex_)
+        searchIndex_->addItem(i);
+    if (PlaylistJournal *j = journal())
+        j->insertItems(uuid_, QUuid(), { i });
     return i;
 }
 
@@ -238,15 +366,39 @@ QSharedPointer<Item> Playlist::addItemClone(const QSharedPointer<Item> &item)
 {
     QSharedPointer<Item> i = addItem(item->url());
     i->setPlaylistUuid(uuid_);
-    i->setMetadata(item->metadata());
+    setItemMetadata(i->uuid(), item->metadata());
     return i;
 }
 
 void Playlist::addItemRaw(const QSharedPointer<Item> &item)
 {
     QWriteLocker locker(&listLock);
+    ++generation_;
     items.append(item);
     itemsByUuid.insert(item->uuid(), item);
+    if (searchIndex_)
+        searchIndex_->addItem(item);
+    if (PlaylistJournal *j = journal())
+        j->insertItems(uuid_, QUuid(), { item });
+}
+
+QList<QSharedPointer<Item>> Playlist::addUrls(const QList<QUrl> &urls,
+                                              const QList<QVariantMap> &metadata)
+{
+    // metadata, if given, pairs up with urls.
+    QList<QSharedPointer<Item>> added =
+            ItemCollection::getSingleton()->addItems(urls);
+    for (int i = 0; i < added.count(); i++) {
+        added[i]->setPlaylistUuid(uuid_);
+        if (i < metadata.count() && !metadata.at(i).isEmpty())
+            added[i]->setMetadata(metadata.at(i));
+    }
+
+    QWriteLocker locker(&listLock);
+    items.reserve(items.count() + added.count());
+    itemsByUuid.reserve(itemsByUuid.count() + added.count());
+    insertItems_(items.count(), added);
+    return added;
 }
 
 QSharedPointer<Item> Playlist::itemAt(int index)
@@ -266,9 +418,7 @@ QSharedPointer<Item> Playlist::itemOf(const QUuid &uuid)
 QSharedPointer<Item> Playlist::itemAfter(const QUuid &uuid)
 {
     QReadLocker locker(&listLock);
-    if (!itemsByUuid.contains(uuid))
-        return QSharedPointer<Item>();
-    int index = items.indexOf(itemsByUuid[uuid]);
+    int index = indexOf_(uuid);
     if (index < 0 || index + 1 >= items.length())
         return QSharedPointer<Item>();
     return items[index + 1];
@@ -277,9 +427,7 @@ QSharedPointer<Item> Playlist::itemAfter(const QUuid &uuid)
 QSharedPointer<Item> Playlist::itemBefore(const QUuid &uuid)
 {
     QReadLocker locker(&listLock);
-    if (!itemsByUuid.contains(uuid))
-        return QSharedPointer<Item>();
-    int index = items.indexOf(itemsByUuid[uuid]);
+    int index = indexOf_(uuid);
     if (index <= 0)
         return QSharedPointer<Item>();
     return items[index - 1];
@@ -319,6 +467,41 @@ bool Playlist::contains(const QUuid &uuid)
     return itemsByUuid.contains(uuid);
 }
 
+quint64 Playlist::generation()
+{
+    QReadLocker locker(&listLock);
+    return generation_;
+}
+
+int Playlist::indexOf(const QUuid &uuid)
+{
+    QReadLocker lock(&listLock);
+    return indexOf_(uuid);
+}
+
+QVector<QSharedPointer<Item>> Playlist::inListOrder(const QVector<QSharedPointer<Item>> &found)
+{
+    // Drops anything that is no longer in the list, too.
+    QReadLocker locker(&listLock);
+    QVector<QPair<int, QSharedPointer<Item>>> positioned;
+    positioned.reserve(found.count());
+    for (const QSharedPointer<Item> &item : found) {
+        int index = indexOf_(item->uuid());
+        if (index >= 0 && items.at(index) == item)
+            positioned.append({ index, item });
+    }
+    std::sort(positioned.begin(), positioned.end(),
+              [](const QPair<int, QSharedPointer<Item>> &a,
+                 const QPair<int, QSharedPointer<Item>> &b) {
+        return a.first < b.first;
+    });
+    QVector<QSharedPointer<Item>> ordered;
+    ordered.reserve(positioned.count());
+    for (const QPair<int, QSharedPointer<Item>> &p : positioned)
+        ordered.append(p.second);
+    return ordered;
+}
+
 void Playlist::iterateItems(const std::function<void(QSharedPointer<Item>)> &callback)
 {
     QReadLocker locker(&listLock);
@@ -330,23 +513,35 @@ void Playlist::addItems(const QUuid &where,
                         const QList<QSharedPointer<Item>> &itemsToAdd)
 {
     QWriteLocker locker(&listLock);
+    addItems_(where, itemsToAdd);
+}
 
-    int indexWhere = items.indexOf(itemsByUuid[where]);
+void Playlist::addItems_(const QUuid &where,
+                         const QList<QSharedPointer<Item>> &itemsToAdd)
+{
+    int indexWhere = indexOf_(where);
     if (indexWhere < 0)
         indexWhere = items.size();
-    for (int i = 0; i < itemsToAdd.count(); ++i) {
-        QSharedPointer<Item> item = itemsToAdd.at(i);
+    for (const QSharedPointer<Item> &item : itemsToAdd)
         item->setPlaylistUuid(uuid_);
-        items.insert(indexWhere + i, item);
-        itemsByUuid.insert(item->uuid(), item);
-    }
+    insertItems_(indexWhere, itemsToAdd);
 }
 
 void Playlist::removeItem(const QUuid &uuid)
 {
     QWriteLocker locker(&listLock);
+    ++generation_;
     PlaylistCollection::getSingleton()->queuePlaylist()->removeItem(uuid);
-    items.removeAll(itemsByUuid.take(uuid));
+    int index = indexOf_(uuid);
+    if (index >= 0) {
+        unindexItem_(uuid);
+        items.removeAt(index);
+    }
+    itemsByUuid.remove(uuid);
+    if (searchIndex_)
+        searchIndex_->removeItem(uuid);
+    if (PlaylistJournal *j = journal())
+        j->removeItems(uuid_, { uuid });
     ItemCollection::getSingleton()->removeItem(uuid);
 }
 
@@ -355,39 +550,161 @@ void Playlist::takeItemsRaw(const QList<QSharedPointer<Item>> &itemsToRemove)
     // "takeItemsRaw", because we don't check if it's in a queue or whatever,
     // it's just taken raw, potentially damaging everything.  Only use if you
     // may know what you're doing.
+    QWriteLocker locker(&listLock);
+    takeItems_(itemsToRemove);
+}
+
+void Playlist::takeItems_(const QList<QSharedPointer<Item>> &itemsToRemove)
+{
+    ++generation_;
+    QSet<QUuid> removalSet;
+    QList<QUuid> removed;
     for (const QSharedPointer<Item> &item: itemsToRemove) {
+        removalSet.insert(item->uuid());
+        removed.append(item->uuid());
         itemsByUuid.remove(item->uuid());
-        items.removeAll(item);
     }
+    if (PlaylistJournal *j = journal())
+        j->removeItems(uuid_, removed);
+
+    // One pass over the list rather than a removeAll per item, so sorting
+    // a large playlist doesn't go quadratic.
+    QMutableListIterator<QSharedPointer<Item>> i(items);
+    while (i.hasNext()) {
+        QUuid uuid = i.next()->uuid();
+        if (removalSet.contains(uuid)) {
+            unindexItem_(uuid);
+            i.remove();
+        }
+    }
+}
+
+void Playlist::moveItems(const QList<QSharedPointer<Item>> &itemsToMove,
+                         const QUuid &where)
+{
+    // Logged as a single move, rather than as the removal and insertion of
+    // every item it is made of.
+    QWriteLocker locker(&listLock);
+    if (PlaylistJournal *j = journal()) {
+        QList<QUuid> moved;
+        for (const QSharedPointer<Item> &item : itemsToMove)
+            moved.append(item->uuid());
+        j->moveItems(uuid_, where, moved);
+    }
+    bool wasJournaled = journaled_;
+    journaled_ = false;
+    takeItems_(itemsToMove);
+    addItems_(where, itemsToMove);
+    journaled_ = wasJournaled;
+}
+
+QSharedPointer<Playlist> Playlist::snapshot()
+{
+    // The item list is implicitly shared, so copying it costs nothing until
+    // either side changes.  The copy is for reading only.
+    QReadLocker locker(&listLock);
+    QSharedPointer<Playlist> copy(new Playlist(title_));
+    copy->uuid_ = uuid_;
+    copy->shuffle_ = shuffle_;
+    copy->items = items;
+    copy->journaled_ = false;
+    return copy;
+}
+
+void Playlist::setItemMetadata(const QUuid &uuid, const QVariantMap &metadata)
+{
+    QSharedPointer<Item> item = itemOf(uuid);
+    if (item.isNull())
+        return;
+    item->setMetadata(metadata);
+    // The item may match filters it didn't before, so earlier results can't
+    // be refined any more.
+    QWriteLocker locker(&listLock);
+    ++generation_;
+    if (searchIndex_ && itemsByUuid.contains(uuid))
+        searchIndex_->updateItem(item);
+    if (PlaylistJournal *j = journal())
+        j->updateItem(uuid_, item);
+}
+
+void Playlist::setProbedMetadata(const QHash<QUuid, QVariantMap> &metadata)
+{
+    QList<QSharedPointer<Item>> changed;
+    QWriteLocker locker(&listLock);
+    if (retaggedGeneration != generation_) {
+        retagged.clear();
+        retaggedGeneration = generation_;
+    }
+    for (auto it = metadata.constBegin(); it != metadata.constEnd(); ++it) {
+        QSharedPointer<Item> item = itemsByUuid.value(it.key());
+        if (item.isNull())
+            continue;
+        item->setMetadata(it.value());
+        retagged.append(item);
+        changed.append(item);
+    }
+    if (searchIndex_)
+        searchIndex_->updateItems(changed);
+    if (PlaylistJournal *j = journal())
+        j->updateItems(uuid_, changed);
+}
+
+int Playlist::retaggedCount()
+{
+    QReadLocker locker(&listLock);
+    return retaggedGeneration == generation_ ? retagged.count() : 0;
+}
+
+QVector<QSharedPointer<Item>> Playlist::retaggedSince(int from)
+{
+    QReadLocker locker(&listLock);
+    QVector<QSharedPointer<Item>> since;
+    if (retaggedGeneration != generation_)
+        return since;
+    for (int i = from; i < retagged.count(); i++)
+        if (QSharedPointer<Item> item = retagged.at(i).toStrongRef())
+            since.append(item);
+    return since;
 }
 
 QList<QUuid> Playlist::replaceItem(const QUuid &where, const QList<QUrl> &urls)
 {
     QWriteLocker lock(&listLock);
+    ++generation_;
     if (!itemsByUuid.contains(where))
         return QList<QUuid>();
 
     itemsByUuid[where]->setUrl(urls[0]);
+    if (searchIndex_)
+        searchIndex_->updateItem(itemsByUuid[where]);
+    if (PlaylistJournal *j = journal())
+        j->updateItem(uuid_, itemsByUuid[where]);
 
     QList<QUuid> addedItems;
+    QList<QSharedPointer<Item>> newItems;
     // essentially insertAfter(where, urls[1..end]);
-    int insertIndex = items.indexOf(itemsByUuid[where]);
     for (int urlIndex = 1; urlIndex < urls.count(); urlIndex++) {
         QSharedPointer<Item> i(new Item(urls[urlIndex]));
         i->setPlaylistUuid(uuid_);
-        items.insert(insertIndex + urlIndex, i);
-        itemsByUuid.insert(i->uuid(), i);
+        newItems.append(i);
         addedItems.append(i->uuid());
     }
+    insertItems_(indexOf_(where) + 1, newItems);
     return addedItems;
 }
 
 void Playlist::clear()
 {
     QWriteLocker locker(&listLock);
+    ++generation_;
     PlaylistCollection::getSingleton()->queuePlaylist()->removeItems(itemsByUuid.keys());
     items.clear();
     itemsByUuid.clear();
+    clearIndex();
+    if (searchIndex_)
+        searchIndex_->clear();
+    if (PlaylistJournal *j = journal())
+        j->clearPlaylist(uuid_);
 }
 
 QString Playlist::title()
@@ -436,8 +753,11 @@ QStringList Playlist::toStringList()
 void Playlist::fromStringList(QStringList sl)
 {
     QWriteLocker locker(&listLock);
+    ++generation_;
     items.clear();
     itemsByUuid.clear();
+    clearIndex();
+    searchIndex_.reset();
     for (QString &s : sl) {
         QSharedPointer<Item> item(new Item());
         item->setPlaylistUuid(uuid_);
@@ -445,6 +765,10 @@ void Playlist::fromStringList(QStringList sl)
         items.append(item);
         itemsByUuid.insert(item->uuid(), item);
     }
+    if (PlaylistJournal *j = journal()) {
+        j->clearPlaylist(uuid_);
+        j->insertItems(uuid_, QUuid(), items);
+    }
 }
 
 QVariantMap Playlist::toVMap()
@@ -465,7 +789,8 @@ QVariantMap Playlist::toVMap()
 
 void Playlist::fromVMap(const QVariantMap &qvm)
 {
-    QReadLocker locker(&listLock);
+    QWriteLocker locker(&listLock);
+    ++generation_;
     title_ = qvm.contains("title") ? qvm["title"].toString() : QString();
     shuffle_ = qvm.contains("shuffle") ? qvm["shuffle"].toBool() : false;
     uuid_ = qvm.contains("uuid") ? qvm["uuid"].toUuid() : QUuid::createUuid();
@@ -480,6 +805,146 @@ void Playlist::fromVMap(const QVariantMap &qvm)
             ItemCollection::getSingleton()->storeItem(i);
         }
     }
+    if (PlaylistJournal *j = journal()) {
+        j->clearPlaylist(uuid_);
+        j->insertItems(uuid_, QUuid(), items);
+    }
+}
+
+QSharedPointer<PlaylistIndex> Playlist::searchIndex()
+{
+    QReadLocker locker(&listLock);
+    return searchIndex_;
+}
+
+void Playlist::buildSearchIndex()
+{
+    QWriteLocker locker(&listLock);
+    if (searchIndex_)
+        return;
+    searchIndex_.reset(new PlaylistIndex);
+    QSharedPointer<PlaylistIndex> index = searchIndex_;
+    QList<QSharedPointer<Item>> snapshot = items;
+    QtConcurrent::run([index, snapshot]() {
+        for (int i = 0; i < snapshot.count(); i += indexBatchSize)
+            index->addItems(snapshot.mid(i, indexBatchSize));
+        index->setReady(true);
+    });
+}
+
+void Playlist::reindexItem(const QUuid &uuid)
+{
+    QReadLocker locker(&listLock);
+    if (searchIndex_ && itemsByUuid.contains(uuid))
+        searchIndex_->updateItem(itemsByUuid.value(uuid));
+}
+
+void Playlist::saveSearchIndex(QDataStream &out)
+{
+    QReadLocker locker(&listLock);
+    if (searchIndex_)
+        searchIndex_->save(out, items);
+    else
+        PlaylistIndex().save(out, items);
+}
+
+bool Playlist::loadSearchIndex(QDataStream &in)
+{
+    QWriteLocker locker(&listLock);
+    QSharedPointer<PlaylistIndex> index(new PlaylistIndex);
+    if (!index->load(in, items))
+        return false;
+    searchIndex_ = index;
+    return true;
+}
+
+int Playlist::indexOf_(const QUuid &uuid)
+{
+    // The caller holds listLock, but possibly only for reading, so several
+    // threads may want to index the tail at once.
+    QMutexLocker locker(&indexLock);
+    if (!itemsByUuid.contains(uuid))
+        return -1;
+    int id = indexByUuid.value(uuid, -1);
+    if (id < 0) {
+        indexTail_();
+        id = indexByUuid.value(uuid, -1);
+        if (id < 0)
+            return -1;
+    }
+    return positions.position(id);
+}
+
+void Playlist::indexTail_()
+{
+    int count = items.count();
+    if (indexedCount >= count)
+        return;
+    std::vector<int> ids(count - indexedCount);
+    positions.insert(indexedCount, int(ids.size()), ids.data());
+    for (int i = indexedCount; i < count; i++)
+        indexByUuid.insert(items.at(i)->uuid(), ids[i - indexedCount]);
+    indexedCount = count;
+}
+
+void Playlist::insertItems_(int index, const QList<QSharedPointer<Item>> &newItems)
+{
+    if (newItems.isEmpty())
+        return;
+    ++generation_;
+    for (const QSharedPointer<Item> &item : newItems)
+        itemsByUuid.insert(item->uuid(), item);
+    if (searchIndex_)
+        searchIndex_->addItems(newItems);
+    if (PlaylistJournal *j = journal())
+        j->insertItems(uuid_, index < items.count() ? items.at(index)->uuid()
+                                                   : QUuid(), newItems);
+    if (index >= items.count()) {
+        items.append(newItems);
+        return;
+    }
+
+    // The new items take their places among the indexed ones, so those have
+    // to reach as far as where they go.
+    if (index > indexedCount)
+        indexTail_();
+    std::vector<int> ids(newItems.count());
+    positions.insert(index, int(ids.size()), ids.data());
+    for (int i = 0; i < newItems.count(); i++)
+        indexByUuid.insert(newItems.at(i)->uuid(), ids[i]);
+    indexedCount += newItems.count();
+
+    // Appended, then rotated into place, which moves only what comes after.
+    int oldCount = items.count();
+    items.reserve(oldCount + newItems.count());
+    items.append(newItems);
+    std::rotate(items.begin() + index, items.begin() + oldCount, items.end());
+}
+
+void Playlist::unindexItem_(const QUuid &uuid)
+{
+    // Only the indexed items have a place in positions.
+    auto it = indexByUuid.find(uuid);
+    if (it == indexByUuid.end())
+        return;
+    positions.remove(it.value());
+    indexByUuid.erase(it);
+    indexedCount--;
+}
+
+void Playlist::clearIndex()
+{
+    positions.clear();
+    indexByUuid.clear();
+    indexedCount = 0;
+}
+
+PlaylistJournal *Playlist::journal()
+{
+    if (!journaled_)
+        return nullptr;
+    PlaylistJournal *j = PlaylistCollection::getSingleton()->journal();
+    return j->isRecording() ? j : nullptr;
 }
 
 
@@ -487,7 +952,7 @@ void Playlist::fromVMap(const QVariantMap &qvm)
 QueuePlaylist::QueuePlaylist(const QString &title)
     : Playlist(title)
 {
-
+    journaled_ = false;
 }
 
 QPair<QUuid,QUuid> QueuePlaylist::first()
@@ -503,7 +968,9 @@ QPair<QUuid,QUuid> QueuePlaylist::takeFirst()
     QWriteLocker lock(&listLock);
     if (items.isEmpty())
         return { QUuid(), QUuid() };
-    QSharedPointer<Item> item = items.takeFirst();
+    QSharedPointer<Item> item = items.first();
+    unindexItem_(item->uuid());
+    items.removeFirst();
     itemsByUuid.remove(item->uuid());
     item->setQueuePosition(0);
     int i = 1;
@@ -559,20 +1026,14 @@ void QueuePlaylist::appendItems(const QUuid &playlistUuid, const QList<QUuid> &i
         toggle_(playlistUuid, item, true);
 }
 
-void QueuePlaylist::addItems(const QUuid &where, const QList<QSharedPointer<Item> > &itemsToAdd)
+void QueuePlaylist::addItems_(const QUuid &where, const QList<QSharedPointer<Item> > &itemsToAdd)
 {
-    QWriteLocker lock(&listLock);
-    int index = items.indexOf(itemsByUuid[where]);
+    int index = indexOf_(where);
     if (index < 0)
         index = 0;
 
-    int count = itemsToAdd.count();
-    for (int i = 0; i < count; i++) {
-        QSharedPointer<Item> item = itemsToAdd[i];
-        items.insert(index + i, item);
-        itemsByUuid.insert(item->uuid(), item);
-    }
-    count = items.count();
+    insertItems_(index, itemsToAdd);
+    int count = items.count();
     for (int i = index; i < count; i++)
         items[i]->setQueuePosition(i+1);
 }
@@ -596,6 +1057,7 @@ void QueuePlaylist::clear()
         item->setQueuePosition(0);
     items.clear();
     itemsByUuid.clear();
+    clearIndex();
 }
 
 int QueuePlaylist::contains(const QList<QUuid> &itemsToCheck)
@@ -639,8 +1101,9 @@ void QueuePlaylist::removeItem_(const QUuid &uuid)
     if (!itemsByUuid.contains(uuid))
         return;
     QSharedPointer<Item> item = itemsByUuid[uuid];
-    int index = items.indexOf(item);
-    items.removeOne(item);
+    int index = indexOf_(uuid);
+    unindexItem_(uuid);
+    items.removeAt(index);
     itemsByUuid.remove(uuid);
     item->setQueuePosition(0);
     int count = items.count();
@@ -658,6 +1121,7 @@ QList<int> QueuePlaylist::removeItems_(const QList<QUuid> &itemsToRemove)
         QSharedPointer<Item> item = i.next();
         if (removalSet.contains(item->uuid())) {
             itemsByUuid.remove(item->uuid());
+            unindexItem_(item->uuid());
             item->setQueuePosition(0);
             i.remove();
             removedIndices.append(index);
@@ -741,6 +1205,11 @@ QSharedPointer<QueuePlaylist> PlaylistCollection::queuePlaylist() const
     return queuePlaylist_;
 }
 
+PlaylistJournal *PlaylistCollection::journal()
+{
+    return &journal_;
+}
+
 void PlaylistCollection::addPlaylist(const QSharedPointer<Playlist> &playlist)
 {
     if (!playlist)
@@ -754,6 +1223,50 @@ void PlaylistCollection::addPlaylist(const QSharedPointer<Playlist> &playlist)
     playlistsByUuid.insert(playlist->uuid(), playlist);
 }
 
+QByteArray PlaylistCollection::searchIndexesToData() const
+{
+    QList<QSharedPointer<Playlist>> indexed;
+    for (const QSharedPointer<Playlist> &p : playlists) {
+        auto index = p->searchIndex();
+        if (index && index->isReady())
+            indexed.append(p);
+    }
+    if (indexed.isEmpty())
+        return QByteArray();
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << searchIndexMagic << searchIndexVersion << quint32(indexed.count());
+    for (const QSharedPointer<Playlist> &p : indexed) {
+        out << p->uuid();
+        p->saveSearchIndex(out);
+    }
+    return data;
+}
+
+void PlaylistCollection::searchIndexesFromData(const QByteArray &data)
+{
+    if (data.isEmpty())
+        return;
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version, count;
+    in >> magic >> version >> count;
+    if (magic != searchIndexMagic || version != searchIndexVersion)
+        return;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        QUuid uuid;
+        in >> uuid;
+        auto p = playlistOf(uuid);
+        // A stale or unknown index still has to be read past.
+        if (p)
+            p->loadSearchIndex(in);
+        else
+            PlaylistIndex().load(in, QList<QSharedPointer<Item>>());
+    }
+}
+
 QSharedPointer<Playlist> PlaylistCollection::doNewPlaylist(const QString &title,
                                                            const QUuid &uuid)
 {
@@ -764,43 +1277,37 @@ QSharedPointer<Playlist> PlaylistCollection::doNewPlaylist(const QString &title,
     return p;
 }
 
-void PlaylistSearcher::bump()
+void PlaylistSearcher::bump(const QUuid &playlist)
 {
     QWriteLocker locker(&bumpLock);
-    ++bumps_;
+    ++bumps_[playlist];
 }
 
-void PlaylistSearcher::unbump()
+void PlaylistSearcher::unbump(const QUuid &playlist)
 {
     QWriteLocker locker(&bumpLock);
-    --bumps_;
+    if (--bumps_[playlist] <= 0)
+        bumps_.remove(playlist);
 }
 
-int PlaylistSearcher::bumps()
+int PlaylistSearcher::bumps(const QUuid &playlist)
 {
     QReadLocker locker(&bumpLock);
-    return bumps_;
+    return bumps_.value(playlist, 0);
 }
 
 bool PlaylistSearcher::itemMatchesFilter(const QSharedPointer<Item> &item,
                                          const QStringList &needles)
 {
-    QSet<QString> found;
-    findNeedles(item->toDisplayString(), needles, found);
-    if (found.count() == needles.count())
-        return true;
-
-    // OPTIMIZE: don't run the metadata through toLower every search
-    for (const QVariant &v : item->metadata())
-        findNeedles(v.toString(), needles, found);
-    return found.count() == needles.count();
+    return hasNeedles(item->searchKey(), needles);
 }
 
 void PlaylistSearcher::filterPlaylist(QSharedPointer<Playlist> list, QString text)
 {
-    // Limit response - only reply if last in event queue
-    bool bumpLimited = bumps() > 1;
-    unbump();
+    // Limit response - only reply if last in event queue for this playlist
+    QUuid listUuid = list.isNull() ? QUuid() : list->uuid();
+    bool bumpLimited = bumps(listUuid) > 1;
+    unbump(listUuid);
     if (bumpLimited)
         return;
 
@@ -813,11 +1320,89 @@ void PlaylistSearcher::filterPlaylist(QSharedPointer<Playlist> list, QString tex
     if (list.isNull())
         return;
 
-    auto marker = [&needles](QSharedPointer<Item> item) {
-        item->setHidden(!itemMatchesFilter(item, needles));
-    };
-    list->iterateItems(marker);
-    emit playlistFiltered(list->uuid());
+    FilterCache &cache = caches[list->uuid()];
+    quint64 generation = list->generation();
+    bool stale = cache.generation != generation;
+    if (stale) {
+        cache.generation = generation;
+        cache.results.clear();
+    }
+
+    // Any earlier result whose needles are all contained in the new ones
+    // holds every item that can still match, so refine the smallest of them
+    // instead of scanning the whole playlist.
+    const FilterResult *base = nullptr;
+    for (const FilterResult &r : cache.results) {
+        if (needlesNarrow(needles, r.needles)
+                && (!base || r.matches.count() < base->matches.count()))
+            base = &r;
+    }
+
+    FilterResult result;
+    result.needles = needles;
+    result.retagged = list->retaggedCount();
+    QSharedPointer<PlaylistIndex> index = list->searchIndex();
+    if (base) {
+        // Items probed since the base was made may match now when they
+        // didn't then, so they are checked along with it.
+        QVector<QSharedPointer<Item>> candidates = base->matches;
+        QVector<QSharedPointer<Item>> retagged = list->retaggedSince(base->retagged);
+        if (!retagged.isEmpty()) {
+            QSet<Item*> known;
+            for (const QSharedPointer<Item> &item : candidates)
+                known.insert(item.data());
+            for (const QSharedPointer<Item> &item : retagged) {
+                if (known.contains(item.data()))
+                    continue;
+                known.insert(item.data());
+                candidates.append(item);
+            }
+            candidates = list->inListOrder(candidates);
+        }
+        result.matches = matchItems(candidates, needles);
+    } else if (index && index->isReady() && PlaylistIndex::canFind(needles)) {
+        // The index only narrows things down; the candidates are checked
+        // properly in case an item changed since it was indexed.
+        result.matches = matchItems(list->inListOrder(index->find(needles)),
+                                    needles);
+    } else {
+        if (!index && list->count() >= minIndexedCount)
+            list->buildSearchIndex();
+        QVector<QSharedPointer<Item>> candidates;
+        candidates.reserve(list->count());
+        auto collector = [&candidates](QSharedPointer<Item> item) {
+            candidates.append(item);
+        };
+        list->iterateItems(collector);
+        result.matches = matchItems(candidates, needles);
+    }
+
+    // Only touch the hidden flags of items whose visibility can have changed.
+    if (stale || !cache.filtered) {
+        auto hider = [](QSharedPointer<Item> item) {
+            item->setHidden(true);
+        };
+        list->iterateItems(hider);
+    } else {
+        for (const QSharedPointer<Item> &item : cache.shown)
+            item->setHidden(true);
+    }
+    for (const QSharedPointer<Item> &item : result.matches)
+        item->setHidden(false);
+    cache.shown = result.matches;
+    cache.filtered = true;
+
+    for (int i = 0; i < cache.results.count(); i++) {
+        if (cache.results[i].needles == needles) {
+            cache.results.removeAt(i);
+            break;
+        }
+    }
+    cache.results.append(result);
+    if (cache.results.count() > maxCachedFilters)
+        cache.results.removeFirst();
+
+    emit playlistFiltered(list->uuid(), result.matches, true, generation);
 }
 
 void PlaylistSearcher::clearPlaylistFilter(QSharedPointer<Playlist> &list)
@@ -829,21 +1414,84 @@ void PlaylistSearcher::clearPlaylistFilter(QSharedPointer<Playlist> &list)
         item->setHidden(false);
     };
     list->iterateItems(clearer);
-    emit playlistFiltered(list->uuid());
+    if (caches.contains(list->uuid())) {
+        FilterCache &cache = caches[list->uuid()];
+        cache.shown.clear();
+        cache.filtered = false;
+    }
+    emit playlistFiltered(list->uuid(), QVector<QSharedPointer<Item>>(), false,
+                          list->generation());
+}
+
+void PlaylistSearcher::forgetPlaylist(QUuid playlist)
+{
+    caches.remove(playlist);
+}
+
+bool PlaylistSearcher::needlesNarrow(const QStringList &needles,
+                                     const QStringList &than)
+{
+    // True when everything matching needles also matches than, i.e. each of
+    // the old needles is a substring of at least one new needle.
+    for (const QString &old : than) {
+        bool covered = false;
+        for (const QString &needle : needles) {
+            if (needle.contains(old)) {
+                covered = true;
+                break;
+            }
+        }
+        if (!covered)
+            return false;
+    }
+    return true;
 }
 
 QStringList PlaylistSearcher::textToNeedles(QString text)
 {
-    return text.toLower().split(QString(" "), QString::SkipEmptyParts);
+    return foldForSearch(text).split(QString(" "), QString::SkipEmptyParts);
+}
+
+bool PlaylistSearcher::hasNeedles(const QString &haystack,
+                                  const QStringList &needles)
+{
+    for (const QString &needle : needles)
+        if (!haystack.contains(needle))
+            return false;
+    return true;
 }
 
-void PlaylistSearcher::findNeedles(const QString &text,
-                                   const QStringList &needles,
-                                   QSet<QString> &found)
+QVector<QSharedPointer<Item>> PlaylistSearcher::matchItems(
+        const QVector<QSharedPointer<Item>> &candidates,
+        const QStringList &needles)
 {
-    QString haystack = text.toLower();
-    for (const QString &needle : needles) {
-        if (haystack.contains(needle))
-            found.insert(needle);
+    // Split the candidates into one chunk per pool thread and stitch the
+    // matches back together in order.  We are not a pool thread ourselves,
+    // so blocking on the results here cannot starve the pool.
+    int count = candidates.count();
+    int chunks = qBound(1, count / minSearchChunk,
+                        QThreadPool::globalInstance()->maxThreadCount());
+    int chunkSize = (count + chunks - 1) / chunks;
+
+    auto matcher = [&candidates, &needles](int start, int end) {
+        QVector<QSharedPointer<Item>> matches;
+        for (int i = start; i < end; i++)
+            if (itemMatchesFilter(candidates.at(i), needles))
+                matches.append(candidates.at(i));
+        return matches;
+    };
+    if (chunks == 1)
+        return matcher(0, count);
+
+    QList<QFuture<QVector<QSharedPointer<Item>>>> futures;
+    for (int start = 0; start < count; start += chunkSize) {
+        int end = std::min(count, start + chunkSize);
+        futures.append(QtConcurrent::run([matcher, start, end]() {
+            return matcher(start, end);
+        }));
     }
+    QVector<QSharedPointer<Item>> matches;
+    for (QFuture<QVector<QSharedPointer<Item>>> &future : futures)
+        matches += future.result();
+    return matches;
 }
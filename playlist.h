@@ -9,15 +9,22 @@
 #include <functional>
 #include <QSharedPointer>
 #include <QList>
+#include <QVector>
 #include <QSet>
 #include <QHash>
 #include <QStringList>
 #include <QVariantMap>
 #include <QReadWriteLock>
+#include <QMutex>
+#include <QDataStream>
+#include "orderindex.h"
+#include "playlistindex.h"
+#include "playlistjournal.h"
 
 class Item {
 public:
     Item(QUrl url = QUrl());
+    Item(const QUuid &uuid, const QUrl &url);
 
     QUuid uuid() const;
     void setUuid(const QUuid &uuid);
@@ -27,6 +34,10 @@ public:
     void setUrl(const QUrl &url);
     QVariantMap metadata() const;
     void setMetadata(const QVariantMap &qvm);
+    // Metadata as QDataStream'd by PlaylistStore.  Restored items keep it
+    // packed until it is first asked for.
+    QByteArray packedMetadata() const;
+    void setPackedMetadata(const QByteArray &packed);
 
     int originalPosition();
     void setOriginalPosition(int i);
@@ -45,6 +56,7 @@ public:
     bool hidden();
 
     QString toDisplayString() const;
+    QString searchKey() const;
     QString toString() const;
     void fromString(QString input);
 
@@ -52,14 +64,26 @@ public:
     void fromVMap(const QVariantMap &qvm);
 
 private:
+    void unpackMetadata_() const;
+    // Takes the url rather than reading url_, so that it can be used with
+    // the lock held or not.
+    static QString displayString(const QUrl &url);
+
     QUuid uuid_;
     QUuid playlistUuid_;
     QUrl url_;
-    QVariantMap metadata_;
+    mutable QVariantMap metadata_;
+    mutable QByteArray packedMetadata_;
     int originalPosition_;
     int queuePosition_ = 0;
     int extraPlayTimes_ = 0;
     bool hidden_ = false;
+    // Folded display string and metadata, built on first search.
+    mutable QString searchKey_;
+    mutable bool searchKeyValid_ = false;
+    // The searcher and the playlist saver read items from their own threads,
+    // hence the lock.  Nothing called with it held takes it again.
+    mutable QMutex lock;
 };
 
 class ItemCollection : public QObject {
@@ -74,6 +98,7 @@ public:
 
     QSharedPointer<Item> addItem(const QUrl url = QUrl());
     QSharedPointer<Item> addItem(const QUuid &itemUuid, const QUrl &url);
+    QList<QSharedPointer<Item>> addItems(const QList<QUrl> &urls);
     QSharedPointer<Item> itemOf(const QUuid &itemUuid);
     void removeItem(const QUuid &itemUuid);
     void storeItem(const QSharedPointer<Item> &item);
@@ -93,6 +118,8 @@ public:
     QSharedPointer<Item> addItem(const QUuid &uuid, const QUrl &url);
     QSharedPointer<Item> addItemClone(const QSharedPointer<Item> &item);
     void addItemRaw(const QSharedPointer<Item> &item);
+    QList<QSharedPointer<Item>> addUrls(const QList<QUrl> &urls,
+                                        const QList<QVariantMap> &metadata = QList<QVariantMap>());
 
     QSharedPointer<Item> itemAt(int index);
     QSharedPointer<Item> itemOf(const QUuid &uuid);
@@ -103,10 +130,24 @@ public:
     int count();
     bool isEmpty();
     bool contains(const QUuid &uuid);
+    int indexOf(const QUuid &uuid);
+    quint64 generation();
+    QVector<QSharedPointer<Item>> inListOrder(const QVector<QSharedPointer<Item>> &found);
     void iterateItems(const std::function<void(QSharedPointer<Item>)> &callback);
     virtual void addItems(const QUuid &where, const QList<QSharedPointer<Item> > &itemsToAdd);
     virtual void removeItem(const QUuid &uuid);
     void takeItemsRaw(const QList<QSharedPointer<Item>> &itemsToRemove);
+    void moveItems(const QList<QSharedPointer<Item>> &itemsToMove, const QUuid &where);
+    QSharedPointer<Playlist> snapshot();
+    void setItemMetadata(const QUuid &uuid, const QVariantMap &metadata);
+    // Sets metadata found without playing the items.  Neither the contents
+    // nor the order of the list change, so the generation stays put, and
+    // filters learn of the items through retaggedSince() instead.
+    void setProbedMetadata(const QHash<QUuid, QVariantMap> &metadata);
+    // How many items setProbedMetadata() has changed at this generation.
+    int retaggedCount();
+    // Those of them after the first from.
+    QVector<QSharedPointer<Item>> retaggedSince(int from);
     QList<QUuid> replaceItem(const QUuid &where, const QList<QUrl> &urls);
     virtual void clear();
 
@@ -123,9 +164,45 @@ public:
     QVariantMap toVMap();
     void fromVMap(const QVariantMap &qvm);
 
+    QSharedPointer<PlaylistIndex> searchIndex();
+    void buildSearchIndex();
+    void reindexItem(const QUuid &uuid);
+    void saveSearchIndex(QDataStream &out);
+    bool loadSearchIndex(QDataStream &in);
+
 protected:
+    int indexOf_(const QUuid &uuid);
+    // The bodies of addItems and takeItemsRaw, for callers that already hold
+    // the write lock.
+    virtual void addItems_(const QUuid &where, const QList<QSharedPointer<Item>> &itemsToAdd);
+    void takeItems_(const QList<QSharedPointer<Item>> &itemsToRemove);
+    void indexTail_();
+    void insertItems_(int index, const QList<QSharedPointer<Item>> &newItems);
+    void unindexItem_(const QUuid &uuid);
+    void clearIndex();
+    PlaylistJournal *journal();
+
     QList<QSharedPointer<Item>> items;
     QHash<QUuid, QSharedPointer<Item>> itemsByUuid;
+    // Where each of the first indexedCount items is, by its id in positions.
+    // Items appended after those are indexed when first looked up, so
+    // appending costs nothing up front.
+    OrderIndex positions;
+    QHash<QUuid, int> indexByUuid;
+    int indexedCount = 0;
+    QMutex indexLock;
+    // Bumped on every change to the contents or order of the list.
+    quint64 generation_ = 0;
+    // Items given probed metadata, in the order it came.  Only good for the
+    // generation it was started at, and started over after that.  Weak, so
+    // that items removed since aren't kept around until then.
+    QVector<QWeakPointer<Item>> retagged;
+    quint64 retaggedGeneration = 0;
+    // Only created for big playlists, see PlaylistSearcher.
+    QSharedPointer<PlaylistIndex> searchIndex_;
+    // Whether changes go to the collection's journal.  The queue isn't
+    // saved, so it never does.
+    bool journaled_ = true;
     //QList<QUuid> queue;
     QString title_;
     bool shuffle_ = false;
@@ -147,12 +224,14 @@ public:
     void toggle(const QUuid &playlistUuid, const QList<QUuid> &uuids, QList<QUuid> &added, QList<int> &removed);
     void toggleFromPlaylist(const QUuid &playlistUuid, QList<QUuid> &added, QList<int> &removedIndices);
     void appendItems(const QUuid &playlistUuid, const QList<QUuid> &itemsToAdd);
-    void addItems(const QUuid &where, const QList<QSharedPointer<Item> > &itemsToAdd);
     void removeItem(const QUuid &uuid);
     void removeItems(const QList<QUuid> &itemsToRemove);
     void clear();
     int contains(const QList<QUuid> &itemsToCheck);
 
+protected:
+    void addItems_(const QUuid &where, const QList<QSharedPointer<Item> > &itemsToAdd);
+
 private:
     int toggle_(const QUuid &playlistUuid, const QUuid &itemUuid, bool always = false);
     int contains_(const QList<QUuid> &itemsToCheck) const;
@@ -177,13 +256,18 @@ public:
     QSharedPointer<Playlist> playlistAt(int col) const;
     QSharedPointer<Playlist> playlistOf(const QUuid &uuid) const;
     QSharedPointer<QueuePlaylist> queuePlaylist() const;
+    PlaylistJournal *journal();
 
     void addPlaylist(const QSharedPointer<Playlist> &playlist);
 
+    QByteArray searchIndexesToData() const;
+    void searchIndexesFromData(const QByteArray &data);
+
 private:
     QList<QSharedPointer<Playlist>> playlists;
     QHash<QUuid, QSharedPointer<Playlist>> playlistsByUuid;
     QSharedPointer<QueuePlaylist> queuePlaylist_;
+    PlaylistJournal journal_;
 
     QSharedPointer<Playlist> doNewPlaylist(const QString &title,
                                            const QUuid &uuid);
@@ -194,27 +278,54 @@ class PlaylistSearcher : public QObject {
 public:
 
     PlaylistSearcher() : QObject() {}
-    void bump();
-    void unbump();
-    int bumps();
+    void bump(const QUuid &playlist);
+    void unbump(const QUuid &playlist);
+    int bumps(const QUuid &playlist);
 
     static QStringList textToNeedles(QString text);
     static bool itemMatchesFilter(const QSharedPointer<Item> &item,
                                   const QStringList &needles);
+    static bool needlesNarrow(const QStringList &needles,
+                              const QStringList &than);
 
 signals:
-    void playlistFiltered(QUuid playlist);
+    // shown holds the items that match, in playlist order.  When filtered is
+    // false, the filter was cleared and every item is shown.  generation is
+    // the playlist's when the search started; anything added after that may
+    // be missing from shown.
+    void playlistFiltered(QUuid playlist, QVector<QSharedPointer<Item>> shown,
+                          bool filtered, quint64 generation);
 
 public slots:
     void filterPlaylist(QSharedPointer<Playlist> list, QString text);
     void clearPlaylistFilter(QSharedPointer<Playlist> &list);
+    void forgetPlaylist(QUuid playlist);
 
 private:
-    static void findNeedles(const QString &text, const QStringList &needles,
-                            QSet<QString> &found);
+    struct FilterResult {
+        QStringList needles;
+        QVector<QSharedPointer<Item>> matches;
+        // The playlist's retaggedCount() when the result was made.
+        int retagged = 0;
+    };
+    // Recent results for a playlist, valid for as long as the playlist stays
+    // at the same generation.  shown is what the hidden flags currently say.
+    struct FilterCache {
+        quint64 generation = 0;
+        QList<FilterResult> results;
+        QVector<QSharedPointer<Item>> shown;
+        bool filtered = false;
+    };
+
+    static bool hasNeedles(const QString &haystack,
+                           const QStringList &needles);
+    static QVector<QSharedPointer<Item>> matchItems(
+            const QVector<QSharedPointer<Item>> &candidates,
+            const QStringList &needles);
 
     QReadWriteLock bumpLock;
-    volatile int bumps_ = 0;
+    QHash<QUuid, int> bumps_;
+    QHash<QUuid, FilterCache> caches;
 };
 
 
@@ -0,0 +1,281 @@
+#include <algorithm>
+#include "playlistindex.h"
+#include "playlist.h"
+
+// Don't bother compacting away fewer dead slots than this.
+constexpr int minCompaction = 1024;
+// Characters in the longest gram.  Shorter runs are indexed as well, so that
+// needles of one or two characters can be looked up too.
+constexpr int gramLength = 3;
+
+PlaylistIndex::PlaylistIndex()
+{
+
+}
+
+bool PlaylistIndex::isReady()
+{
+    QReadLocker locker(&lock);
+    return ready;
+}
+
+void PlaylistIndex::setReady(bool yes)
+{
+    QWriteLocker locker(&lock);
+    ready = yes;
+}
+
+void PlaylistIndex::addItem(const QSharedPointer<Item> &item)
+{
+    QWriteLocker locker(&lock);
+    addItem_(item);
+}
+
+void PlaylistIndex::addItems(const QList<QSharedPointer<Item>> &itemsToAdd)
+{
+    QWriteLocker locker(&lock);
+    items.reserve(items.count() + itemsToAdd.count());
+    for (const QSharedPointer<Item> &item : itemsToAdd)
+        addItem_(item);
+}
+
+void PlaylistIndex::removeItem(const QUuid &uuid)
+{
+    QWriteLocker locker(&lock);
+    removeItem_(uuid);
+    maybeCompact_();
+}
+
+void PlaylistIndex::updateItem(const QSharedPointer<Item> &item)
+{
+    QWriteLocker locker(&lock);
+    removeItem_(item->uuid());
+    addItem_(item);
+    maybeCompact_();
+}
+
+void PlaylistIndex::updateItems(const QList<QSharedPointer<Item>> &items)
+{
+    QWriteLocker locker(&lock);
+    for (const QSharedPointer<Item> &item : items) {
+        removeItem_(item->uuid());
+        addItem_(item);
+    }
+    maybeCompact_();
+}
+
+void PlaylistIndex::clear()
+{
+    QWriteLocker locker(&lock);
+    items.clear();
+    idByUuid.clear();
+    postings.clear();
+    removed = 0;
+}
+
+bool PlaylistIndex::canFind(const QStringList &needles)
+{
+    for (const QString &needle : needles)
+        if (!needle.isEmpty())
+            return true;
+    return false;
+}
+
+QVector<QSharedPointer<Item>> PlaylistIndex::find(const QStringList &needles)
+{
+    QReadLocker locker(&lock);
+    // Longer needles tend to be rarer, so start with them to keep the
+    // running intersection small.
+    QStringList ordered;
+    for (const QString &needle : needles)
+        if (!needle.isEmpty())
+            ordered.append(needle);
+    if (ordered.isEmpty())
+        return QVector<QSharedPointer<Item>>();
+    std::sort(ordered.begin(), ordered.end(),
+              [](const QString &a, const QString &b) {
+        return a.length() > b.length();
+    });
+
+    QVector<int> ids = lookup_(ordered.first());
+    for (int i = 1; i < ordered.count() && !ids.isEmpty(); i++) {
+        QVector<int> next = lookup_(ordered.at(i));
+        QVector<int> both;
+        std::set_intersection(ids.begin(), ids.end(),
+                              next.begin(), next.end(),
+                              std::back_inserter(both));
+        ids = both;
+    }
+
+    QVector<QSharedPointer<Item>> found;
+    found.reserve(ids.count());
+    for (int id : ids)
+        if (!items.at(id).isNull())
+            found.append(items.at(id));
+    return found;
+}
+
+void PlaylistIndex::save(QDataStream &out,
+                         const QList<QSharedPointer<Item>> &listItems)
+{
+    QReadLocker locker(&lock);
+    QHash<int, int> positionOfId;
+    positionOfId.reserve(listItems.count());
+    for (int i = 0; i < listItems.count(); i++) {
+        int id = idByUuid.value(listItems.at(i)->uuid(), -1);
+        if (id >= 0)
+            positionOfId.insert(id, i);
+    }
+
+    QHash<quint64, QVector<int>> byPosition;
+    byPosition.reserve(postings.count());
+    for (auto it = postings.constBegin(); it != postings.constEnd(); ++it) {
+        QVector<int> positions;
+        positions.reserve(it.value().count());
+        for (int id : it.value()) {
+            int position = positionOfId.value(id, -1);
+            if (position >= 0)
+                positions.append(position);
+        }
+        if (positions.isEmpty())
+            continue;
+        std::sort(positions.begin(), positions.end());
+        positions.erase(std::unique(positions.begin(), positions.end()),
+                        positions.end());
+        byPosition.insert(it.key(), positions);
+    }
+    out << checksum(listItems) << byPosition;
+}
+
+bool PlaylistIndex::load(QDataStream &in,
+                         const QList<QSharedPointer<Item>> &listItems)
+{
+    quint32 sum;
+    QHash<quint64, QVector<int>> byPosition;
+    in >> sum >> byPosition;
+    if (in.status() != QDataStream::Ok || sum != checksum(listItems))
+        return false;
+
+    // Positions in the saved list are ids in the restored one.
+    QWriteLocker locker(&lock);
+    items = listItems.toVector();
+    idByUuid.clear();
+    idByUuid.reserve(items.count());
+    for (int i = 0; i < items.count(); i++)
+        idByUuid.insert(items.at(i)->uuid(), i);
+    postings = byPosition;
+    removed = 0;
+    ready = true;
+    return true;
+}
+
+quint32 PlaylistIndex::checksum(const QList<QSharedPointer<Item>> &listItems)
+{
+    uint sum = listItems.count();
+    for (const QSharedPointer<Item> &item : listItems)
+        sum = qHash(item->uuid(), sum);
+    return sum;
+}
+
+void PlaylistIndex::addItem_(const QSharedPointer<Item> &item)
+{
+    if (idByUuid.contains(item->uuid()))
+        return;
+    int id = items.count();
+    items.append(item);
+    idByUuid.insert(item->uuid(), id);
+    QString key = item->searchKey();
+    for (int length = 1; length <= gramLength; length++)
+        for (quint64 gram : grams(key, length))
+            postings[gram].append(id);
+}
+
+void PlaylistIndex::removeItem_(const QUuid &uuid)
+{
+    // The id stays in the postings until the next compaction, and find()
+    // skips null slots.
+    int id = idByUuid.value(uuid, -1);
+    idByUuid.remove(uuid);
+    if (id < 0 || id >= items.count() || items.at(id).isNull())
+        return;
+    items[id].reset();
+    removed++;
+}
+
+void PlaylistIndex::maybeCompact_()
+{
+    if (removed > minCompaction && removed > items.count() / 2)
+        compact_();
+}
+
+void PlaylistIndex::compact_()
+{
+    QVector<QSharedPointer<Item>> live;
+    live.reserve(items.count() - removed);
+    for (const QSharedPointer<Item> &item : items)
+        if (!item.isNull())
+            live.append(item);
+    items.clear();
+    idByUuid.clear();
+    postings.clear();
+    removed = 0;
+    for (const QSharedPointer<Item> &item : live)
+        addItem_(item);
+}
+
+QVector<int> PlaylistIndex::lookup_(const QString &needle) const
+{
+    // Items holding the needle hold every one of its grams.  Intersect from
+    // the rarest gram up, so the running set starts out small.  A needle
+    // shorter than a trigram is a gram of its own.
+    QVector<const QVector<int> *> lists;
+    for (quint64 gram : grams(needle, std::min(int(needle.length()), gramLength))) {
+        auto it = postings.constFind(gram);
+        if (it == postings.constEnd())
+            return QVector<int>();
+        lists.append(&it.value());
+    }
+    if (lists.isEmpty())
+        return QVector<int>();
+    std::sort(lists.begin(), lists.end(),
+              [](const QVector<int> *a, const QVector<int> *b) {
+        return a->count() < b->count();
+    });
+
+    QVector<int> ids = *lists.first();
+    for (int i = 1; i < lists.count() && !ids.isEmpty(); i++) {
+        QVector<int> both;
+        std::set_intersection(ids.begin(), ids.end(),
+                              lists.at(i)->begin(), lists.at(i)->end(),
+                              std::back_inserter(both));
+        ids = both;
+    }
+    // An item that was updated is posted again under a new id, so the same
+    // id never appears twice in one list.
+    return ids;
+}
+
+QVector<quint64> PlaylistIndex::grams(const QString &text, int length)
+{
+    // Needles never contain spaces, and the key's fields are separated by
+    // newlines, so grams spanning either can never be asked for.  The
+    // length goes above the characters, so that grams of different lengths
+    // never collide.
+    QVector<quint64> found;
+    int count = text.length();
+    found.reserve(std::max(0, count - length + 1));
+    for (int i = 0; i + length <= count; i++) {
+        quint64 gram = 0;
+        bool usable = true;
+        for (int j = 0; j < length && usable; j++) {
+            QChar c = text.at(i + j);
+            usable = c != QLatin1Char(' ') && c != QLatin1Char('\n');
+            gram = (gram << 16) | c.unicode();
+        }
+        if (usable)
+            found.append(gram | quint64(length) << 48);
+    }
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    return found;
+}
@@ -0,0 +1,73 @@
+#ifndef PLAYLISTINDEX_H
+#define PLAYLISTINDEX_H
+// An inverted index over the search keys of a playlist's items, so that big
+// playlists can be searched without testing every item.  Keys are indexed by
+// their trigrams (every run of three characters), so a needle found anywhere
+// within a key is a lookup of its own trigrams rather than a scan.  Runs of
+// one and two characters are indexed too, so that short needles are a single
+// lookup rather than a scan.
+//
+// Removing or updating an item only clears its slot.  Its id stays in the
+// postings, where find() skips it, until more than half of the slots are
+// dead and the index is rebuilt from the live items.
+
+#include <QDataStream>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QUuid>
+#include <QVector>
+
+class Item;
+
+class PlaylistIndex {
+public:
+    PlaylistIndex();
+
+    bool isReady();
+    void setReady(bool yes);
+
+    void addItem(const QSharedPointer<Item> &item);
+    void addItems(const QList<QSharedPointer<Item>> &items);
+    void removeItem(const QUuid &uuid);
+    void updateItem(const QSharedPointer<Item> &item);
+    void updateItems(const QList<QSharedPointer<Item>> &items);
+    void clear();
+
+    // Whether find can narrow down a search for needles at all.
+    static bool canFind(const QStringList &needles);
+    // Every indexed item whose search key may contain all of the needles, in
+    // no particular order.  Having all of a needle's grams doesn't mean
+    // having the needle, so the items still need checking.  May include items
+    // that have since left the list.
+    QVector<QSharedPointer<Item>> find(const QStringList &needles);
+
+    // Postings are stored by position within items, which must be the list
+    // the index describes, so that they survive a restart.
+    void save(QDataStream &out, const QList<QSharedPointer<Item>> &items);
+    bool load(QDataStream &in, const QList<QSharedPointer<Item>> &items);
+
+    static quint32 checksum(const QList<QSharedPointer<Item>> &items);
+
+private:
+    void addItem_(const QSharedPointer<Item> &item);
+    void removeItem_(const QUuid &uuid);
+    void maybeCompact_();
+    void compact_();
+    QVector<int> lookup_(const QString &needle) const;
+    static QVector<quint64> grams(const QString &text, int length);
+
+    QReadWriteLock lock;
+    bool ready = false;
+    // Items by id.  Ids are handed out in increasing order, so postings stay
+    // sorted by appending.  Removed items leave a null slot behind until the
+    // next compaction.
+    QVector<QSharedPointer<Item>> items;
+    QHash<QUuid, int> idByUuid;
+    // Ids by gram, its length and characters packed into one number.
+    QHash<quint64, QVector<int>> postings;
+    int removed = 0;
+};
+
+#endif // PLAYLISTINDEX_H
@@ -0,0 +1,331 @@
+#include <QDataStream>
+#include <QHash>
+#include <QtEndian>
+#include "playlistjournal.h"
+#include "playlist.h"
+
+static const char journalMagic[] = "MPQJ";
+// length and checksum
+constexpr int frameHeaderSize = 4 + 2;
+
+static QSharedPointer<Playlist> playlistFor(
+        QHash<QUuid, QSharedPointer<Playlist>> &playlists, const QUuid &uuid)
+{
+    // Playlists created after the store was written only exist in the log.
+    QSharedPointer<Playlist> &playlist = playlists[uuid];
+    if (playlist.isNull()) {
+        playlist.reset(new Playlist());
+        playlist->setUuid(uuid);
+    }
+    return playlist;
+}
+
+static QList<QSharedPointer<Item>> itemsFor(const QSharedPointer<Playlist> &playlist,
+                                            const QList<QUuid> &uuids)
+{
+    QList<QSharedPointer<Item>> items;
+    for (const QUuid &uuid : uuids) {
+        QSharedPointer<Item> item = playlist->itemOf(uuid);
+        if (!item.isNull())
+            items.append(item);
+    }
+    return items;
+}
+
+static bool applyRecord(QDataStream &in,
+                        QHash<QUuid, QSharedPointer<Playlist>> &playlists,
+                        QList<PlaylistStore::Tab> &layout)
+{
+    quint8 type;
+    in >> type;
+    if (type == PlaylistJournal::TabsRecord) {
+        quint32 count;
+        in >> count;
+        QList<PlaylistStore::Tab> tabs;
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+            QUuid uuid;
+            QString title;
+            bool shuffle;
+            PlaylistStore::Tab tab;
+            in >> uuid >> title >> shuffle >> tab.nowPlaying;
+            tab.playlist = playlistFor(playlists, uuid);
+            tab.playlist->setTitle(title);
+            tab.playlist->setShuffle(shuffle);
+            tabs.append(tab);
+        }
+        if (in.status() != QDataStream::Ok)
+            return false;
+        layout = tabs;
+        return true;
+    }
+
+    QUuid uuid;
+    in >> uuid;
+    if (in.status() != QDataStream::Ok)
+        return false;
+    QSharedPointer<Playlist> playlist = playlistFor(playlists, uuid);
+
+    switch (type) {
+    case PlaylistJournal::InsertRecord: {
+        QUuid before;
+        quint32 count;
+        in >> before >> count;
+        QList<QSharedPointer<Item>> items;
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+            QUuid itemUuid;
+            QUrl url;
+            QVariantMap metadata;
+            in >> itemUuid >> url >> metadata;
+            auto item = QSharedPointer<Item>::create(url);
+            item->setUuid(itemUuid);
+            item->setMetadata(metadata);
+            items.append(item);
+        }
+        if (in.status() != QDataStream::Ok)
+            return false;
+        playlist->addItems(before, items);
+        for (const QSharedPointer<Item> &item : items)
+            ItemCollection::getSingleton()->storeItem(item);
+        break;
+    }
+    case PlaylistJournal::RemoveRecord: {
+        // Nothing is queued yet, so the items can be taken in one go rather
+        // than going through removeItem for each.
+        QList<QUuid> uuids;
+        in >> uuids;
+        playlist->takeItemsRaw(itemsFor(playlist, uuids));
+        for (const QUuid &itemUuid : uuids)
+            ItemCollection::getSingleton()->removeItem(itemUuid);
+        break;
+    }
+    case PlaylistJournal::MoveRecord: {
+        QUuid before;
+        QList<QUuid> uuids;
+        in >> before >> uuids;
+        playlist->moveItems(itemsFor(playlist, uuids), before);
+        break;
+    }
+    case PlaylistJournal::UpdateRecord: {
+        QUuid itemUuid;
+        QUrl url;
+        QVariantMap metadata;
+        in >> itemUuid >> url >> metadata;
+        QSharedPointer<Item> item = playlist->itemOf(itemUuid);
+        if (!item.isNull()) {
+            item->setUrl(url);
+            item->setMetadata(metadata);
+        }
+        break;
+    }
+    case PlaylistJournal::ClearRecord:
+        playlist->clear();
+        break;
+    default:
+        return false;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+PlaylistJournal::PlaylistJournal(QObject *parent) : QObject(parent)
+{
+
+}
+
+void PlaylistJournal::setRecording(bool yes)
+{
+    QMutexLocker locker(&lock);
+    recording = yes;
+}
+
+bool PlaylistJournal::isRecording()
+{
+    QMutexLocker locker(&lock);
+    return recording;
+}
+
+void PlaylistJournal::insertItems(const QUuid &playlist, const QUuid &before,
+                                  const QList<QSharedPointer<Item>> &items)
+{
+    if (items.isEmpty() || !isRecording())
+        return;
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint8(InsertRecord) << playlist << before << quint32(items.count());
+    for (const QSharedPointer<Item> &item : items)
+        out << item->uuid() << item->url() << item->metadata();
+    append(payload);
+}
+
+void PlaylistJournal::removeItems(const QUuid &playlist,
+                                  const QList<QUuid> &items)
+{
+    if (items.isEmpty() || !isRecording())
+        return;
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint8(RemoveRecord) << playlist << items;
+    append(payload);
+}
+
+void PlaylistJournal::moveItems(const QUuid &playlist, const QUuid &before,
+                                const QList<QUuid> &items)
+{
+    if (items.isEmpty() || !isRecording())
+        return;
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint8(MoveRecord) << playlist << before << items;
+    append(payload);
+}
+
+void PlaylistJournal::updateItem(const QUuid &playlist,
+                                 const QSharedPointer<Item> &item)
+{
+    if (!isRecording())
+        return;
+    append(updatePayload(playlist, item));
+}
+
+void PlaylistJournal::updateItems(const QUuid &playlist,
+                                  const QList<QSharedPointer<Item>> &items)
+{
+    if (!isRecording() || items.isEmpty())
+        return;
+    QList<QByteArray> payloads;
+    payloads.reserve(items.count());
+    for (const QSharedPointer<Item> &item : items)
+        payloads.append(updatePayload(playlist, item));
+    append(payloads);
+}
+
+void PlaylistJournal::clearPlaylist(const QUuid &playlist)
+{
+    if (!isRecording())
+        return;
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint8(ClearRecord) << playlist;
+    append(payload);
+}
+
+QByteArray PlaylistJournal::takeChanges(quint64 *sequence)
+{
+    QMutexLocker locker(&lock);
+    QByteArray changes;
+    changes.swap(pending);
+    if (sequence)
+        *sequence = sequence_;
+    return changes;
+}
+
+quint64 PlaylistJournal::sequence()
+{
+    QMutexLocker locker(&lock);
+    return sequence_;
+}
+
+QByteArray PlaylistJournal::tabsRecord(const QList<PlaylistStore::Tab> &tabs)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint8(TabsRecord) << quint32(tabs.count());
+    for (const PlaylistStore::Tab &tab : tabs)
+        out << tab.playlist->uuid() << tab.playlist->title()
+            << tab.playlist->shuffle() << tab.nowPlaying;
+    return frame(payload);
+}
+
+QByteArray PlaylistJournal::header(quint32 epoch)
+{
+    QByteArray out(journalMagic, 4);
+    uchar bytes[4];
+    qToLittleEndian<quint32>(epoch, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), 4);
+    return out;
+}
+
+qint64 PlaylistJournal::replay(const QByteArray &journal, quint32 epoch,
+                               QList<PlaylistStore::Tab> &tabs)
+{
+    // A journal left over from an older store no longer applies.
+    QByteArray head = header(epoch);
+    if (!journal.startsWith(head))
+        return -1;
+
+    QHash<QUuid, QSharedPointer<Playlist>> playlists;
+    for (const PlaylistStore::Tab &tab : tabs)
+        playlists.insert(tab.playlist->uuid(), tab.playlist);
+    QList<PlaylistStore::Tab> layout = tabs;
+
+    const uchar *data = reinterpret_cast<const uchar*>(journal.constData());
+    qint64 offset = head.size();
+    while (offset + frameHeaderSize <= journal.size()) {
+        quint32 size = qFromLittleEndian<quint32>(data + offset);
+        quint16 sum = qFromLittleEndian<quint16>(data + offset + 4);
+        if (quint64(offset) + frameHeaderSize + size > quint64(journal.size()))
+            break;
+        QByteArray payload = QByteArray::fromRawData(
+                    journal.constData() + offset + frameHeaderSize, size);
+        if (qChecksum(payload.constData(), size) != sum)
+            break;
+
+        QDataStream in(payload);
+        in.setVersion(QDataStream::Qt_5_0);
+        if (!applyRecord(in, playlists, layout))
+            break;
+        offset += frameHeaderSize + size;
+    }
+    tabs = layout;
+    return offset;
+}
+
+void PlaylistJournal::append(const QByteArray &payload)
+{
+    QByteArray record = frame(payload);
+    {
+        QMutexLocker locker(&lock);
+        pending.append(record);
+        sequence_++;
+    }
+    emit changed();
+}
+
+void PlaylistJournal::append(const QList<QByteArray> &payloads)
+{
+    QByteArray records;
+    for (const QByteArray &payload : payloads)
+        records.append(frame(payload));
+    {
+        QMutexLocker locker(&lock);
+        pending.append(records);
+        sequence_ += payloads.count();
+    }
+    emit changed();
+}
+
+QByteArray PlaylistJournal::updatePayload(const QUuid &playlist,
+                                          const QSharedPointer<Item> &item)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint8(UpdateRecord) << playlist << item->uuid() << item->url()
+        << item->metadata();
+    return payload;
+}
+
+QByteArray PlaylistJournal::frame(const QByteArray &payload)
+{
+    uchar bytes[frameHeaderSize];
+    qToLittleEndian<quint32>(payload.size(), bytes);
+    qToLittleEndian<quint16>(qChecksum(payload.constData(), payload.size()),
+                             bytes + 4);
+    QByteArray record(reinterpret_cast<const char*>(bytes), frameHeaderSize);
+    record.append(payload);
+    return record;
+}
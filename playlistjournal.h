@@ -0,0 +1,76 @@
+#ifndef PLAYLISTJOURNAL_H
+#define PLAYLISTJOURNAL_H
+// An append-only log of the changes made to playlists since PlaylistStore
+// last wrote them out in full, so that saving costs as much as what changed
+// rather than as much as the library.  Storage folds the log back into the
+// store once it has grown.
+//
+// The file starts with magic "MPQJ" and the epoch of the store it applies
+// to, followed by records.  Each record is its length and checksum, then a
+// QDataStream'd payload.  A record torn by a crash fails its checksum, and
+// replaying stops right there.  Nothing may be appended after such a record,
+// as it would never be reached, so Storage compacts into a fresh store
+// instead.
+
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include "playliststore.h"
+
+class Item;
+
+class PlaylistJournal : public QObject {
+    Q_OBJECT
+public:
+    enum RecordType { InsertRecord = 1, RemoveRecord, MoveRecord,
+                      UpdateRecord, ClearRecord, TabsRecord };
+
+    explicit PlaylistJournal(QObject *parent = nullptr);
+
+    // Off while playlists are being restored, so that reading them in
+    // doesn't log them all over again.
+    void setRecording(bool yes);
+    bool isRecording();
+
+    void insertItems(const QUuid &playlist, const QUuid &before,
+                     const QList<QSharedPointer<Item>> &items);
+    void removeItems(const QUuid &playlist, const QList<QUuid> &items);
+    void moveItems(const QUuid &playlist, const QUuid &before,
+                   const QList<QUuid> &items);
+    void updateItem(const QUuid &playlist, const QSharedPointer<Item> &item);
+    // One record per item, appended together.
+    void updateItems(const QUuid &playlist,
+                     const QList<QSharedPointer<Item>> &items);
+    void clearPlaylist(const QUuid &playlist);
+
+    // Everything recorded since the last call.  Sets sequence to how many
+    // records there have been in all, if given.
+    QByteArray takeChanges(quint64 *sequence = nullptr);
+    quint64 sequence();
+
+    // The tab layout as a record of its own.  Titles, shuffle and now playing
+    // are small enough to always write out in full.
+    static QByteArray tabsRecord(const QList<PlaylistStore::Tab> &tabs);
+    static QByteArray header(quint32 epoch);
+    // Returns the offset just past the last record that could be applied, or
+    // -1 if the journal is of another store.
+    static qint64 replay(const QByteArray &journal, quint32 epoch,
+                         QList<PlaylistStore::Tab> &tabs);
+
+signals:
+    void changed();
+
+private:
+    void append(const QByteArray &payload);
+    void append(const QList<QByteArray> &payloads);
+    static QByteArray updatePayload(const QUuid &playlist,
+                                    const QSharedPointer<Item> &item);
+    static QByteArray frame(const QByteArray &payload);
+
+    QMutex lock;
+    bool recording = false;
+    QByteArray pending;
+    quint64 sequence_ = 0;
+};
+
+#endif // PLAYLISTJOURNAL_H
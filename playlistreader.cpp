@@ -0,0 +1,303 @@
+#include <QFileInfo>
+#include <QtConcurrent>
+#include "playlistreader.h"
+
+// Entries are handed to the GUI thread in batches of this many.
+constexpr int importBatchSize = 2048;
+// No more than this many batches wait on the GUI thread at once.
+constexpr int maxBatchesInFlight = 4;
+
+PlaylistReader::PlaylistReader(const QString &fileName)
+    : file(fileName), base(QFileInfo(fileName).absoluteDir()),
+      format(formatOf(fileName))
+{
+
+}
+
+bool PlaylistReader::open()
+{
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+    stream.setDevice(&file);
+    if (QFileInfo(file.fileName()).suffix().toLower() == "m3u8")
+        stream.setCodec("UTF-8");
+    return true;
+}
+
+bool PlaylistReader::atEnd()
+{
+    return finished;
+}
+
+QList<PlaylistReader::Entry> PlaylistReader::read(int maximum)
+{
+    QList<Entry> out;
+    while (out.count() < maximum && !finished) {
+        if (stream.atEnd()) {
+            finish(out);
+            finished = true;
+            break;
+        }
+        QString line = stream.readLine().trimmed();
+        if (line.isEmpty())
+            continue;
+        switch (format) {
+        case M3UFormat:
+            readM3ULine(line, out);
+            break;
+        case PLSFormat:
+            readPLSLine(line, out);
+            break;
+        case CUEFormat:
+            readCUELine(line, out);
+            break;
+        }
+    }
+    return out;
+}
+
+PlaylistReader::Format PlaylistReader::formatOf(const QString &fileName)
+{
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "pls")
+        return PLSFormat;
+    if (suffix == "cue")
+        return CUEFormat;
+    return M3UFormat;
+}
+
+void PlaylistReader::readM3ULine(const QString &line, QList<Entry> &out)
+{
+    if (line.startsWith('#')) {
+        if (line.startsWith("#EXTINF:", Qt::CaseInsensitive)) {
+            // The duration and any attributes come before the first comma
+            // that isn't in quotes, and the title is everything after it.
+            QString info = line.mid(8);
+            int comma = -1;
+            bool quoted = false;
+            for (int i = 0; i < info.size() && comma < 0; i++) {
+                if (info.at(i) == '"')
+                    quoted = !quoted;
+                else if (info.at(i) == ',' && !quoted)
+                    comma = i;
+            }
+            QString head = comma < 0 ? info : info.left(comma);
+            QString title = comma < 0 ? QString() : info.mid(comma + 1).trimmed();
+            bool ok;
+            double duration = head.section(' ', 0, 0).toDouble(&ok);
+            if (ok && duration > 0)
+                pending.insert("duration", duration);
+            if (!title.isEmpty())
+                pending.insert("title", title);
+        } else if (line.startsWith("#EXTALB:", Qt::CaseInsensitive)) {
+            sticky.insert("album", line.mid(8).trimmed());
+        } else if (line.startsWith("#EXTART:", Qt::CaseInsensitive)) {
+            sticky.insert("artist", line.mid(8).trimmed());
+        }
+        return;
+    }
+
+    Entry entry;
+    entry.url = urlOf(line);
+    entry.metadata = sticky;
+    for (auto it = pending.constBegin(); it != pending.constEnd(); ++it)
+        entry.metadata.insert(it.key(), it.value());
+    pending.clear();
+    out.append(entry);
+}
+
+void PlaylistReader::readPLSLine(const QString &line, QList<Entry> &out)
+{
+    if (line.startsWith('[') || !line.contains('='))
+        return;
+    QString key = line.section('=', 0, 0).trimmed();
+    QString value = line.section('=', 1).trimmed();
+    int digits = key.size();
+    while (digits > 0 && key.at(digits - 1).isDigit())
+        digits--;
+    if (digits == key.size())
+        return;     // NumberOfEntries, Version and the like
+
+    int index = key.mid(digits).toInt();
+    QString name = key.left(digits).toLower();
+    if (index != plsIndex) {
+        flushPLSEntry(out);
+        plsIndex = index;
+    }
+    if (name == "file") {
+        plsUrl = urlOf(value);
+    } else if (name == "title" && !value.isEmpty()) {
+        pending.insert("title", value);
+    } else if (name == "length") {
+        bool ok;
+        double duration = value.toDouble(&ok);
+        if (ok && duration > 0)
+            pending.insert("duration", duration);
+    }
+}
+
+void PlaylistReader::readCUELine(const QString &line, QList<Entry> &out)
+{
+    QString command = line.section(' ', 0, 0).toUpper();
+    QString rest = line.section(' ', 1).trimmed();
+    if (command == "FILE") {
+        flushCUEFile(out);
+        // The file type follows the name, which may be quoted.
+        QString name = rest.startsWith('"') ? rest.mid(1, rest.indexOf('"', 1) - 1)
+                                            : rest.section(' ', 0, 0);
+        cueUrl = urlOf(name);
+        cueInTrack = false;
+    } else if (command == "TRACK") {
+        cueTracks.append(QVariantMap());
+        cueInTrack = true;
+    } else if (command == "TITLE" || command == "PERFORMER") {
+        // Outside of a track, they describe the whole album.
+        QString value = unquoted(rest);
+        if (cueInTrack && !cueTracks.isEmpty())
+            cueTracks.last().insert(command == "TITLE" ? "title" : "artist", value);
+        else
+            cueAlbum.insert(command == "TITLE" ? "album" : "artist", value);
+    }
+}
+
+void PlaylistReader::finish(QList<Entry> &out)
+{
+    if (format == PLSFormat)
+        flushPLSEntry(out);
+    else if (format == CUEFormat)
+        flushCUEFile(out);
+}
+
+void PlaylistReader::flushPLSEntry(QList<Entry> &out)
+{
+    if (!plsUrl.isEmpty())
+        out.append({ plsUrl, pending });
+    plsUrl.clear();
+    pending.clear();
+}
+
+void PlaylistReader::flushCUEFile(QList<Entry> &out)
+{
+    if (cueUrl.isEmpty())
+        return;
+    // There's no way to point the player at one track within a file from
+    // here, so a file holding several tracks becomes a single entry named
+    // after the album.
+    QVariantMap metadata = cueAlbum;
+    if (cueTracks.count() == 1) {
+        const QVariantMap &track = cueTracks.first();
+        for (auto it = track.constBegin(); it != track.constEnd(); ++it)
+            metadata.insert(it.key(), it.value());
+    } else if (cueAlbum.contains("album")) {
+        metadata.insert("title", cueAlbum.value("album"));
+    }
+    out.append({ cueUrl, metadata });
+    cueUrl.clear();
+    cueTracks.clear();
+}
+
+QUrl PlaylistReader::urlOf(const QString &location) const
+{
+    QString path = QDir::fromNativeSeparators(location);
+    if (QDir::isAbsolutePath(path))
+        return QUrl::fromLocalFile(path);
+    // A one letter scheme is a drive letter.
+    QUrl url(location);
+    if (url.isValid() && url.scheme().size() > 1)
+        return url;
+    return QUrl::fromLocalFile(base.absoluteFilePath(path));
+}
+
+QString PlaylistReader::unquoted(const QString &text)
+{
+    QString t = text.trimmed();
+    if (t.size() >= 2 && t.startsWith('"') && t.endsWith('"'))
+        return t.mid(1, t.size() - 2);
+    return t;
+}
+
+
+
+PlaylistImporter::PlaylistImporter(const QString &fileName,
+                                   const QUuid &playlist)
+    : QObject(), reader(fileName), playlist(playlist)
+{
+
+}
+
+void PlaylistImporter::start()
+{
+    QMutexLocker locker(&lock);
+    if (reading || done)
+        return;
+    reading = true;
+    task = QtConcurrent::run(this, &PlaylistImporter::readBatches);
+}
+
+void PlaylistImporter::cancel()
+{
+    cancelled.store(1);
+}
+
+void PlaylistImporter::wait()
+{
+    QFuture<void> running;
+    {
+        QMutexLocker locker(&lock);
+        running = task;
+    }
+    running.waitForFinished();
+}
+
+void PlaylistImporter::batchTaken()
+{
+    QMutexLocker locker(&lock);
+    batchesOut--;
+    if (reading)
+        return;
+    if (!done && !cancelled.load()) {
+        reading = true;
+        task = QtConcurrent::run(this, &PlaylistImporter::readBatches);
+        return;
+    }
+    if (batchesOut > 0)
+        return;
+    done = true;
+    locker.unlock();
+    emit finished(playlist);
+}
+
+void PlaylistImporter::readBatches()
+{
+    if (!opened) {
+        opened = true;
+        readable = reader.open();
+    }
+    while (readable && !reader.atEnd() && !cancelled.load()) {
+        {
+            QMutexLocker locker(&lock);
+            if (batchesOut >= maxBatchesInFlight) {
+                // batchTaken() carries on from here.
+                reading = false;
+                return;
+            }
+        }
+        QList<PlaylistReader::Entry> entries = reader.read(importBatchSize);
+        if (entries.isEmpty())
+            continue;
+        {
+            QMutexLocker locker(&lock);
+            batchesOut++;
+        }
+        emit entriesRead(playlist, entries);
+    }
+
+    // Whichever of this and the last batchTaken() comes last says so.
+    QMutexLocker locker(&lock);
+    reading = false;
+    done = true;
+    if (batchesOut > 0)
+        return;
+    locker.unlock();
+    emit finished(playlist);
+}
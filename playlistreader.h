@@ -0,0 +1,107 @@
+#ifndef PLAYLISTREADER_H
+#define PLAYLISTREADER_H
+// Reads playlist files a line at a time, so that huge ones are never held
+// in memory as a whole.  Understands M3U (with the extended #EXTINF, #EXTALB
+// and #EXTART tags), PLS and CUE sheets.  Titles, artists, albums and
+// durations end up in each entry's metadata, under the same names mpv uses.
+
+#include <QAtomicInt>
+#include <QDir>
+#include <QFile>
+#include <QFuture>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QTextStream>
+#include <QUrl>
+#include <QUuid>
+#include <QVariantMap>
+
+class PlaylistReader {
+public:
+    enum Format { M3UFormat, PLSFormat, CUEFormat };
+    struct Entry {
+        QUrl url;
+        QVariantMap metadata;
+    };
+
+    explicit PlaylistReader(const QString &fileName);
+    bool open();
+    bool atEnd();
+    // Reads up to maximum entries.  Fewer are returned only at the end.
+    QList<Entry> read(int maximum);
+
+    static Format formatOf(const QString &fileName);
+
+private:
+    void readM3ULine(const QString &line, QList<Entry> &out);
+    void readPLSLine(const QString &line, QList<Entry> &out);
+    void readCUELine(const QString &line, QList<Entry> &out);
+    void finish(QList<Entry> &out);
+    void flushPLSEntry(QList<Entry> &out);
+    void flushCUEFile(QList<Entry> &out);
+    QUrl urlOf(const QString &location) const;
+    static QString unquoted(const QString &text);
+
+    QFile file;
+    QTextStream stream;
+    QDir base;
+    Format format;
+    bool finished = false;
+
+    // Tags seen since the last entry.  For M3U albums and artists, they
+    // carry on until changed.
+    QVariantMap pending;
+    QVariantMap sticky;
+    // PLS keys are numbered, and a number's keys are normally together.
+    int plsIndex = -1;
+    QUrl plsUrl;
+    // CUE tracks are collected per file.
+    QUrl cueUrl;
+    QVariantMap cueAlbum;
+    QList<QVariantMap> cueTracks;
+    bool cueInTrack = false;
+};
+
+Q_DECLARE_METATYPE(PlaylistReader::Entry)
+
+// Feeds a playlist file to the GUI thread in batches, read on the global
+// thread pool.  Only a few batches are let out at a time, so that reading
+// never gets far ahead of the GUI thread taking them in.  Once that many are
+// out, the read gives its thread back rather than wait, and the GUI thread
+// taking a batch in starts it up again.
+class PlaylistImporter : public QObject {
+    Q_OBJECT
+public:
+    PlaylistImporter(const QString &fileName, const QUuid &playlist);
+    void start();
+    void cancel();
+    // Waits for a read that is under way.  Call cancel() first.
+    void wait();
+    // Called once a batch from entriesRead has been dealt with.  Must be
+    // called for every batch, even after cancelling, as finished only comes
+    // once they are all back.
+    void batchTaken();
+
+signals:
+    void entriesRead(QUuid playlist, QList<PlaylistReader::Entry> entries);
+    void finished(QUuid playlist);
+
+private:
+    void readBatches();
+
+    // Only used by readBatches, of which one runs at a time.
+    PlaylistReader reader;
+    bool opened = false;
+    bool readable = false;
+
+    QUuid playlist;
+    QAtomicInt cancelled;
+    QMutex lock;
+    QFuture<void> task;
+    int batchesOut = 0;
+    bool reading = false;
+    bool done = false;
+};
+
+#endif // PLAYLISTREADER_H
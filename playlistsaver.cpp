@@ -0,0 +1,151 @@
+#include <QThread>
+#include <QTimer>
+#include "playlistsaver.h"
+#include "playlistjournal.h"
+#include "playlist.h"
+
+// Wait for this long after the last change before saving...
+constexpr int saveDelay = 2000;
+// ...but don't let a steady stream of changes put it off for longer than
+// this.
+constexpr int maxSaveDelay = 10000;
+// Titles, tab order and now playing don't go through the journal, so they
+// are checked for on a slower timer.
+constexpr int layoutInterval = 30000;
+
+PlaylistSaverWorker::PlaylistSaverWorker(QObject *parent)
+    : QObject(parent)
+{
+
+}
+
+bool PlaylistSaverWorker::readPlaylists(QList<PlaylistStore::Tab> &tabs)
+{
+    return storage.readPlaylists("playlists", tabs);
+}
+
+void PlaylistSaverWorker::writePlaylists(const QList<PlaylistStore::Tab> &tabs,
+                                         const QByteArray &changes)
+{
+    storage.writePlaylists("playlists", tabs, changes);
+}
+
+void PlaylistSaverWorker::flush()
+{
+    // Queued behind every pending write, so by the time this runs they have
+    // all been done.
+}
+
+
+
+PlaylistSaver::PlaylistSaver(QObject *parent)
+    : QObject(parent)
+{
+    worker = new PlaylistSaverWorker();
+
+    saveTimer = new QTimer(this);
+    saveTimer->setSingleShot(true);
+    saveTimer->setInterval(saveDelay);
+    connect(saveTimer, &QTimer::timeout,
+            this, &PlaylistSaver::saveDue);
+
+    layoutTimer = new QTimer(this);
+    layoutTimer->setInterval(layoutInterval);
+    connect(layoutTimer, &QTimer::timeout,
+            this, &PlaylistSaver::saveDue);
+
+    connect(PlaylistCollection::getSingleton()->journal(),
+            &PlaylistJournal::changed,
+            this, &PlaylistSaver::journal_changed);
+}
+
+PlaylistSaver::~PlaylistSaver()
+{
+    finish();
+    if (!thread)
+        delete worker;
+}
+
+bool PlaylistSaver::restore(QList<PlaylistStore::Tab> &tabs)
+{
+    // The worker hasn't been handed to its thread yet, so it's safe to use
+    // from here.
+    if (thread)
+        return false;
+    return worker->readPlaylists(tabs);
+}
+
+void PlaylistSaver::start()
+{
+    if (thread)
+        return;
+    thread = new QThread(this);
+    worker->moveToThread(thread);
+    connect(thread, &QThread::finished,
+            worker, &QObject::deleteLater);
+    connect(this, &PlaylistSaver::worker_writePlaylists,
+            worker, &PlaylistSaverWorker::writePlaylists,
+            Qt::QueuedConnection);
+    thread->start();
+    layoutTimer->start();
+}
+
+void PlaylistSaver::save(const QList<PlaylistStore::Tab> &tabs)
+{
+    saveTimer->stop();
+    PlaylistJournal *journal = PlaylistCollection::getSingleton()->journal();
+    QByteArray layout = PlaylistJournal::tabsRecord(tabs);
+    if (journal->sequence() == lastSequence && layout == lastLayout)
+        return;
+    lastLayout = layout;
+
+    // Only needed should the worker decide to compact, but snapshots are
+    // cheap and must agree with the journal.  Playlists journal a change
+    // while they still hold their write lock, so if nothing was recorded
+    // while the snapshots were taken, they hold exactly what the journal
+    // does.  Otherwise take them again.
+    QByteArray changes;
+    QList<PlaylistStore::Tab> snapshots;
+    quint64 before = journal->sequence();
+    forever {
+        snapshots.clear();
+        for (const PlaylistStore::Tab &tab : tabs) {
+            PlaylistStore::Tab snapshot;
+            snapshot.playlist = tab.playlist->snapshot();
+            snapshot.nowPlaying = tab.nowPlaying;
+            snapshots.append(snapshot);
+        }
+        changes.append(journal->takeChanges(&lastSequence));
+        if (lastSequence == before)
+            break;
+        before = lastSequence;
+    }
+    changes.append(layout);
+
+    if (thread)
+        emit worker_writePlaylists(snapshots, changes);
+    else
+        worker->writePlaylists(snapshots, changes);
+}
+
+void PlaylistSaver::finish()
+{
+    saveTimer->stop();
+    layoutTimer->stop();
+    if (!thread || !thread->isRunning())
+        return;
+    QMetaObject::invokeMethod(worker, "flush", Qt::BlockingQueuedConnection);
+    thread->quit();
+    thread->wait();
+}
+
+void PlaylistSaver::journal_changed()
+{
+    if (!thread)
+        return;
+    if (!saveTimer->isActive())
+        firstChange.start();
+    else if (firstChange.elapsed() > maxSaveDelay)
+        return;
+    saveTimer->start();
+}
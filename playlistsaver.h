@@ -0,0 +1,64 @@
+#ifndef PLAYLISTSAVER_H
+#define PLAYLISTSAVER_H
+// Saves playlists in the background.  Changes start a short timer, and once
+// it runs out the GUI thread snapshots the tabs and takes the journal's
+// pending records.  Both are cheap; writing them out, or compacting them
+// into a fresh store, happens in a thread of its own.
+
+#include <QElapsedTimer>
+#include <QObject>
+#include "playliststore.h"
+#include "storage.h"
+
+class QThread;
+class QTimer;
+
+class PlaylistSaverWorker : public QObject {
+    Q_OBJECT
+public:
+    explicit PlaylistSaverWorker(QObject *parent = nullptr);
+    bool readPlaylists(QList<PlaylistStore::Tab> &tabs);
+
+public slots:
+    void writePlaylists(const QList<PlaylistStore::Tab> &tabs,
+                        const QByteArray &changes);
+    void flush();
+
+private:
+    Storage storage;
+};
+
+class PlaylistSaver : public QObject {
+    Q_OBJECT
+public:
+    explicit PlaylistSaver(QObject *parent = nullptr);
+    ~PlaylistSaver();
+
+    // Reads the saved playlists.  Call before start().
+    bool restore(QList<PlaylistStore::Tab> &tabs);
+    void start();
+    // Queues whatever changed since the last save, if anything did.
+    void save(const QList<PlaylistStore::Tab> &tabs);
+    // Waits for every queued save to land on disk.
+    void finish();
+
+signals:
+    void saveDue();
+    void worker_writePlaylists(QList<PlaylistStore::Tab> tabs,
+                               QByteArray changes);
+
+private slots:
+    void journal_changed();
+
+private:
+    QThread *thread = nullptr;
+    PlaylistSaverWorker *worker = nullptr;
+    QTimer *saveTimer = nullptr;
+    QTimer *layoutTimer = nullptr;
+    QElapsedTimer firstChange;
+    QByteArray lastLayout;
+    // The journal's sequence as of the last save.
+    quint64 lastSequence = 0;
+};
+
+#endif // PLAYLISTSAVER_H
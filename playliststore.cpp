@@ -0,0 +1,196 @@
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+#include <cstring>
+#include "playliststore.h"
+#include "playlist.h"
+
+static const char storeMagic[] = "MPQP";
+constexpr quint32 storeVersion = 2;
+// magic, then version, tab count, item count, tab table offset, item table
+// offset, string table offset, string table size and epoch.
+constexpr int headerSize = 4 + 8 * 4;
+// uuid, now playing uuid, title offset and length, flags, first item, item
+// count, reserved
+constexpr int tabRecordSize = 16 + 16 + 4 + 4 + 4 + 4 + 4 + 4;
+// uuid, url offset and length, metadata offset and length
+constexpr int itemRecordSize = 16 + 4 + 4 + 4 + 4;
+constexpr quint32 tabShuffleFlag = 1;
+
+static void putU32(QByteArray &out, quint32 value)
+{
+    uchar bytes[4];
+    qToLittleEndian<quint32>(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), 4);
+}
+
+static void putString(QByteArray &out, QByteArray &strings,
+                      const QByteArray &data)
+{
+    putU32(out, strings.size());
+    putU32(out, data.size());
+    strings.append(data);
+}
+
+static quint32 getU32(const uchar *data)
+{
+    return qFromLittleEndian<quint32>(data);
+}
+
+static QUuid getUuid(const uchar *data)
+{
+    return QUuid::fromRfc4122(QByteArray::fromRawData(
+                                  reinterpret_cast<const char*>(data), 16));
+}
+
+bool PlaylistStore::save(const QString &fileName, const QList<Tab> &tabs,
+                         quint32 epoch)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    if (file.write(encode(tabs, epoch)) < 0) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+bool PlaylistStore::load(const QString &fileName, QList<Tab> &tabs,
+                         quint32 *epoch)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    if (uchar *data = file.map(0, file.size())) {
+        bool ok = decode(data, file.size(), tabs, epoch);
+        file.unmap(data);
+        return ok;
+    }
+    // Some filesystems can't be mapped; read it in instead.
+    QByteArray data = file.readAll();
+    return decode(reinterpret_cast<const uchar*>(data.constData()),
+                  data.size(), tabs, epoch);
+}
+
+QByteArray PlaylistStore::encode(const QList<Tab> &tabs, quint32 epoch)
+{
+    QByteArray tabTable;
+    QByteArray itemTable;
+    QByteArray strings;
+    quint32 itemCount = 0;
+
+    for (const Tab &tab : tabs) {
+        QSharedPointer<Playlist> playlist = tab.playlist;
+        quint32 firstItem = itemCount;
+        auto itemWriter = [&](QSharedPointer<Item> item) {
+            itemTable.append(item->uuid().toRfc4122());
+            putString(itemTable, strings, item->url().toEncoded());
+            // Metadata nobody looked at since loading goes back out as is.
+            putString(itemTable, strings, item->packedMetadata());
+            itemCount++;
+        };
+        playlist->iterateItems(itemWriter);
+
+        tabTable.append(playlist->uuid().toRfc4122());
+        tabTable.append(tab.nowPlaying.toRfc4122());
+        putString(tabTable, strings, playlist->title().toUtf8());
+        putU32(tabTable, playlist->shuffle() ? tabShuffleFlag : 0);
+        putU32(tabTable, firstItem);
+        putU32(tabTable, itemCount - firstItem);
+        putU32(tabTable, 0);
+    }
+
+    QByteArray out;
+    out.reserve(headerSize + tabTable.size() + itemTable.size()
+                + strings.size());
+    out.append(storeMagic, 4);
+    putU32(out, storeVersion);
+    putU32(out, tabs.count());
+    putU32(out, itemCount);
+    putU32(out, headerSize);
+    putU32(out, headerSize + tabTable.size());
+    putU32(out, headerSize + tabTable.size() + itemTable.size());
+    putU32(out, strings.size());
+    putU32(out, epoch);
+    out.append(tabTable);
+    out.append(itemTable);
+    out.append(strings);
+    return out;
+}
+
+bool PlaylistStore::decode(const uchar *data, qint64 size, QList<Tab> &tabs,
+                           quint32 *epoch)
+{
+    if (size < headerSize || memcmp(data, storeMagic, 4)
+            || getU32(data + 4) != storeVersion)
+        return false;
+    quint64 tabCount = getU32(data + 8);
+    quint64 itemCount = getU32(data + 12);
+    quint64 tabOffset = getU32(data + 16);
+    quint64 itemOffset = getU32(data + 20);
+    quint64 stringOffset = getU32(data + 24);
+    quint64 stringSize = getU32(data + 28);
+    if (tabOffset + tabCount * tabRecordSize > quint64(size)
+            || itemOffset + itemCount * itemRecordSize > quint64(size)
+            || stringOffset + stringSize > quint64(size))
+        return false;
+    const uchar *strings = data + stringOffset;
+    auto validString = [stringSize](const uchar *record) {
+        return quint64(getU32(record)) + getU32(record + 4) <= stringSize;
+    };
+    auto bytesOf = [strings](const uchar *record) {
+        return QByteArray::fromRawData(
+                    reinterpret_cast<const char*>(strings + getU32(record)),
+                    getU32(record + 4));
+    };
+
+    // Items only go into the collection once the whole file has decoded, so
+    // that a file that turns out to be bad partway leaves nothing behind.
+    QList<Tab> decoded;
+    QList<QSharedPointer<Item>> restored;
+    for (quint64 t = 0; t < tabCount; t++) {
+        const uchar *record = data + tabOffset + t * tabRecordSize;
+        quint64 firstItem = getU32(record + 44);
+        quint64 count = getU32(record + 48);
+        if (!validString(record + 32) || firstItem + count > itemCount)
+            return false;
+
+        QSharedPointer<Playlist> playlist(
+                    new Playlist(QString::fromUtf8(bytesOf(record + 32))));
+        playlist->setUuid(getUuid(record));
+        playlist->setShuffle(getU32(record + 40) & tabShuffleFlag);
+
+        QList<QSharedPointer<Item>> items;
+        items.reserve(count);
+        for (quint64 i = firstItem; i < firstItem + count; i++) {
+            const uchar *itemRecord = data + itemOffset + i * itemRecordSize;
+            if (!validString(itemRecord + 16) || !validString(itemRecord + 24))
+                return false;
+            auto item = QSharedPointer<Item>::create(
+                        getUuid(itemRecord),
+                        QUrl::fromEncoded(bytesOf(itemRecord + 16)));
+            // The mapping goes away once loading is done, so the bytes are
+            // copied, but decoding them waits until they're wanted.
+            if (getU32(itemRecord + 28) > 0) {
+                QByteArray metadata = bytesOf(itemRecord + 24);
+                metadata.detach();
+                item->setPackedMetadata(metadata);
+            }
+            items.append(item);
+        }
+        playlist->addItems(QUuid(), items);
+        restored.append(items);
+
+        Tab tab;
+        tab.playlist = playlist;
+        tab.nowPlaying = getUuid(record + 16);
+        decoded.append(tab);
+    }
+    for (const QSharedPointer<Item> &item : restored)
+        ItemCollection::getSingleton()->storeItem(item);
+    tabs = decoded;
+    if (epoch)
+        *epoch = getU32(data + 32);
+    return true;
+}
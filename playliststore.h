@@ -0,0 +1,44 @@
+#ifndef PLAYLISTSTORE_H
+#define PLAYLISTSTORE_H
+// A binary file format for saved playlists.  The file is mapped and items
+// are built straight from it, without going through json and QVariants.
+// Their metadata stays packed until something asks for it.
+//
+// Layout, all integers little endian:
+//   header     magic "MPQP", version, tab count, item count, the offsets
+//              of the tab table, item table and string table, and the epoch
+//              that PlaylistJournal uses to tell which store it belongs to
+//   tab table  per tab: uuid, now playing uuid, title, shuffle flag, and the
+//              range of the item table it owns
+//   item table per item: uuid, url, metadata
+//   strings    utf-8 titles, encoded urls, and QDataStream'd metadata maps,
+//              referred to by offset and length from the tables above
+
+#include <QList>
+#include <QMetaType>
+#include <QSharedPointer>
+#include <QString>
+#include <QUuid>
+
+class Playlist;
+
+class PlaylistStore {
+public:
+    struct Tab {
+        QSharedPointer<Playlist> playlist;
+        QUuid nowPlaying;
+    };
+
+    static bool save(const QString &fileName, const QList<Tab> &tabs,
+                     quint32 epoch = 0);
+    static bool load(const QString &fileName, QList<Tab> &tabs,
+                     quint32 *epoch = nullptr);
+
+    static QByteArray encode(const QList<Tab> &tabs, quint32 epoch = 0);
+    static bool decode(const uchar *data, qint64 size, QList<Tab> &tabs,
+                       quint32 *epoch = nullptr);
+};
+
+Q_DECLARE_METATYPE(PlaylistStore::Tab)
+
+#endif // PLAYLISTSTORE_H
@@ -5,11 +5,14 @@
 #include <QMimeData>
 #include <QInputDialog>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMenu>
 #include <QThread>
 #include "playlistwindow.h"
 #include "ui_playlistwindow.h"
 #include "drawnplaylist.h"
+#include "livefolders.h"
+#include "mediaprober.h"
 #include "playlist.h"
 #include "platform/unify.h"
 
@@ -21,6 +24,7 @@ PlaylistWindow::PlaylistWindow(QWidget *parent) :
     randomGenerator(randomDevice())
 {
     clipboard = new PlaylistSelection;
+    liveFolders = new LiveFolders(this);
 
     ui->setupUi(this);
     setObjectName("playlistWindow");
@@ -37,6 +41,11 @@ PlaylistWindow::PlaylistWindow(QWidget *parent) :
 
 PlaylistWindow::~PlaylistWindow()
 {
+    for (PlaylistImporter *importer : importers)
+        importer->cancel();
+    for (PlaylistImporter *importer : importers)
+        importer->wait();
+    qDeleteAll(importers);
     delete ui;
     delete clipboard;
 }
@@ -60,13 +69,8 @@ void PlaylistWindow::clearPlaylist(QUuid what)
 QPair<QUuid, QUuid> PlaylistWindow::addToPlaylist(const QUuid &playlist, const QList<QUrl> &what)
 {
     QList<QUrl> filtered = Helpers::filterUrls(what);
-    QPair<QUuid, QUuid> info;
     auto qdp = widgets.contains(playlist) ? widgets.value(playlist) : widgets[QUuid()];
-    for (QUrl &url : filtered) {
-        QPair<QUuid,QUuid> itemInfo = qdp->importUrl(url);
-        if (info.second.isNull())
-            info = itemInfo;
-    }
+    QPair<QUuid, QUuid> info = qdp->importUrls(filtered);
     updatePlaylistHasItems();
     return info;
 }
@@ -115,8 +119,11 @@ QPair<QUuid,QUuid> PlaylistWindow::getItemAfter(QUuid list, QUuid item)
         return { QUuid(), QUuid() };
     auto qpl = PlaylistCollection::getSingleton()->queuePlaylist();
     QPair<QUuid, QUuid> next = qpl->takeFirst();
-    if (!next.second.isNull())
+    if (!next.second.isNull()) {
+        // It's already out of the queue, so this only takes it off the view.
+        queueWidget->removeItem(next.second);
         return next;
+    }
     QSharedPointer<Item> after;
     if (pl->shuffle() && !pl->isEmpty()) {
         std::uniform_int_distribution<> itemDistribution(0, pl->count()-1);
@@ -165,10 +172,9 @@ void PlaylistWindow::setMetadata(QUuid list, QUuid item, const QVariantMap &map)
     auto pl = PlaylistCollection::getSingleton()->playlistOf(list);
     if (!pl)
         return;
-    auto i = pl->itemOf(item);
-    if (!i)
+    if (!pl->contains(item))
         return;
-    i->setMetadata(map);
+    pl->setItemMetadata(item, map);
 
     auto qdp = currentPlaylistWidget();
     if (qdp->uuid() == list)
@@ -250,19 +256,52 @@ void PlaylistWindow::tabsFromVList(const QVariantList &qvl)
         auto qdp = new DrawnPlaylist();
         qdp->setDisplayParser(&displayParser);
         qdp->fromVMap(v.toMap());
-        connect(qdp, &DrawnPlaylist::itemDesired,
-                this, &PlaylistWindow::itemDesired);
-        connect(qdp, &DrawnPlaylist::contextMenuRequested,
-                this, &PlaylistWindow::playlist_contextMenuRequested);
-        auto pl = PlaylistCollection::getSingleton()->playlistOf(qdp->uuid());
-        ui->tabWidget->addTab(qdp, pl->title());
-        widgets.insert(pl->uuid(), qdp);
+        addRestoredTab(qdp);
     }
     if (widgets.count() < 1)
         addNewTab(QUuid(), tr("Quick Playlist"));
     updatePlaylistHasItems();
 }
 
+QList<PlaylistStore::Tab> PlaylistWindow::tabsToStore() const
+{
+    QList<PlaylistStore::Tab> tabs;
+    for (int i = 0; i < ui->tabWidget->count(); i++) {
+        auto widget = reinterpret_cast<DrawnPlaylist *>(ui->tabWidget->widget(i));
+        PlaylistStore::Tab tab;
+        tab.playlist = widget->playlist();
+        tab.nowPlaying = widget->nowPlayingItem();
+        if (tab.playlist)
+            tabs.append(tab);
+    }
+    return tabs;
+}
+
+void PlaylistWindow::tabsFromStore(const QList<PlaylistStore::Tab> &tabs)
+{
+    ui->tabWidget->clear();
+    widgets.clear();
+    for (const PlaylistStore::Tab &tab : tabs) {
+        auto qdp = new DrawnPlaylist();
+        qdp->setDisplayParser(&displayParser);
+        qdp->fromPlaylist(tab.playlist, tab.nowPlaying);
+        addRestoredTab(qdp);
+    }
+    if (widgets.count() < 1)
+        addNewTab(QUuid(), tr("Quick Playlist"));
+    updatePlaylistHasItems();
+}
+
+QVariantMap PlaylistWindow::liveFoldersToVMap() const
+{
+    return liveFolders->toVMap();
+}
+
+void PlaylistWindow::liveFoldersFromVMap(const QVariantMap &qvm)
+{
+    liveFolders->fromVMap(qvm);
+}
+
 bool PlaylistWindow::eventFilter(QObject *obj, QEvent *event)
 {
     Q_UNUSED(obj);
@@ -325,6 +364,15 @@ void PlaylistWindow::connectSignalsToSlots()
     connect(this->toggleViewAction(), &QAction::toggled,
             this, &PlaylistWindow::viewActionChanged);
 
+    connect(MediaProber::getSingleton().data(), &MediaProber::probed,
+            this, &PlaylistWindow::prober_probed);
+    connect(liveFolders, &LiveFolders::itemsAdded,
+            this, &PlaylistWindow::liveFolders_itemsAdded);
+    connect(liveFolders, &LiveFolders::itemsRemoved,
+            this, &PlaylistWindow::liveFolders_itemsRemoved);
+    connect(liveFolders, &LiveFolders::itemsRenamed,
+            this, &PlaylistWindow::liveFolders_itemsRenamed);
+
     connect(ui->newTab, &QPushButton::clicked,
             this, &PlaylistWindow::newTab);
     connect(ui->closeTab, &QPushButton::clicked,
@@ -355,6 +403,12 @@ void PlaylistWindow::updateCurrentPlaylist()
     setTabOrder(ui->tabWidget->focusProxy(), qdp);
     setTabOrder(qdp, ui->searchField);
     updatePlaylistHasItems();
+
+    // Whatever is shown comes first, then the rest of the playlist.
+    if (auto pl = qdp->playlist()) {
+        qdp->probeVisibleItems();
+        MediaProber::getSingleton()->sweep(pl);
+    }
 }
 
 void PlaylistWindow::updatePlaylistHasItems()
@@ -386,6 +440,41 @@ void PlaylistWindow::addNewTab(QUuid playlist, QString title)
     ui->tabWidget->setCurrentWidget(qdp);
 }
 
+void PlaylistWindow::addRestoredTab(DrawnPlaylist *qdp)
+{
+    connect(qdp, &DrawnPlaylist::itemDesired,
+            this, &PlaylistWindow::itemDesired);
+    connect(qdp, &DrawnPlaylist::contextMenuRequested,
+            this, &PlaylistWindow::playlist_contextMenuRequested);
+    auto pl = PlaylistCollection::getSingleton()->playlistOf(qdp->uuid());
+    ui->tabWidget->addTab(qdp, pl->title());
+    widgets.insert(pl->uuid(), qdp);
+}
+
+void PlaylistWindow::importEntries(PlaylistImporter *importer,
+                                   const QUuid &playlist,
+                                   const QList<PlaylistReader::Entry> &entries)
+{
+    // The tab may have been closed while it was being filled.
+    DrawnPlaylist *qdp = widgets.value(playlist);
+    if (!qdp) {
+        importer->cancel();
+        importer->batchTaken();
+        return;
+    }
+    QList<QUrl> urls;
+    QList<QVariantMap> metadata;
+    urls.reserve(entries.count());
+    metadata.reserve(entries.count());
+    for (const PlaylistReader::Entry &entry : entries) {
+        urls.append(entry.url);
+        metadata.append(entry.metadata);
+    }
+    qdp->importUrls(urls, metadata);
+    updatePlaylistHasItems();
+    importer->batchTaken();
+}
+
 void PlaylistWindow::addQuickQueue()
 {
     queueWidget = new DrawnQueue();
@@ -430,12 +519,24 @@ void PlaylistWindow::changePlaylistSelection( QUrl itemUrl, QUuid playlistUuid,
     }
 }
 
-void PlaylistWindow::addSimplePlaylist(QStringList data)
+void PlaylistWindow::addPlaylistFile(const QString &fileName)
 {
-
+    // The file is read in the background, and the tab fills up as it goes.
     auto pl = PlaylistCollection::getSingleton()->newPlaylist(tr("New Playlist"));
-    pl->fromStringList(data);
     addNewTab(pl->uuid(), pl->title());
+
+    auto importer = new PlaylistImporter(fileName, pl->uuid());
+    connect(importer, &PlaylistImporter::entriesRead,
+            this, [this, importer](QUuid playlist, QList<PlaylistReader::Entry> entries) {
+        importEntries(importer, playlist, entries);
+    });
+    connect(importer, &PlaylistImporter::finished,
+            this, [this, importer]() {
+        importers.removeOne(importer);
+        importer->deleteLater();
+    });
+    importers.append(importer);
+    importer->start();
 }
 
 void PlaylistWindow::setDisplayFormatSpecifier(QString fmt)
@@ -459,6 +560,21 @@ void PlaylistWindow::newTab()
     addNewTab(pl->uuid(), pl->title());
 }
 
+void PlaylistWindow::newFolderTab()
+{
+    QString dir = QFileDialog::getExistingDirectory(this, tr("Follow Folder"));
+    if (dir.isEmpty())
+        return;
+    QString title = QFileInfo(dir).fileName();
+    if (title.isEmpty())
+        title = tr("New Playlist");
+
+    // The tab fills up as the folder is walked, and keeps up with it after.
+    auto pl = PlaylistCollection::getSingleton()->newPlaylist(title.replace("&","+"));
+    addNewTab(pl->uuid(), pl->title());
+    liveFolders->bind(pl->uuid(), { dir });
+}
+
 void PlaylistWindow::closeTab()
 {
     int index = ui->tabWidget->currentIndex();
@@ -477,9 +593,9 @@ void PlaylistWindow::importTab()
 {
     QString file;
     file = QFileDialog::getOpenFileName(this, tr("Import File"), QString(),
-                                        tr("Playlist files (*.m3u *.m3u8)"));
+                                        tr("Playlist files (*.m3u *.m3u8 *.pls *.cue)"));
     if (!file.isEmpty())
-        emit importPlaylist(file);
+        addPlaylistFile(file);
 }
 
 void PlaylistWindow::exportTab()
@@ -675,9 +791,16 @@ void PlaylistWindow::savePlaylist(const QUuid &playlistUuid)
 {
     QString file;
     file = QFileDialog::getSaveFileName(this, tr("Export File"), QString(),
-                                        tr("Playlist files (*.m3u *.m3u8)"));
+                                        tr("Playlist files (*.m3u *.m3u8);;"
+                                           "Playlist data (*.json)"));
     auto pl = PlaylistCollection::getSingleton()->playlistOf(playlistUuid);
-    if (!file.isEmpty() && pl)
+    if (file.isEmpty() || !pl)
+        return;
+    // The json export is the same form the playlists used to be saved in.
+    auto qdp = widgets.value(playlistUuid, nullptr);
+    if (qdp && file.endsWith(".json", Qt::CaseInsensitive))
+        emit exportPlaylistData(file, qdp->toVMap());
+    else
         emit exportPlaylist(file, pl->toStringList());
 }
 
@@ -853,6 +976,19 @@ void PlaylistWindow::playlist_contextMenuRequested(const QPoint &p, const QUuid
     });
     m->addAction(a);
 
+    a = new QAction(m);
+    a->setText(tr("Make Thumbnail Sheets"));
+    connect(a, &QAction::triggered,
+            this, [this,listWidget]() {
+        auto pl = listWidget->playlist();
+        QList<QUrl> urls;
+        listWidget->traverseSelected([&pl,&urls](QUuid itemUuid) {
+            urls.append(pl->itemOf(itemUuid)->url());
+        });
+        emit thumbnailSheetsRequested(urls);
+    });
+    m->addAction(a);
+
     m->addSeparator();
 
     a = new QAction(m);
@@ -919,6 +1055,64 @@ void PlaylistWindow::playlist_contextMenuRequested(const QPoint &p, const QUuid
     m->exec(listWidget->mapToGlobal(p));
 }
 
+void PlaylistWindow::liveFolders_itemsAdded(QUuid playlist, QUuid after, QList<QUuid> items)
+{
+    DrawnPlaylist *qdp = widgets.value(playlist);
+    if (!qdp)
+        return;
+    if (after.isNull())
+        qdp->addItems(items);
+    else
+        qdp->addItemsAfter(after, items);
+    updatePlaylistHasItems();
+}
+
+void PlaylistWindow::liveFolders_itemsRemoved(QUuid playlist, QList<QUuid> items)
+{
+    // They're already out of the playlist (and the queue), so this only
+    // takes them out of the views.
+    DrawnPlaylist *qdp = widgets.value(playlist);
+    for (const QUuid &uuid : items) {
+        if (qdp)
+            qdp->removeItem(uuid);
+        queueWidget->removeItem(uuid);
+    }
+    updatePlaylistHasItems();
+}
+
+void PlaylistWindow::prober_probed(QUuid playlist, MediaProber::Results metadata)
+{
+    auto pl = PlaylistCollection::getSingleton()->playlistOf(playlist);
+    if (!pl)
+        return;
+    MediaProber::Results changed;
+    for (auto it = metadata.begin(); it != metadata.end(); ++it) {
+        auto i = pl->itemOf(it.key());
+        if (!i)
+            continue;
+        // Tags from playing the file or from a playlist file win over probed
+        // ones.
+        QVariantMap existing = i->metadata();
+        for (auto e = existing.constBegin(); e != existing.constEnd(); ++e)
+            it.value().insert(e.key(), e.value());
+        if (it.value() != existing)
+            changed.insert(it.key(), it.value());
+    }
+    if (changed.isEmpty())
+        return;
+    pl->setProbedMetadata(changed);
+    if (DrawnPlaylist *qdp = widgets.value(playlist))
+        qdp->viewport()->update();
+}
+
+void PlaylistWindow::liveFolders_itemsRenamed(QUuid playlist, QList<QUuid> items)
+{
+    Q_UNUSED(items);
+    if (DrawnPlaylist *qdp = widgets.value(playlist))
+        qdp->viewport()->update();
+    queueWidget->viewport()->update();
+}
+
 void PlaylistWindow::on_tabWidget_tabCloseRequested(int index)
 {
     int current = ui->tabWidget->currentIndex();
@@ -928,6 +1122,8 @@ void PlaylistWindow::on_tabWidget_tabCloseRequested(int index)
     if (qdp->uuid().isNull()) {
         qdp->removeAll();
     } else {
+        liveFolders->unbind(qdp->uuid());
+        MediaProber::getSingleton()->forget(qdp->uuid());
         PlaylistCollection::getSingleton()->removePlaylist(qdp->uuid());
         widgets.remove(qdp->uuid());
         ui->tabWidget->removeTab(index);
@@ -964,6 +1160,7 @@ void PlaylistWindow::on_tabWidget_customContextMenuRequested(const QPoint &pos)
 {
     QMenu *m = new QMenu(this);
     m->addAction(tr("&New Playlist"), this, SLOT(newTab()));
+    m->addAction(tr("New &Folder Playlist"), this, SLOT(newFolderTab()));
     m->addAction(tr("&Remove Playlist"), this, SLOT(closeTab()));
     m->addAction(tr("&Duplicate Playlist"), this, SLOT(duplicateTab()));
     m->addAction(tr("&Import Playlist"), this, SLOT(importTab()));
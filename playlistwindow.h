@@ -6,12 +6,16 @@
 #include <QUuid>
 #include <random>
 #include "helpers.h"
+#include "playliststore.h"
+#include "mediaprober.h"
+#include "playlistreader.h"
 
 namespace Ui {
 class PlaylistWindow;
 }
 
 class DrawnPlaylist;
+class LiveFolders;
 class PlaylistSelection;
 class QThread;
 class PlaylistSearcher;
@@ -43,6 +47,10 @@ public:
 
     QVariantList tabsToVList() const;
     void tabsFromVList(const QVariantList &qvl);
+    QList<PlaylistStore::Tab> tabsToStore() const;
+    void tabsFromStore(const QList<PlaylistStore::Tab> &tabs);
+    QVariantMap liveFoldersToVMap() const;
+    void liveFoldersFromVMap(const QVariantMap &qvm);
 
 protected:
     bool eventFilter(QObject *obj, QEvent *event);
@@ -60,19 +68,23 @@ private:
     void updatePlaylistHasItems();
     void setPlaylistFilters(QString filterText);
     void addNewTab(QUuid playlist, QString title);
+    void addRestoredTab(DrawnPlaylist *qdp);
     void addQuickQueue();
+    void importEntries(PlaylistImporter *importer, const QUuid &playlist,
+                       const QList<PlaylistReader::Entry> &entries);
 
 signals:
     void windowDocked();
     void viewActionChanged(bool visible);
     void currentPlaylistHasItems(bool yes);
     void itemDesired(QUuid playlistUuid, QUuid itemUuid);
-    void importPlaylist(QString fname);
     void exportPlaylist(QString fname, QStringList items);
+    void exportPlaylistData(QString fname, QVariantMap data);
     void quickQueueMode(bool yes);
     void playlistAddItem(QUuid playlistUUid);
     void playlistShuffleChanged(QUuid playlistUuid, bool shuffle);
     void hideFullscreenChanged(bool checked);
+    void thumbnailSheetsRequested(QList<QUrl> urls);
 
 public slots:
     void setIconTheme(IconThemer::FolderMode mode, const QString &fallback, const QString &custom);
@@ -80,10 +92,11 @@ public slots:
 
     bool activateItem(QUuid playlistUuid, QUuid itemUuid);
     void changePlaylistSelection(QUrl itemUrl, QUuid playlistUuid, QUuid itemUuid);
-    void addSimplePlaylist(QStringList data);
+    void addPlaylistFile(const QString &fileName);
     void setDisplayFormatSpecifier(QString fmt);
 
     void newTab();
+    void newFolderTab();
     void closeTab();
     void duplicateTab();
     void importTab();
@@ -127,6 +140,10 @@ private slots:
     void playlist_copySelectionToClipboard(const QUuid &playlistUuid);
     void playlist_hideOnFullscreenToggled(bool checked);
     void playlist_contextMenuRequested(const QPoint &p, const QUuid &playlistUuid, const QUuid &itemUuid);
+    void liveFolders_itemsAdded(QUuid playlist, QUuid after, QList<QUuid> items);
+    void liveFolders_itemsRemoved(QUuid playlist, QList<QUuid> items);
+    void liveFolders_itemsRenamed(QUuid playlist, QList<QUuid> items);
+    void prober_probed(QUuid playlist, MediaProber::Results metadata);
 
     void on_tabWidget_tabCloseRequested(int index);
 
@@ -149,6 +166,8 @@ private:
     bool hideFullscreen = false;
 
     QHash<QUuid, DrawnPlaylist*> widgets;
+    QList<PlaylistImporter*> importers;
+    LiveFolders *liveFolders = nullptr;
     DrawnPlaylist* queueWidget = nullptr;
     PlaylistSelection *clipboard = nullptr;
     std::random_device randomDevice;
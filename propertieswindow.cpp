@@ -176,6 +176,22 @@ void PropertiesWindow::setChapters(const QVariantList &chapters)
     updateLastTab();
 }
 
+void PropertiesWindow::setMediaInfo(const MediaInfo &info)
+{
+    // What was known from before, until mpv has opened the file and tells
+    // the rest.
+    if (info.duration > 0)
+        setMediaLength(info.duration);
+    if (info.videoSize.isValid())
+        setVideoSize(info.videoSize);
+    if (!info.tracks.isEmpty())
+        setTracks(info.tracks);
+    if (!info.chapters.isEmpty())
+        setChapters(info.chapters);
+    if (!info.metadata.isEmpty())
+        setMetaData(info.metadata);
+}
+
 void PropertiesWindow::updateSaveVisibility()
 {
     ui->save->setVisible(ui->tabWidget->currentIndex()==2
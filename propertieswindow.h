@@ -5,6 +5,7 @@
 #include <QDialog>
 #include <QVariantList>
 #include <QVariantMap>
+#include "mediainfocache.h"
 
 namespace Ui {
 class PropertiesWindow;
@@ -30,6 +31,7 @@ public slots:
     void setFilePath(const QString &path);
     void setMetaData(QVariantMap data);
     void setChapters(const QVariantList &chapters);
+    void setMediaInfo(const MediaInfo &info);
 
 private slots:
     void on_save_clicked();
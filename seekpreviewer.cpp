@@ -0,0 +1,293 @@
+#include <QElapsedTimer>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
+#include <mpv/client.h>
+#include <mpv/render_gl.h>
+#include "logger.h"
+#include "mpvwidget.h"
+#include "seekpreviewer.h"
+
+static const char logModule[] = "seekpreview";
+
+// The box frames are fitted into, in pixels.
+constexpr int previewWidth = 160;
+constexpr int previewHeight = 90;
+// Roughly how much the frames may take up, in bytes.
+constexpr int maxFramesCost = 12 * 1024 * 1024;
+// Buckets are no shorter than this, in seconds.
+constexpr double minBucketLength = 5.0;
+// Nor are there more of them than fit in the budget together, so that the
+// later passes do not evict the frames the earlier ones made.
+constexpr int maxBuckets = maxFramesCost / (previewWidth * previewHeight * 4);
+// The first pass visits every this many buckets, and each pass after it
+// fills in halfway between.
+constexpr int coarsestStride = 16;
+// Give up on a file that takes longer than this to open, or on a seek that
+// takes longer than this to show a frame.
+constexpr int openTimeout = 10000;
+constexpr int seekTimeout = 5000;
+// How long to wait on mpv at a time before looking for cancellation, in
+// seconds.
+constexpr double waitSlice = 0.1;
+
+SeekPreviewer::SeekPreviewer(QObject *parent) : QObject(parent)
+{
+    frames.setMaxCost(maxFramesCost);
+    pool.setMaxThreadCount(1);
+    surface = new QOffscreenSurface();
+    surface->create();
+}
+
+SeekPreviewer::~SeekPreviewer()
+{
+    close();
+    pool.waitForDone();
+    delete surface;
+}
+
+void SeekPreviewer::open(const QUrl &url)
+{
+    int job;
+    {
+        QMutexLocker locker(&lock);
+        job = ++currentJob;
+        frames.clear();
+        bucketLength = 0;
+        bucketCount = 0;
+    }
+    if (!url.isLocalFile())
+        return;
+    // The pool has one thread, so this starts once the last job has seen
+    // that it was cancelled.
+    QtConcurrent::run(&pool, this, &SeekPreviewer::serve, job, url);
+}
+
+void SeekPreviewer::close()
+{
+    QMutexLocker locker(&lock);
+    ++currentJob;
+    frames.clear();
+    bucketLength = 0;
+    bucketCount = 0;
+}
+
+QImage SeekPreviewer::frameAt(double time)
+{
+    QMutexLocker locker(&lock);
+    if (bucketCount <= 0)
+        return QImage();
+    int bucket = qBound(0, int(time / bucketLength), bucketCount - 1);
+    for (int d = 0; d < bucketCount; d++) {
+        if (QImage *image = frames.object(bucket - d))
+            return *image;
+        if (QImage *image = frames.object(bucket + d))
+            return *image;
+    }
+    return QImage();
+}
+
+void SeekPreviewer::serve(int job, QUrl url)
+{
+    QThread::currentThread()->setPriority(QThread::IdlePriority);
+    if (isCancelled(job))
+        return;
+
+    QOpenGLContext gl;
+    gl.setFormat(surface->format());
+    if (!gl.create() || !gl.makeCurrent(surface)) {
+        Logger::log(logModule, "could not make an offscreen context");
+        return;
+    }
+
+    Renderer r;
+    r.mpv = createHandle();
+    if (!r.mpv) {
+        gl.doneCurrent();
+        return;
+    }
+    mpv_opengl_init_params glInit { &MpvGlWidget::get_proc_address, nullptr, nullptr };
+    mpv_render_param params[] {
+        { MPV_RENDER_PARAM_API_TYPE, const_cast<char*>(MPV_RENDER_API_TYPE_OPENGL) },
+        { MPV_RENDER_PARAM_OPENGL_INIT_PARAMS, &glInit },
+        { MPV_RENDER_PARAM_INVALID, nullptr }
+    };
+    if (mpv_render_context_create(&r.render, r.mpv, params) >= 0) {
+        mpv_render_context_set_update_callback(r.render, render_update, &r);
+        QByteArray file = url.toLocalFile().toUtf8();
+        const char *load[] = { "loadfile", file.constData(), nullptr };
+        if (mpv_command(r.mpv, load) >= 0)
+            extract(job, r);
+        // The render context goes before the handle, and while the gl
+        // context is still current.
+        delete r.fbo;
+        mpv_render_context_free(r.render);
+    } else {
+        Logger::log(logModule, "could not make a render context");
+    }
+    mpv_terminate_destroy(r.mpv);
+    gl.doneCurrent();
+}
+
+bool SeekPreviewer::isCancelled(int job)
+{
+    QMutexLocker locker(&lock);
+    return job != currentJob;
+}
+
+void SeekPreviewer::extract(int job, Renderer &r)
+{
+    QElapsedTimer timer;
+    timer.start();
+    bool loaded = false;
+    while (!loaded) {
+        if (isCancelled(job) || timer.elapsed() > openTimeout)
+            return;
+        mpv_event *event = mpv_wait_event(r.mpv, waitSlice);
+        switch (event->event_id) {
+        case MPV_EVENT_FILE_LOADED:
+            loaded = true;
+            break;
+        case MPV_EVENT_END_FILE:
+        case MPV_EVENT_SHUTDOWN:
+            return;
+        default:
+            break;
+        }
+    }
+
+    // Files without pictures, or without a length, have nothing to show.
+    double duration = 0;
+    mpv_get_property(r.mpv, "duration", MPV_FORMAT_DOUBLE, &duration);
+    char *vid = mpv_get_property_string(r.mpv, "vid");
+    bool hasVideo = vid && strcmp(vid, "no");
+    mpv_free(vid);
+    if (duration <= 0 || !hasVideo)
+        return;
+
+    int count = qBound(1, int(duration / minBucketLength), maxBuckets);
+    double length = duration / count;
+    {
+        QMutexLocker locker(&lock);
+        if (job != currentJob)
+            return;
+        bucketCount = count;
+        bucketLength = length;
+    }
+
+    for (int stride = coarsestStride; stride >= 1; stride /= 2) {
+        for (int bucket = 0; bucket < count; bucket += stride) {
+            if (stride < coarsestStride && bucket % (stride * 2) == 0)
+                continue;
+            double time = (bucket + 0.5) * length;
+            QByteArray where = QByteArray::number(time);
+            const char *seek[] = { "seek", where.constData(), "absolute+keyframes", nullptr };
+            r.frameDue = false;
+            if (mpv_command(r.mpv, seek) < 0 || !waitForFrame(job, r))
+                return;
+            QImage image = renderFrame(r);
+            if (image.isNull())
+                continue;
+
+            QMutexLocker locker(&lock);
+            if (job != currentJob)
+                return;
+            frames.insert(bucket, new QImage(image),
+                          image.bytesPerLine() * image.height());
+            locker.unlock();
+            emit frameReady(time);
+        }
+    }
+}
+
+bool SeekPreviewer::waitForFrame(int job, Renderer &r)
+{
+    // A frame counts once the seek has finished, whichever of the two mpv
+    // gets around to telling us about first.
+    QElapsedTimer timer;
+    timer.start();
+    bool restarted = false;
+    while (timer.elapsed() < seekTimeout) {
+        if (isCancelled(job))
+            return false;
+        if (restarted && r.frameDue.exchange(false)
+                && (mpv_render_context_update(r.render) & MPV_RENDER_UPDATE_FRAME))
+            return true;
+        mpv_event *event = mpv_wait_event(r.mpv, waitSlice);
+        switch (event->event_id) {
+        case MPV_EVENT_PLAYBACK_RESTART:
+            restarted = true;
+            break;
+        case MPV_EVENT_END_FILE:
+        case MPV_EVENT_SHUTDOWN:
+            return false;
+        default:
+            break;
+        }
+    }
+    Logger::log(logModule, "gave up waiting for a frame");
+    return false;
+}
+
+QImage SeekPreviewer::renderFrame(Renderer &r)
+{
+    if (!r.fbo) {
+        int64_t w = 0, h = 0;
+        mpv_get_property(r.mpv, "dwidth", MPV_FORMAT_INT64, &w);
+        mpv_get_property(r.mpv, "dheight", MPV_FORMAT_INT64, &h);
+        if (w <= 0 || h <= 0)
+            return QImage();
+        int width = previewWidth;
+        int height = std::max(1, int(previewWidth * h / w));
+        if (height > previewHeight) {
+            width = std::max(1, int(previewHeight * w / h));
+            height = previewHeight;
+        }
+        r.fbo = new QOpenGLFramebufferObject(width, height);
+    }
+    mpv_opengl_fbo target { static_cast<int>(r.fbo->handle()),
+                            r.fbo->width(), r.fbo->height(), 0 };
+    int flip = 1;
+    int block = 0;
+    mpv_render_param params[] {
+        { MPV_RENDER_PARAM_OPENGL_FBO, &target },
+        { MPV_RENDER_PARAM_FLIP_Y, &flip },
+        { MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME, &block },
+        { MPV_RENDER_PARAM_INVALID, nullptr }
+    };
+    mpv_render_context_render(r.render, params);
+    return r.fbo->toImage();
+}
+
+mpv_handle *SeekPreviewer::createHandle()
+{
+    mpv_handle *mpv = mpv_create();
+    if (!mpv)
+        return nullptr;
+    // Keyframe seeks only, and nothing decoded that won't be looked at.
+    static const char *options[][2] = {
+        { "config", "no" }, { "load-scripts", "no" }, { "ytdl", "no" },
+        { "terminal", "no" }, { "msg-level", "all=no" },
+        { "vo", "libmpv" }, { "ao", "null" }, { "aid", "no" }, { "sid", "no" },
+        { "hr-seek", "no" }, { "osd-level", "0" },
+        { "idle", "yes" }, { "pause", "yes" }
+    };
+    for (auto &option : options)
+        mpv_set_option_string(mpv, option[0], option[1]);
+    if (mpv_initialize(mpv) < 0) {
+        mpv_terminate_destroy(mpv);
+        return nullptr;
+    }
+    return mpv;
+}
+
+void SeekPreviewer::render_update(void *ctx)
+{
+    auto r = static_cast<Renderer *>(ctx);
+    r->frameDue = true;
+    mpv_wakeup(r->mpv);
+}
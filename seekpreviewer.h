@@ -0,0 +1,72 @@
+#ifndef SEEKPREVIEWER_H
+#define SEEKPREVIEWER_H
+// Pictures for hovering over the seek bar.  A headless libmpv instance,
+// rendering offscreen much as the thumbnailer does, walks the keyframes of
+// the playing file on an idle priority thread and keeps a small frame for
+// each stretch (bucket) of its length.  Buckets are visited coarse to fine,
+// so the whole length has something to show early on.
+//
+// Frames are held in a least recently used cache by bucket, and looking one
+// up never waits on the extraction.  Opening another file, or closing,
+// cancels whatever is being extracted.
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+#include <QUrl>
+#include <atomic>
+
+struct mpv_handle;
+struct mpv_render_context;
+class QOffscreenSurface;
+class QOpenGLFramebufferObject;
+class SeekPreviewer : public QObject {
+    Q_OBJECT
+public:
+    explicit SeekPreviewer(QObject *parent = nullptr);
+    ~SeekPreviewer();
+
+    // Starts on the frames of url, dropping those of the last file.  Only
+    // local files are looked at.
+    void open(const QUrl &url);
+    // Stops extracting and drops the frames.
+    void close();
+    // The frame of the bucket nearest to time that has one, or nothing.
+    QImage frameAt(double time);
+
+signals:
+    // A frame was added.  Emitted from the extracting thread.
+    void frameReady(double time);
+
+private:
+    struct Renderer {
+        mpv_handle *mpv = nullptr;
+        mpv_render_context *render = nullptr;
+        // Set by the render callback, and taken once the frame is drawn.
+        std::atomic<bool> frameDue { false };
+        // Sized to the video once its first frame is out.
+        QOpenGLFramebufferObject *fbo = nullptr;
+    };
+
+    void serve(int job, QUrl url);
+    bool isCancelled(int job);
+    void extract(int job, Renderer &r);
+    bool waitForFrame(int job, Renderer &r);
+    QImage renderFrame(Renderer &r);
+    static mpv_handle *createHandle();
+    static void render_update(void *ctx);
+
+    QMutex lock;
+    QCache<int, QImage> frames;
+    double bucketLength = 0;
+    int bucketCount = 0;
+    int currentJob = 0;
+    // Made on the gui thread, and shared by the extracting threads.
+    QOffscreenSurface *surface = nullptr;
+    // Declared last, so that it is torn down (and waited on) first.
+    QThreadPool pool;
+};
+
+#endif // SEEKPREVIEWER_H
@@ -5,11 +5,21 @@
 #include <QJsonArray>
 #include <QDir>
 #include <QFileInfo>
+#include <QSaveFile>
 #include <QTextStream>
 #include <QUrl>
+#include <algorithm>
 #include "storage.h"
+#include "logger.h"
+#include "playlistjournal.h"
 #include "platform/unify.h"
 
+static const char logModule[] = "storage";
+
+// The playlist journal is folded into a fresh store once it grows past a
+// quarter of the store's size, but never while it is smaller than this.
+constexpr qint64 minJournalCompaction = 1024 * 1024;
+
 QString Storage::configPath;
 
 Storage::Storage(QObject *parent) :
@@ -53,37 +63,138 @@ QVariantList Storage::readVList(QString name)
     return doc.array().toVariantList();
 }
 
-QStringList Storage::readM3U(const QString &where)
+void Storage::writePlaylists(QString name, const QList<PlaylistStore::Tab> &tabs)
 {
-    QStringList items;
-    QFile file(where);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
-        return QStringList();
-    items = QTextStream(&file).readAll().split("\n");
-    for (int i = 0; i < items.count(); ++i) {
-        items[i] = items[i].trimmed();
-        if (items[i].isEmpty() || items[i].startsWith("#")) {
-            items.removeAt(i);
-            --i;
-        }
+    // The journal is replaced after the store, so that a crash in between
+    // leaves a journal whose epoch no longer matches and is ignored.
+    quint32 epoch = qHash(QUuid::createUuid());
+    QDir dir(configPath);
+    if (!PlaylistStore::save(dir.absoluteFilePath(name + ".bin"), tabs, epoch))
+        return;
+    if (writeFile(dir.absoluteFilePath(name + ".journal"),
+                  PlaylistJournal::header(epoch)))
+        playlistEpochs.insert(name, epoch);
+}
+
+void Storage::writePlaylists(QString name, const QList<PlaylistStore::Tab> &tabs,
+                             const QByteArray &changes)
+{
+    QDir dir(configPath);
+    QFileInfo store(dir.absoluteFilePath(name + ".bin"));
+    QFile journal(dir.absoluteFilePath(name + ".journal"));
+    qint64 limit = std::max(store.size() / 4, minJournalCompaction);
+    if (!playlistEpochs.contains(name) || !store.exists() || !journal.exists()
+            || journal.size() + changes.size() > limit) {
+        writePlaylists(name, tabs);
+        return;
+    }
+    if (!journal.open(QIODevice::WriteOnly | QIODevice::Append)
+            || journal.write(changes) != changes.size()
+            || !journal.flush()) {
+        journal.close();
+        writePlaylists(name, tabs);
+    }
+}
+
+bool Storage::hasPlaylists(QString name)
+{
+    return QFile::exists(QDir(configPath).absoluteFilePath(name + ".bin"));
+}
+
+bool Storage::readPlaylists(QString name, QList<PlaylistStore::Tab> &tabs)
+{
+    QDir dir(configPath);
+    QString fileName = dir.absoluteFilePath(name + ".bin");
+    quint32 epoch = 0;
+    if (!QFile::exists(fileName))
+        return false;
+    if (!PlaylistStore::load(fileName, tabs, &epoch)) {
+        // The next save would write over it, so move it aside for whoever
+        // wants to recover it.
+        QString kept = fileName + ".corrupt";
+        QFile::remove(kept);
+        QFile::rename(fileName, kept);
+        Logger::log(logModule, QString("could not read %1, kept it as %2")
+                    .arg(fileName, kept));
+        return false;
+    }
+    QFile journal(dir.absoluteFilePath(name + ".journal"));
+    if (!epoch || !journal.open(QIODevice::ReadOnly))
+        return true;
+    QByteArray data = journal.readAll();
+    // Anything after a bad record would never be replayed, so a journal
+    // that ends in one isn't appended to, and the next save compacts.
+    if (PlaylistJournal::replay(data, epoch, tabs) == data.size())
+        playlistEpochs.insert(name, epoch);
+    return true;
+}
+
+void Storage::exportVMap(const QString &where, const QVariantMap &qvm)
+{
+    QJsonDocument doc;
+    doc.setObject(QJsonObject::fromVariantMap(qvm));
+    writeFile(where, doc.toJson());
+}
+
+void Storage::writeIndex(QString name, const QByteArray &data)
+{
+    QString fileName = QDir(configPath).absoluteFilePath(name + ".index");
+    if (data.isEmpty()) {
+        QFile::remove(fileName);
+        return;
     }
-    return items;
+    writeFile(fileName, data);
+}
+
+QByteArray Storage::readIndex(QString name)
+{
+    QFile file(QDir(configPath).absoluteFilePath(name + ".index"));
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+void Storage::writeCache(QString name, const QByteArray &data)
+{
+    writeFile(QDir(configPath).absoluteFilePath(name + ".cache"), data);
+}
+
+QByteArray Storage::readCache(QString name)
+{
+    QFile file(QDir(configPath).absoluteFilePath(name + ".cache"));
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
 }
 
 void Storage::writeM3U(const QString &where, QStringList items)
 {
-    QFile file(where);
+    QSaveFile file(where);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
         return;
-    QTextStream(&file) << "#EXTM3U\n\n" << items.join("\n");
+    QTextStream stream(&file);
+    stream << "#EXTM3U\n\n" << items.join("\n");
+    stream.flush();
+    file.commit();
 }
 
 void Storage::writeJsonObject(QString fname, const QJsonDocument &doc)
 {
-    QFile file(QDir(configPath).absoluteFilePath(fname + ".json"));
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
-        return;
-    QTextStream(&file) << doc.toJson();
+    writeFile(QDir(configPath).absoluteFilePath(fname + ".json"), doc.toJson());
+}
+
+bool Storage::writeFile(const QString &fileName, const QByteArray &data)
+{
+    // Written to a temporary file and renamed over the old one, so a crash
+    // midway leaves the previous version intact rather than a truncated one.
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    if (file.write(data) != data.size()) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
 }
 
 QJsonDocument Storage::readJsonObject(QString fname)
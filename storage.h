@@ -2,6 +2,8 @@
 #define STORAGE_H
 
 #include <QObject>
+#include <QHash>
+#include "playliststore.h"
 
 class Storage : public QObject
 {
@@ -16,12 +18,31 @@ public:
     void writeVList(QString name, const QVariantList &qvl);
     QVariantList readVList(QString name);
 
-    QStringList readM3U(const QString &where);
+    // Writes the whole store, then starts an empty journal for it.
+    void writePlaylists(QString name, const QList<PlaylistStore::Tab> &tabs);
+    // Appends changes to the journal, unless it is due for compaction or
+    // there's no store for it to apply to.
+    void writePlaylists(QString name, const QList<PlaylistStore::Tab> &tabs,
+                        const QByteArray &changes);
+    // Whether there is a store to read, good or not.
+    bool hasPlaylists(QString name);
+    // Reads the store and replays its journal.  A store that can't be read
+    // is logged and renamed to name.bin.corrupt.
+    bool readPlaylists(QString name, QList<PlaylistStore::Tab> &tabs);
+    void exportVMap(const QString &where, const QVariantMap &qvm);
+
+    void writeIndex(QString name, const QByteArray &data);
+    QByteArray readIndex(QString name);
+
+    void writeCache(QString name, const QByteArray &data);
+    QByteArray readCache(QString name);
+
     void writeM3U(const QString &where, QStringList items);
 
 private:
     void writeJsonObject(QString fname, const QJsonDocument &doc);
     QJsonDocument readJsonObject(QString fname);
+    bool writeFile(const QString &fileName, const QByteArray &data);
 
 signals:
 
@@ -29,6 +50,8 @@ public slots:
 
 private:
     static QString configPath;
+    // Epoch of each playlist store whose journal can be appended to.
+    QHash<QString, quint32> playlistEpochs;
 };
 
 #endif // STORAGE_H
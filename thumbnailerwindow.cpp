@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <cmath>
 #include <QFileDialog>
 #include <QFont>
 #include <QFontMetrics>
 #include <QOpenGLContext>
+#include <QOpenGLFunctions>
 #include <QPainter>
 #include <QTimer>
 #include "platform/unify.h"
@@ -27,12 +29,17 @@ constexpr int thumbShadow = 4;
 constexpr int timerWaitMsec = 500;
 constexpr int osdFontSize = 12;
 constexpr int osdFontShadow = 2;
+// What the software drawer draws at until the video size is known.
+constexpr int placeholderWidth = 160;
+constexpr int placeholderHeight = 90;
 
 ThumbnailerWindow::ThumbnailerWindow(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::ThumbnailerWindow)
 {
     ui->setupUi(this);
+    ui->instances->setValue(MpvThumbnailer::defaultInstances());
+    ui->softwareRender->setEnabled(MpvSoftwareThumbnailDrawer::isAvailable());
     connect(ui->actionGo, &QPushButton::clicked,
             this, &ThumbnailerWindow::begin);
 
@@ -103,6 +110,9 @@ void ThumbnailerWindow::begin()
     p.imageWidth = ui->imageWidth->value();
     p.cols = ui->layoutColumns->value();
     p.rows = ui->layoutRow->value();
+    p.fastSeek = ui->fastSeek->isChecked();
+    p.instances = ui->instances->value();
+    p.softwareRender = ui->softwareRender->isChecked();
     thumbnailer->execute(p);
 
 }
@@ -115,10 +125,186 @@ MpvThumbnailer::MpvThumbnailer(QObject *parent)
 
 MpvThumbnailer::~MpvThumbnailer()
 {
-    deinitPlayer();
+
+}
+
+int MpvThumbnailer::defaultInstances()
+{
+    return 1;
 }
 
 void MpvThumbnailer::execute(const MpvThumbnailer::Params &p)
+{
+    if (!workers.isEmpty()) {
+        Logger::log(logModule, "tried to start with an already started thumbnailer");
+        return;
+    }
+    this->p = p;
+    processedPts.clear();
+
+    // Each instance takes a contiguous run of the points, so that its seeks
+    // all go forwards through one part of the file.
+    int total = p.rows * p.cols;
+    int instances = p.instances > 0 ? p.instances : defaultInstances();
+    instances = std::max(1, std::min(instances, total));
+    LogStream(logModule) << "starting thumbnailing process for " << p.sourceUrl
+                         << " with " << instances << " instances";
+    for (int i = 0; i < instances; i++) {
+        int first = 1 + total * i / instances;
+        int count = 1 + total * (i + 1) / instances - first;
+        auto worker = new MpvThumbnailWorker(p, first, count, this);
+        connect(worker, &MpvThumbnailWorker::thumbTaken,
+                this, &MpvThumbnailer::worker_thumbTaken);
+        connect(worker, &MpvThumbnailWorker::finished,
+                this, &MpvThumbnailer::worker_finished);
+        workers.append(worker);
+    }
+    workersRunning = workers.count();
+    for (MpvThumbnailWorker *worker : workers)
+        worker->start();
+    emit progress(0);
+}
+
+void MpvThumbnailer::renderImage()
+{
+    Logger::log(logModule, "rendering thumbnail image");
+
+    QFont blurbFont("Helvetica", 12);
+    QFontMetrics blurbMetrics(blurbFont);
+    QString blurb = "File Name: %1\n" "File Size: %2\n" "Resolution: %3x%4\n" "Duration: %5";
+    blurb = blurb.arg(p.sourceUrl.fileName(),
+                      Helpers::fileSizeToString(mpvFileSize),
+                      QString::number(mpvVideoSize.width()),
+                      QString::number(mpvVideoSize.height()),
+                      Helpers::toDateFormat(mpvDuration));
+
+    // Calculate blurb size and therefore caption area
+    QRect oversizeRect = QRect(0, 0, p.imageWidth, p.imageWidth);
+    QRect blurbRect = blurbMetrics.boundingRect(oversizeRect, 0, blurb);
+    QRect captionArea = QRect(pageMargin, 0,
+                              p.imageWidth - pageMarginSum,
+                              blurbRect.height() + pageMargin + captionPadding);
+
+    // Calculate size of self label to fit the caption area
+    QFont selfFont("Helvetica", 1000, QFont::Black);
+    QFontMetrics selfMetrics1000(selfFont);
+    selfFont.setPixelSize((captionArea.height() - (pageMargin + captionPadding))
+                          * selfMetrics1000.height() / selfMetrics1000.ascent());
+    QFontMetrics selfMetrics(selfFont);
+    QString self = "MPC-QT";
+    QRect selfRect = captionArea.adjusted(0, -selfMetrics.descent(),
+                                          -pageMargin, selfMetrics.descent()*2);
+
+    // Create new image with size.
+    // h = captionbottom + margin-thumbmargin + (thumb+thumbmargin)*rows
+    QSize imageSize(p.imageWidth, captionArea.bottom() + rhsPadding +
+                    ((thumbSize.height()+ thumbMargin) * p.rows));
+    render = QImage(imageSize, QImage::Format_RGB32);
+    render.fill(QColor("#efeeec"));
+    QPainter p(&render);
+
+    // Draw texts
+    p.setPen(QColor("#fcfbfa"));
+    p.setFont(selfFont);
+    p.drawText(selfRect, Qt::AlignRight | Qt::AlignVCenter, self);
+
+    p.setPen(QColor("#100f0d"));
+    p.setFont(blurbFont);
+    p.drawText(blurbRect.translated(pageMargin, pageMargin), 0, blurb);
+
+    // Draw thumbnails
+    for (auto &t : processedPts) {
+        QRectF rc({int(t.x) + 0.5, int(t.y) + 0.5}, t.thumb.size());
+        rc.translate(pageMargin, captionArea.bottom());
+        p.fillRect(rc.translated(thumbShadow, thumbShadow), "#bcbbba");
+        p.fillRect(rc.adjusted(-1,-1,1,1), "#8c8b8a");
+        p.drawImage(rc.topLeft().toPoint(), t.thumb);
+    }
+}
+
+void MpvThumbnailer::saveImage()
+{
+    LogStream(logModule) << "saving thumbnails to " << p.imageFile;
+    if (!render.save(p.imageFile, nullptr, p.jpegQuality))
+        Logger::log(logModule, "file was not saved. Is the filename correct?");
+    render.detach();
+}
+
+void MpvThumbnailer::worker_thumbTaken(const MpvThumbnailer::ThumbPts &thumb)
+{
+    processedPts.insert(thumb.index, thumb);
+    emit progress(processedPts.count() * 100 / (p.rows * p.cols));
+}
+
+void MpvThumbnailer::worker_finished()
+{
+    if (--workersRunning > 0)
+        return;
+
+    // Every instance opened the same file, so any of them that got as far
+    // as its size and length can describe it.  Without a single slide, as
+    // with a file that has no video, there is no sheet to save.
+    MpvThumbnailWorker *described = workers.first();
+    for (MpvThumbnailWorker *worker : workers) {
+        if (worker->duration() > 0 && worker->videoSize() != QSize(-1,-1)) {
+            described = worker;
+            break;
+        }
+    }
+    mpvFileSize = described->fileSize();
+    mpvVideoSize = described->videoSize();
+    mpvDuration = described->duration();
+    thumbSize = described->thumbSize();
+    if (processedPts.isEmpty()) {
+        Logger::log(logModule, "no slides were taken, so no image is saved");
+    } else {
+        renderImage();
+        saveImage();
+    }
+    processedPts.clear();
+
+    // This is called from within a worker's slot, so let them finish up.
+    for (MpvThumbnailWorker *worker : workers)
+        worker->deleteLater();
+    workers.clear();
+    emit finished();
+}
+
+
+
+MpvThumbnailWorker::MpvThumbnailWorker(const MpvThumbnailer::Params &p,
+                                       int first, int count, QObject *parent)
+    : QObject(parent), p(p), first(first), count(count)
+{
+
+}
+
+MpvThumbnailWorker::~MpvThumbnailWorker()
+{
+    deinitPlayer();
+}
+
+int64_t MpvThumbnailWorker::fileSize() const
+{
+    return mpvFileSize;
+}
+
+QSize MpvThumbnailWorker::videoSize() const
+{
+    return mpvVideoSize;
+}
+
+double MpvThumbnailWorker::duration() const
+{
+    return mpvDuration;
+}
+
+QSize MpvThumbnailWorker::thumbSize() const
+{
+    return thumbSize_;
+}
+
+void MpvThumbnailWorker::start()
 {
     if (thumbState != AvailableState) {
         Logger::log(logModule, "tried to start with an already started thumbnailer");
@@ -127,12 +313,16 @@ void MpvThumbnailer::execute(const MpvThumbnailer::Params &p)
     thumbState = StartedState;
 
     initPlayer();
-    LogStream(logModule) << "starting thumbnailing process for " << p.sourceUrl;
-    this->p = p;
+    LogStream(logModule) << "taking slides " << first << " to " << first + count - 1
+                         << " of " << p.sourceUrl;
     pendingPts.clear();
-    processedPts.clear();
+    mpvDuration = -1;
+    mpvVideoSize = {-1,-1};
+    fileRestarted = false;
 
-    mpv->ctrlSetOptionVariant("profile", "gpu-hq");
+    // The software renderer has no use for the gpu's scalers and shaders.
+    if (!softwareDrawer)
+        mpv->ctrlSetOptionVariant("profile", "gpu-hq");
     mpv->ctrlSetOptionVariant("blend-subtitles", "video");
     mpv->ctrlSetOptionVariant("sub-visibility", "no");
     mpv->ctrlSetOptionVariant("osd-align-x", "right");
@@ -145,159 +335,196 @@ void MpvThumbnailer::execute(const MpvThumbnailer::Params &p)
     mpv->ctrlSetOptionVariant("ao-null-untimed", "yes");
     mpv->ctrlSetOptionVariant("untimed", "yes");
     mpv->ctrlSetOptionVariant("fps", 200);
+    if (p.fastSeek)
+        mpv->ctrlSetOptionVariant("hr-seek", "no");
     mpv->urlOpen(p.sourceUrl);
     mpv->setPaused(true);
-    emit progress(0);
 }
 
-void MpvThumbnailer::initPlayer()
+void MpvThumbnailWorker::initPlayer()
 {
     mpv = new MpvObject(this, friendlyName);
-    thumbnailer = new MpvThumbnailDrawer(mpv);
-    mpv->setWidgetType(Helpers::CustomWidget, thumbnailer);
+    if (p.softwareRender && MpvSoftwareThumbnailDrawer::isAvailable()) {
+        softwareDrawer = new MpvSoftwareThumbnailDrawer(mpv);
+        mpv->setWidgetType(Helpers::CustomWidget, softwareDrawer);
+    } else {
+        if (p.softwareRender)
+            Logger::log(logModule, "software rendering is not supported by this libmpv");
+        thumbnailer = new MpvThumbnailDrawer(mpv);
+        mpv->setWidgetType(Helpers::CustomWidget, thumbnailer);
+        thumbnailer->setAttribute(Qt::WA_DontShowOnScreen);
+        thumbnailer->show();
+    }
     connect(mpv, &MpvObject::fileSizeChanged,
-            this, &MpvThumbnailer::mpv_fileSizeChanged);
+            this, &MpvThumbnailWorker::mpv_fileSizeChanged);
     connect(mpv, &MpvObject::playbackFinished,
-            this, &MpvThumbnailer::mpv_playbackFinished);
+            this, &MpvThumbnailWorker::mpv_playbackFinished);
     connect(mpv, &MpvObject::playbackIdling,
-            this, &MpvThumbnailer::mpv_playbackIdling);
+            this, &MpvThumbnailWorker::mpv_playbackIdling);
+    connect(mpv, &MpvObject::playbackRestarted,
+            this, &MpvThumbnailWorker::mpv_playbackRestarted);
     connect(mpv, &MpvObject::playLengthChanged,
-            this, &MpvThumbnailer::mpv_playLengthChanged);
+            this, &MpvThumbnailWorker::mpv_playLengthChanged);
     connect(mpv, &MpvObject::playTimeChanged,
-            this, &MpvThumbnailer::mpv_playTimeChanged);
+            this, &MpvThumbnailWorker::mpv_playTimeChanged);
+    connect(mpv, &MpvObject::tracksChanged,
+            this, &MpvThumbnailWorker::mpv_tracksChanged);
     connect(mpv, &MpvObject::videoSizeChanged,
-            this, &MpvThumbnailer::mpv_videoSizeChanged);
-    thumbnailer->setAttribute(Qt::WA_DontShowOnScreen);
-    thumbnailer->show();
+            this, &MpvThumbnailWorker::mpv_videoSizeChanged);
 }
 
-void MpvThumbnailer::deinitPlayer()
+void MpvThumbnailWorker::deinitPlayer()
 {
     if (!mpv)
         return;
     mpv->setWidgetType(Helpers::NullWidget);
     thumbnailer = nullptr;
+    softwareDrawer = nullptr;
 
     delete mpv;
     mpv = nullptr;
 }
 
-void MpvThumbnailer::initThumbPts()
+void MpvThumbnailWorker::initThumbPts()
 {
     int total = p.rows * p.cols;
     int index = 1;
     int dx = (p.imageWidth - emptySpace)/p.cols;
-    int dy = thumbSize.height() + thumbMargin;
+    int dy = thumbSize_.height() + thumbMargin;
 
+    // Every worker lays out the whole sheet, and keeps its own run of it.
     pendingPts.clear();
-    processedPts.clear();
     for (int r = 0; r < p.rows; r++) {
-        for (int c = 0; c < p.cols; c++) {
+        for (int c = 0; c < p.cols; c++, index++) {
+            if (index < first || index >= first + count)
+                continue;
             pendingPts.enqueue({c*dx, r*dy,
                                 (mpvDuration * index) / (total+1),
                                 index * 100 / total, index,
                                 QImage()});
-            index++;
         }
     }
 }
 
-void MpvThumbnailer::processThumb()
+void MpvThumbnailWorker::drawFrame()
+{
+    if (softwareDrawer)
+        softwareDrawer->drawFrame();
+    else
+        thumbnailer->drawFrame();
+}
+
+QImage MpvThumbnailWorker::readFrame()
+{
+    if (softwareDrawer)
+        return softwareDrawer->grabFrame();
+    return thumbnailer->readFrame();
+}
+
+void MpvThumbnailWorker::processThumb()
 {
     if (pendingPts.isEmpty()) {
         Logger::log(logModule, "tried to process a thumb but there's nothing here");
         return;
     }
-    ThumbPts &front = pendingPts.front();
+    MpvThumbnailer::ThumbPts &front = pendingPts.front();
     LogStream(logModule) << "Processing slide " << front.index
                          << "(" << front.percent << "%)";
-    emit progress(front.percent);
-    front.thumb = thumbnailer->grabFramebuffer();
-    processedPts.enqueue(pendingPts.dequeue());
+    drawFrame();
+    front.thumb = readFrame();
+    emit thumbTaken(pendingPts.dequeue());
 }
 
-bool MpvThumbnailer::seekNextFrame()
+bool MpvThumbnailWorker::seekNextFrame()
 {
     if (pendingPts.isEmpty())
         return false;
     LogStream(logModule) << "seeking to " << pendingPts.front().pts;
     mpv->setTime(pendingPts.front().pts);
-    mpv->showMessage(Helpers::toDateFormatFixed(pendingPts.front().pts, osdTimeFormat));
+    // Redrawing the osd would hand fast mode a fresh copy of the old frame,
+    // so it stamps the time on itself.
+    if (!p.fastSeek)
+        mpv->showMessage(Helpers::toDateFormatFixed(pendingPts.front().pts, osdTimeFormat));
     thumbState = SeekingState;
     return true;
 }
 
-void MpvThumbnailer::renderImage()
+void MpvThumbnailWorker::startFastSeeking()
 {
-    Logger::log(logModule, "rendering thumbnail image");
-
-    QFont blurbFont("Helvetica", 12);
-    QFontMetrics blurbMetrics(blurbFont);
-    QString blurb = "File Name: %1\n" "File Size: %2\n" "Resolution: %3x%4\n" "Duration: %5";
-    blurb = blurb.arg(p.sourceUrl.fileName(),
-                      Helpers::fileSizeToString(mpvFileSize),
-                      QString::number(mpvVideoSize.width()),
-                      QString::number(mpvVideoSize.height()),
-                      Helpers::toDateFormat(mpvDuration));
-
-    // Calculate blurb size and therefore caption area
-    QRect oversizeRect = QRect(0, 0, p.imageWidth, p.imageWidth);
-    QRect blurbRect = blurbMetrics.boundingRect(oversizeRect, 0, blurb);
-    QRect captionArea = QRect(pageMargin, 0,
-                              p.imageWidth - pageMarginSum,
-                              blurbRect.height() + pageMargin + captionPadding);
-
-    // Calculate size of self label to fit the caption area
-    QFont selfFont("Helvetica", 1000, QFont::Black);
-    QFontMetrics selfMetrics1000(selfFont);
-    selfFont.setPixelSize((captionArea.height() - (pageMargin + captionPadding))
-                          * selfMetrics1000.height() / selfMetrics1000.ascent());
-    QFontMetrics selfMetrics(selfFont);
-    QString self = "MPC-QT";
-    QRect selfRect = captionArea.adjusted(0, -selfMetrics.descent(),
-                                          -pageMargin, selfMetrics.descent()*2);
-
-    // Create new image with size.
-    // h = captionbottom + margin-thumbmargin + (thumb+thumbmargin)*rows
-    QSize imageSize(p.imageWidth, captionArea.bottom() + rhsPadding +
-                    ((thumbSize.height()+ thumbMargin) * p.rows));
-    render = QImage(imageSize, QImage::Format_RGB32);
-    render.fill(QColor("#efeeec"));
-    QPainter p(&render);
-
-    // Draw texts
-    p.setPen(QColor("#fcfbfa"));
-    p.setFont(selfFont);
-    p.drawText(selfRect, Qt::AlignRight | Qt::AlignVCenter, self);
-
-    p.setPen(QColor("#100f0d"));
-    p.setFont(blurbFont);
-    p.drawText(blurbRect.translated(pageMargin, pageMargin), 0, blurb);
-
-    // Draw thumbnails
-    for (auto &t : processedPts) {
-        QRectF rc({int(t.x) + 0.5, int(t.y) + 0.5}, t.thumb.size());
-        rc.translate(pageMargin, captionArea.bottom());
-        p.fillRect(rc.translated(thumbShadow, thumbShadow), "#bcbbba");
-        p.fillRect(rc.adjusted(-1,-1,1,1), "#8c8b8a");
-        p.drawImage(rc.topLeft().toPoint(), t.thumb);
+    // Points can be laid out once the length and size are known, and the
+    // first restart (that of opening the file) is out of the way.
+    if (thumbState != StartedState && thumbState != StaleState)
+        return;
+    if (!fileRestarted || mpvDuration <= 0)
+        return;
+    if (mpvVideoSize == QSize(-1,-1)) {
+        thumbState = StaleState;
+        return;
     }
-}
-
-void MpvThumbnailer::saveImage()
+    initThumbPts();
+    seekNextFrame();
+}
+
+void MpvThumbnailWorker::takeFastFrame()
+{
+    // Once the seek has restarted playback, what mpv has to draw is the
+    // frame seeked to, whatever frames were signalled before.  Draw it, seek
+    // on, and only then read it back, so that the next frame is decoded
+    // while this one is copied out.  Nothing draws over it in between, as
+    // that happens on this thread.
+    drawFrame();
+    MpvThumbnailer::ThumbPts thumb = pendingPts.dequeue();
+    bool more = seekNextFrame();
+
+    LogStream(logModule) << "Processing slide " << thumb.index
+                         << "(" << thumb.percent << "%)";
+    thumb.thumb = readFrame();
+    stampTime(thumb.thumb, thumb.pts);
+    emit thumbTaken(thumb);
+    if (!more)
+        mpv->stopPlayback();
+}
+
+void MpvThumbnailWorker::stampTime(QImage &image, double pts)
+{
+    // Where and how the osd would have put it, near enough.
+    QString text = Helpers::toDateFormatFixed(pts, osdTimeFormat);
+    QFont font;
+    font.setPixelSize(osdFontSize);
+    font.setBold(true);
+    QRect area(QPoint(), image.size() / image.devicePixelRatio());
+    area.adjust(0, 0, -osdFontShadow * 2, -osdFontShadow * 2);
+    QPainter painter(&image);
+    painter.setFont(font);
+    painter.setPen(QColor(0, 0, 0, 0x80));
+    painter.drawText(area.translated(osdFontShadow, osdFontShadow),
+                     Qt::AlignRight | Qt::AlignBottom, text);
+    painter.setPen(QColor(0xff, 0xff, 0xff, 0x80));
+    painter.drawText(area, Qt::AlignRight | Qt::AlignBottom, text);
+}
+
+void MpvThumbnailWorker::mpv_fileSizeChanged(int64_t bytes)
 {
-    LogStream(logModule) << "saving thumbnails to " << p.imageFile;
-    if (!render.save(p.imageFile, nullptr, p.jpegQuality))
-        Logger::log(logModule, "file was not saved. Is the filename correct?");
-    render.detach();
+    mpvFileSize = bytes;
 }
 
-void MpvThumbnailer::mpv_fileSizeChanged(int64_t bytes)
+void MpvThumbnailWorker::mpv_tracksChanged(QVariantList tracks)
 {
-    mpvFileSize = bytes;
+    // A file without pictures would wait for a video size that never comes,
+    // so stop it and let the sheet go unmade.  Cover art doesn't count.
+    if (tracks.isEmpty() || thumbState == FinishedState)
+        return;
+    for (const QVariant &v : tracks) {
+        QVariantMap track = v.toMap();
+        if (track.value("type").toString() == "video"
+                && !track.value("albumart").toBool())
+            return;
+    }
+    LogStream(logModule) << p.sourceUrl << " has no video to take slides of";
+    mpv->stopPlayback();
 }
 
-void MpvThumbnailer::mpv_videoSizeChanged(QSize video)
+void MpvThumbnailWorker::mpv_videoSizeChanged(QSize video)
 {
     mpvVideoSize = video;
     if (mpvVideoSize == QSize(-1,-1))
@@ -309,14 +536,21 @@ void MpvThumbnailer::mpv_videoSizeChanged(QSize video)
     int availPx = (p.imageWidth - emptySpace)/p.cols - thumbMargin;
     int h = int(availPx / aRatio + 0.5);
     int w = int(h * aRatio + 0.5);
-    thumbSize = QSize(w, h);
-    thumbnailer->resize(thumbSize);
+    thumbSize_ = QSize(w, h);
+    if (softwareDrawer)
+        softwareDrawer->setFrameSize(thumbSize_);
+    else
+        thumbnailer->resize(thumbSize_);
 
     // Set a consistent size for the osd message
     double factor = safeDiv(mpvVideoSize.height(), h);
     mpv->ctrlSetOptionVariant("osd-font-size", int(osdFontSize * factor));
     mpv->ctrlSetOptionVariant("osd-border-size", int(osdFontShadow * factor));
 
+    if (p.fastSeek) {
+        startFastSeeking();
+        return;
+    }
     if (thumbState == StaleState) {
         // video size was not valid at first navigation,
         // so initialize our stuff now.
@@ -325,14 +559,16 @@ void MpvThumbnailer::mpv_videoSizeChanged(QSize video)
     }
 }
 
-void MpvThumbnailer::mpv_playLengthChanged(double length)
+void MpvThumbnailWorker::mpv_playLengthChanged(double length)
 {
     mpvDuration = length;
     osdTimeFormat = length < 3600.0 ? Helpers::ShortHourFormat
                                     : Helpers::ShortFormat;
+    if (p.fastSeek)
+        startFastSeeking();
 }
 
-void MpvThumbnailer::mpv_playTimeChanged(double time)
+void MpvThumbnailWorker::mpv_playTimeChanged(double time)
 {
     // This function is called:
     // * Once at file open with timestamp 0
@@ -353,6 +589,10 @@ void MpvThumbnailer::mpv_playTimeChanged(double time)
         return;
     }
 
+    // Fast seeking goes by restarts and drawn frames instead.
+    if (p.fastSeek)
+        return;
+
     if (thumbState == StartedState) {
         if (mpvVideoSize == QSize(-1,-1)) {
             thumbState = StaleState;
@@ -371,16 +611,16 @@ void MpvThumbnailer::mpv_playTimeChanged(double time)
 
     if (thumbState == PlayingState) {
         thumbState = WaitingForTimer;
-        QTimer::singleShot(timerWaitMsec, this, &MpvThumbnailer::timer_navigateTick);
+        QTimer::singleShot(timerWaitMsec, this, &MpvThumbnailWorker::timer_navigateTick);
     }
 }
 
-void MpvThumbnailer::mpv_playbackFinished()
+void MpvThumbnailWorker::mpv_playbackFinished()
 {
     thumbState = FinishedState;
 }
 
-void MpvThumbnailer::mpv_playbackIdling()
+void MpvThumbnailWorker::mpv_playbackIdling()
 {
     if (thumbState != FinishedState)
         return;
@@ -389,14 +629,24 @@ void MpvThumbnailer::mpv_playbackIdling()
     emit finished();
 }
 
-void MpvThumbnailer::timer_navigateTick()
+void MpvThumbnailWorker::mpv_playbackRestarted()
+{
+    if (!p.fastSeek)
+        return;
+    if (thumbState == StartedState || thumbState == StaleState) {
+        fileRestarted = true;
+        startFastSeeking();
+    } else if (thumbState == SeekingState) {
+        takeFastFrame();
+    }
+}
+
+void MpvThumbnailWorker::timer_navigateTick()
 {
     processThumb();
     if (seekNextFrame())
         return;
 
-    renderImage();
-    saveImage();
     mpv->stopPlayback();
 }
 
@@ -451,14 +701,36 @@ void MpvThumbnailDrawer::paintGL()
         Logger::log(logModule, "tried to draw a frame, but no renderer set");
         return;
     }
-    bool yes = true;
+    int yes = 1, no = 0;
     mpv_opengl_fbo fbo { static_cast<int>(defaultFramebufferObject()), glWidth, glHeight, 0 };
     mpv_render_param params[] {
         {MPV_RENDER_PARAM_OPENGL_FBO, &fbo },
-        {MPV_RENDER_PARAM_FLIP_Y, &yes}
+        {MPV_RENDER_PARAM_FLIP_Y, &yes},
+        {MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME, &no},
+        {MPV_RENDER_PARAM_INVALID, nullptr}
     };
     mpv_render_context_render(render, params);
-    emit renderedFrame();
+}
+
+void MpvThumbnailDrawer::drawFrame()
+{
+    makeCurrent();
+    paintGL();
+    doneCurrent();
+}
+
+QImage MpvThumbnailDrawer::readFrame()
+{
+    // Unlike grabFramebuffer, this doesn't paint again first.
+    QImage image(glWidth, glHeight, QImage::Format_RGBA8888);
+    makeCurrent();
+    context()->functions()->glReadPixels(0, 0, glWidth, glHeight, GL_RGBA,
+                                         GL_UNSIGNED_BYTE, image.bits());
+    doneCurrent();
+    // gl counts rows from the bottom up.
+    image = image.mirrored().convertToFormat(QImage::Format_RGB32);
+    image.setDevicePixelRatio(devicePixelRatio());
+    return image;
 }
 
 void MpvThumbnailDrawer::resizeGL(int w, int h)
@@ -492,3 +764,91 @@ QWidget *MpvThumbnailDrawer::self()
     return this;
 }
 
+
+
+MpvSoftwareThumbnailDrawer::MpvSoftwareThumbnailDrawer(MpvObject *object)
+    : QWidget(nullptr), MpvWidgetInterface(object),
+      frame(placeholderWidth, placeholderHeight, QImage::Format_RGBX8888)
+{
+    setWindowTitle(friendlyName);
+}
+
+MpvSoftwareThumbnailDrawer::~MpvSoftwareThumbnailDrawer()
+{
+    if (render) {
+        ctrl->destroyRenderContext(render);
+        render = nullptr;
+    }
+}
+
+bool MpvSoftwareThumbnailDrawer::isAvailable()
+{
+#ifdef MPV_RENDER_API_TYPE_SW
+    return true;
+#else
+    return false;
+#endif
+}
+
+QWidget *MpvSoftwareThumbnailDrawer::self()
+{
+    return this;
+}
+
+void MpvSoftwareThumbnailDrawer::initMpv()
+{
+#ifdef MPV_RENDER_API_TYPE_SW
+    mpv_render_param params[] {
+        { MPV_RENDER_PARAM_API_TYPE, const_cast<char*>(MPV_RENDER_API_TYPE_SW) },
+        { MPV_RENDER_PARAM_INVALID, nullptr },
+    };
+    render = ctrl->createRenderContext(params);
+    mpv_render_context_set_update_callback(render, MpvSoftwareThumbnailDrawer::render_update, this);
+#endif
+}
+
+void MpvSoftwareThumbnailDrawer::setFrameSize(const QSize &size)
+{
+    if (size.isEmpty() || size == frame.size())
+        return;
+    frame = QImage(size, QImage::Format_RGBX8888);
+}
+
+QImage MpvSoftwareThumbnailDrawer::grabFrame()
+{
+    return frame.convertToFormat(QImage::Format_RGB32);
+}
+
+void MpvSoftwareThumbnailDrawer::drawFrame()
+{
+#ifdef MPV_RENDER_API_TYPE_SW
+    if (!render)
+        return;
+    // mpv's rgb0 is laid out byte for byte as qt's rgbx.
+    int size[] { frame.width(), frame.height() };
+    size_t stride = size_t(frame.bytesPerLine());
+    mpv_render_param params[] {
+        { MPV_RENDER_PARAM_SW_SIZE, size },
+        { MPV_RENDER_PARAM_SW_FORMAT, const_cast<char*>("rgb0") },
+        { MPV_RENDER_PARAM_SW_STRIDE, &stride },
+        { MPV_RENDER_PARAM_SW_POINTER, frame.bits() },
+        { MPV_RENDER_PARAM_INVALID, nullptr }
+    };
+    mpv_render_context_render(render, params);
+#endif
+}
+
+void MpvSoftwareThumbnailDrawer::alwaysUpdate()
+{
+    // mpv waits for the frames it hands over to be drawn, so they are, even
+    // though only the ones drawn as a slide is taken end up on the sheet.
+#ifdef MPV_RENDER_API_TYPE_SW
+    if (render && mpv_render_context_update(render) & MPV_RENDER_UPDATE_FRAME)
+        drawFrame();
+#endif
+}
+
+void MpvSoftwareThumbnailDrawer::render_update(void *ctx)
+{
+    QMetaObject::invokeMethod(reinterpret_cast<MpvSoftwareThumbnailDrawer*>(ctx), "alwaysUpdate");
+}
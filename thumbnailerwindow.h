@@ -2,6 +2,7 @@
 #define THUMBNAILERWINDOW_H
 
 #include <QImage>
+#include <QMap>
 #include <QOpenGLWidget>
 #include <QWidget>
 #include <QQueue>
@@ -12,7 +13,9 @@ namespace Ui {
 class ThumbnailerWindow;
 }
 class MpvThumbnailDrawer;
+class MpvSoftwareThumbnailDrawer;
 class MpvThumbnailer;
+class MpvThumbnailWorker;
 
 class ThumbnailerWindow : public QWidget
 {
@@ -43,14 +46,18 @@ private:
 class MpvThumbnailer : public QObject {
     Q_OBJECT
 
-    enum ThumbnailingState {
-        AvailableState, // Available for use
-        StartedState,   // File opened
-        StaleState,     // File opened, but no video size yet
-        SeekingState,   // Seek command sent
-        PlayingState,   // Playing video until frozen
-        WaitingForTimer, // Waiting for snapshot timer
-        FinishedState   // Playback finished
+public:
+    struct Params {
+        QUrl sourceUrl;
+        QString imageFile;
+        int jpegQuality, imageWidth;
+        int cols, rows;
+        // Seek to keyframes, and take each as soon as it is drawn.
+        bool fastSeek = false;
+        // How many mpv instances share the points, or 0 for the default.
+        int instances = 0;
+        // Draw frames on the cpu, without any gl context.
+        bool softwareRender = false;
     };
 
     struct ThumbPts {
@@ -60,45 +67,102 @@ class MpvThumbnailer : public QObject {
         QImage thumb;
     };
 
-public:
-    struct Params {
-        QUrl sourceUrl;
-        QString imageFile;
-        int jpegQuality, imageWidth;
-        int cols, rows;
-    };
-
     explicit MpvThumbnailer(QObject *parent);
     ~MpvThumbnailer();
+    // Just the one.  Each instance decodes on its own threads, but they all
+    // draw and read back on the GUI thread, one after another, so more of
+    // them only pays off when decoding is what holds things up.
+    static int defaultInstances();
     void execute(const Params &p);
 
 signals:
     void progress(int percent);
     void finished();
 
+private:
+    void renderImage();
+    void saveImage();
+
+private slots:
+    void worker_thumbTaken(const MpvThumbnailer::ThumbPts &thumb);
+    void worker_finished();
+
+private:
+    Params p;
+    QList<MpvThumbnailWorker *> workers;
+    int workersRunning = 0;
+    double mpvDuration = -1;
+    int64_t mpvFileSize = 0;
+    QSize mpvVideoSize = {-1,-1};
+    // By index, which is the order they are drawn in.
+    QMap<int, ThumbPts> processedPts;
+    QImage render;
+    QSize thumbSize;
+};
+
+// One mpv instance opening the file, and taking the thumbnails of the run of
+// points from first.
+class MpvThumbnailWorker : public QObject {
+    Q_OBJECT
+
+    enum ThumbnailingState {
+        AvailableState, // Available for use
+        StartedState,   // File opened
+        StaleState,     // File opened, but no video size yet
+        SeekingState,   // Seek command sent
+        PlayingState,   // Playing video until frozen
+        WaitingForTimer, // Waiting for snapshot timer
+        FinishedState   // Playback finished
+    };
+
+public:
+    MpvThumbnailWorker(const MpvThumbnailer::Params &p, int first, int count,
+                       QObject *parent);
+    ~MpvThumbnailWorker();
+    void start();
+
+    int64_t fileSize() const;
+    QSize videoSize() const;
+    double duration() const;
+    QSize thumbSize() const;
+
+signals:
+    void thumbTaken(const MpvThumbnailer::ThumbPts &thumb);
+    void finished();
+
 private:
     void initPlayer();
     void deinitPlayer();
 
     void initThumbPts();
+    // Draws mpv's current frame, which readFrame() then copies out.
+    void drawFrame();
+    QImage readFrame();
     void processThumb();
     bool seekNextFrame();
-    void renderImage();
-    void saveImage();
+    void startFastSeeking();
+    void takeFastFrame();
+    void stampTime(QImage &image, double pts);
 
 private slots:
     void mpv_fileSizeChanged(int64_t bytes);
+    void mpv_tracksChanged(QVariantList tracks);
     void mpv_videoSizeChanged(QSize size);
     void mpv_playLengthChanged(double length);
     void mpv_playTimeChanged(double time);
     void mpv_playbackFinished();
     void mpv_playbackIdling();
+    void mpv_playbackRestarted();
     void timer_navigateTick();
 
 private:
-    Params p;
+    MpvThumbnailer::Params p;
+    int first = 1;
+    int count = 0;
     MpvObject *mpv = nullptr;
+    // One of these draws the frames.
     MpvThumbnailDrawer *thumbnailer = nullptr;
+    MpvSoftwareThumbnailDrawer *softwareDrawer = nullptr;
 
     ThumbnailingState thumbState = AvailableState;
     double mpvTime = -1;
@@ -106,10 +170,11 @@ private:
     Helpers::TimeFormat osdTimeFormat = Helpers::ShortFormat;
     int64_t mpvFileSize = 0;
     QSize mpvVideoSize = {-1,-1};
-    QQueue<ThumbPts> pendingPts;
-    QQueue<ThumbPts> processedPts;
-    QImage render;
-    QSize thumbSize;
+    // In fast mode, seeking starts once opening the file has restarted
+    // playback, and each frame is taken when its seek has.
+    bool fileRestarted = false;
+    QQueue<MpvThumbnailer::ThumbPts> pendingPts;
+    QSize thumbSize_;
 };
 
 
@@ -126,9 +191,10 @@ public:
     void setLogoUrl(const QString &filename);
     void setLogoBackground(const QColor &color);
     void setDrawLogo(bool yes);
-
-signals:
-    void renderedFrame();
+    // Draws mpv's current frame into the framebuffer.
+    void drawFrame();
+    // A copy of what is in the framebuffer.
+    QImage readFrame();
 
 protected:
     void initializeGL();
@@ -144,4 +210,33 @@ private:
     int glWidth, glHeight;
 };
 
+
+// Draws frames into an image with libmpv's software renderer, for machines
+// without a usable gpu.  It is never shown, and needs no gl context.
+class MpvSoftwareThumbnailDrawer : public QWidget, public MpvWidgetInterface {
+    Q_OBJECT
+    Q_INTERFACES(MpvWidgetInterface)
+
+public:
+    explicit MpvSoftwareThumbnailDrawer(MpvObject *object);
+    ~MpvSoftwareThumbnailDrawer();
+    // Whether the libmpv built against can render in software.
+    static bool isAvailable();
+
+    QWidget *self();
+    void initMpv();
+    void setFrameSize(const QSize &size);
+    // Draws mpv's current frame, which grabFrame() then copies out.
+    void drawFrame();
+    QImage grabFrame();
+
+private slots:
+    void alwaysUpdate();
+
+private:
+    static void render_update(void *ctx);
+    mpv_render_context *render = nullptr;
+    QImage frame;
+};
+
 #endif // THUMBNAILERWINDOW_H
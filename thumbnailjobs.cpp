@@ -0,0 +1,262 @@
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QTimer>
+#include <algorithm>
+#include "helpers.h"
+#include "logger.h"
+#include "thumbnailjobs.h"
+
+static const char logModule[] = "thumbnailjobs";
+// Sheets are named after their file, and nothing that changes between runs.
+// A short hash of the file's path follows, as files in different folders or
+// with different extensions may share a name.
+static const char sheetFormat[] = "%f_thumbs_";
+constexpr int sheetHashLength = 8;
+
+// Give up on a file that was being worked on this many times when the
+// program went down.
+constexpr int maxAttempts = 2;
+// Give up on a file that takes longer than this, in milliseconds.
+constexpr int jobTimeout = 10 * 60 * 1000;
+
+ThumbnailJobs::ThumbnailJobs(QObject *parent)
+    : QObject(parent)
+{
+    params.jpegQuality = 97;
+    params.imageWidth = 1024;
+    params.cols = 4;
+    params.rows = 4;
+    // Nobody is watching, so trade exact positions for speed.
+    params.fastSeek = true;
+
+    watchdog = new QTimer(this);
+    watchdog->setSingleShot(true);
+    watchdog->setInterval(jobTimeout);
+    connect(watchdog, &QTimer::timeout,
+            this, &ThumbnailJobs::watchdog_timeout);
+    makeThumbnailer();
+}
+
+ThumbnailJobs::~ThumbnailJobs()
+{
+    delete savedQueueLock;
+}
+
+bool ThumbnailJobs::claimSavedQueue(const QString &lockPath)
+{
+    if (savedQueueLock)
+        return ownsSavedQueue();
+    savedQueueLock = new QLockFile(lockPath);
+    // The lock is held for as long as the program runs, so it only goes
+    // stale when its process is gone.
+    savedQueueLock->setStaleLockTime(0);
+    if (!savedQueueLock->tryLock()) {
+        Logger::log(logModule, "another process keeps the saved queue, so this one won't save its own");
+        return false;
+    }
+    return true;
+}
+
+bool ThumbnailJobs::ownsSavedQueue() const
+{
+    return savedQueueLock && savedQueueLock->isLocked();
+}
+
+void ThumbnailJobs::setOutput(const QString &directory, const QString &format)
+{
+    this->directory = directory;
+    this->format = format.isEmpty() ? QString("jpg") : format;
+}
+
+void ThumbnailJobs::setSoftwareRender(bool yes)
+{
+    params.softwareRender = yes;
+}
+
+void ThumbnailJobs::enqueue(const QList<QUrl> &urls)
+{
+    bool added = false;
+    for (const QUrl &url : Helpers::filterUrls(urls)) {
+        if (!url.isLocalFile())
+            continue;
+        QString source = QFileInfo(url.toLocalFile()).absoluteFilePath();
+        auto it = std::find_if(jobs.begin(), jobs.end(), [&source](const Job &j) {
+            return j.source == source;
+        });
+        if (it != jobs.end()) {
+            if (it->state == DoneJob || it->state == FailedJob) {
+                it->state = PendingJob;
+                it->attempts = 0;
+                added = true;
+            }
+            continue;
+        }
+        Job job;
+        job.source = source;
+        QByteArray hash = QCryptographicHash::hash(source.toUtf8(), QCryptographicHash::Md5);
+        QString name = sheetFormat + QString::fromLatin1(hash.toHex().left(sheetHashLength));
+        job.image = Helpers::parseFormatEx(name, url, directory, format,
+                                           Helpers::NothingDisabled,
+                                           Helpers::SubtitlesDisabled,
+                                           0.0, 0.0, 0.0);
+        jobs.append(job);
+        added = true;
+    }
+    if (added)
+        emit changed();
+}
+
+bool ThumbnailJobs::isRunning() const
+{
+    return current >= 0;
+}
+
+QVariantMap ThumbnailJobs::toVMap() const
+{
+    QVariantList list;
+    for (const Job &job : jobs) {
+        list.append(QVariantMap {
+            { "source", job.source },
+            { "image", job.image },
+            { "state", int(job.state) },
+            { "attempts", job.attempts }
+        });
+    }
+    return QVariantMap { { "jobs", list } };
+}
+
+void ThumbnailJobs::fromVMap(const QVariantMap &qvm)
+{
+    for (const QVariant &v : qvm.value("jobs").toList()) {
+        QVariantMap map = v.toMap();
+        Job job;
+        job.source = map.value("source").toString();
+        job.image = map.value("image").toString();
+        job.state = JobState(map.value("state").toInt());
+        job.attempts = map.value("attempts").toInt();
+        if (job.source.isEmpty() || job.image.isEmpty())
+            continue;
+        if (job.state == RunningJob) {
+            // It was being worked on when the program went down.
+            if (job.attempts >= maxAttempts) {
+                LogStream(logModule) << "giving up on " << job.source
+                                     << ", as it was being worked on the last "
+                                     << job.attempts << " times";
+                job.state = FailedJob;
+            } else {
+                job.state = PendingJob;
+            }
+        }
+        auto it = std::find_if(jobs.constBegin(), jobs.constEnd(), [&job](const Job &j) {
+            return j.source == job.source;
+        });
+        if (it == jobs.constEnd())
+            jobs.append(job);
+    }
+}
+
+void ThumbnailJobs::start()
+{
+    if (current >= 0)
+        return;
+    runNext();
+}
+
+void ThumbnailJobs::thumbnailer_finished()
+{
+    if (current < 0)
+        return;
+    watchdog->stop();
+
+    // The thumbnailer doesn't say whether it could save the sheet, so look.
+    QFileInfo image(jobs[current].image);
+    bool saved = image.exists() && image.lastModified() != previousSheet;
+    endJob(saved ? DoneJob : FailedJob);
+}
+
+void ThumbnailJobs::watchdog_timeout()
+{
+    if (current < 0)
+        return;
+    LogStream(logModule) << "giving up on " << jobs[current].source
+                         << " after " << jobTimeout / 1000 << " seconds";
+    // Throwing the thumbnailer away stops its players.
+    thumbnailer->disconnect(this);
+    thumbnailer->deleteLater();
+    makeThumbnailer();
+    endJob(FailedJob);
+}
+
+void ThumbnailJobs::runNext()
+{
+    int done = 0;
+    current = -1;
+    for (int i = 0; i < jobs.count(); i++) {
+        Job &job = jobs[i];
+        if (job.state != PendingJob) {
+            done++;
+            continue;
+        }
+        if (isUpToDate(job)) {
+            LogStream(logModule) << "skipping " << job.source
+                                 << ", as its sheet is up to date";
+            job.state = DoneJob;
+            done++;
+            continue;
+        }
+        current = i;
+        break;
+    }
+    if (current < 0) {
+        // Everything has been dealt with, so the next run starts afresh.
+        jobs.clear();
+        emit changed();
+        emit finished();
+        return;
+    }
+
+    Job &job = jobs[current];
+    job.state = RunningJob;
+    job.attempts++;
+    // Saved before starting, so that a crash is held against this file.
+    emit changed();
+    emit jobStarted(QUrl::fromLocalFile(job.source), done, jobs.count());
+    LogStream(logModule) << "making a sheet of " << job.source
+                         << " (" << done + 1 << "/" << jobs.count() << ")";
+
+    QFileInfo image(job.image);
+    previousSheet = image.exists() ? image.lastModified() : QDateTime();
+    params.sourceUrl = QUrl::fromLocalFile(job.source);
+    params.imageFile = job.image;
+    watchdog->start();
+    thumbnailer->execute(params);
+}
+
+void ThumbnailJobs::endJob(JobState state)
+{
+    Job &job = jobs[current];
+    job.state = state;
+    if (state == FailedJob)
+        LogStream(logModule) << "no sheet was made of " << job.source;
+    emit changed();
+    // The thumbnailer is still unwinding from telling us it's done, so come
+    // back to it later.
+    QTimer::singleShot(0, this, &ThumbnailJobs::runNext);
+}
+
+void ThumbnailJobs::makeThumbnailer()
+{
+    thumbnailer = new MpvThumbnailer(this);
+    connect(thumbnailer, &MpvThumbnailer::finished,
+            this, &ThumbnailJobs::thumbnailer_finished);
+}
+
+bool ThumbnailJobs::isUpToDate(const Job &job)
+{
+    QFileInfo source(job.source);
+    QFileInfo image(job.image);
+    if (!source.exists())
+        return false;
+    return image.exists() && image.lastModified() >= source.lastModified();
+}
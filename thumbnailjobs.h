@@ -0,0 +1,89 @@
+#ifndef THUMBNAILJOBS_H
+#define THUMBNAILJOBS_H
+// A queue of files to make thumbnail sheets of, worked through one file at a
+// time without any window.  The queue is saved whenever a job starts or
+// ends, so that a run cut short picks up where it left off.  A file that was
+// being worked on when that happened is tried again, but only so many times,
+// in case it was the file that brought everything down.
+//
+// Sheets get a name without a timestamp, but with a hash of the file's path,
+// and a file whose sheet is newer than it is skipped.
+//
+// A primary instance and a --thumbnail run may be going at once.  Only the
+// one holding the lock file keeps the saved queue; the other works through
+// its own queue without saving it.
+
+#include <QDateTime>
+#include <QObject>
+#include <QUrl>
+#include <QVariantMap>
+#include "thumbnailerwindow.h"
+
+class QLockFile;
+class QTimer;
+class ThumbnailJobs : public QObject {
+    Q_OBJECT
+public:
+    explicit ThumbnailJobs(QObject *parent = nullptr);
+    ~ThumbnailJobs();
+
+    // Takes the lock file at lockPath, which is held until this goes away.
+    // Returns whether this process now keeps the saved queue.
+    bool claimSavedQueue(const QString &lockPath);
+    bool ownsSavedQueue() const;
+
+    // Where sheets of files queued from now on go, and in which format.  An
+    // empty directory puts each sheet beside its file.
+    void setOutput(const QString &directory, const QString &format);
+    // Draws frames on the cpu, for machines without a gpu.
+    void setSoftwareRender(bool yes);
+    // Queues the local files among urls, and those under any directories.
+    // Files that are already waiting stay where they are.
+    void enqueue(const QList<QUrl> &urls);
+    bool isRunning() const;
+
+    QVariantMap toVMap() const;
+    void fromVMap(const QVariantMap &qvm);
+
+public slots:
+    // Works through whatever is waiting.  finished is emitted once the queue
+    // is empty, even if it was to begin with.
+    void start();
+
+signals:
+    // Something worth saving changed.
+    void changed();
+    void jobStarted(QUrl source, int done, int total);
+    void finished();
+
+private slots:
+    void thumbnailer_finished();
+    void watchdog_timeout();
+
+private:
+    enum JobState { PendingJob, RunningJob, DoneJob, FailedJob };
+    struct Job {
+        QString source;
+        QString image;
+        JobState state = PendingJob;
+        int attempts = 0;
+    };
+
+    void runNext();
+    void endJob(JobState state);
+    void makeThumbnailer();
+    static bool isUpToDate(const Job &job);
+
+    MpvThumbnailer *thumbnailer = nullptr;
+    MpvThumbnailer::Params params;
+    QTimer *watchdog = nullptr;
+    QLockFile *savedQueueLock = nullptr;
+    // When the sheet of the current job was last written, if it was.
+    QDateTime previousSheet;
+    QList<Job> jobs;
+    int current = -1;
+    QString directory;
+    QString format = "jpg";
+};
+
+#endif // THUMBNAILJOBS_H